@@ -0,0 +1,114 @@
+#version 450
+
+// 延迟渲染的光照子通道：从G-buffer重建表面，光照计算与shader.frag一致，每个像素只计算一次
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput gbufferAlbedo;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput gbufferNormal;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput gbufferDepth;
+
+layout(location = 0) out vec4 outColor;
+
+struct PointLight {
+    vec4 position;  // w is range
+    vec4 color;     // w is intensity
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 invView;
+    vec4 ambientLightColor;
+    uvec4 clusterGrid;      // xyz: 分簇网格尺寸, w: 每簇最多光源数（0表示不分簇）
+    vec4 clusterParams;     // x: 深度切片scale, y: bias, zw: 1 / 屏幕尺寸
+    int numLights;  // 点光源数据在binding 1的存储缓冲区中
+}ubo;
+
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffer {
+    PointLight pointLights[];
+}lights;
+
+layout(std430, set = 0, binding = 2) readonly buffer ClusterLightCount {
+    uint lightCounts[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer ClusterLightIndex {
+    uint lightIndices[];
+};
+
+// 特化常量，constant_id与LveFrameInfo.h的LightingConstant一致；取值在创建管线时确定，未使用的分支被消除
+layout(constant_id = 0) const bool CLUSTERED_LIGHTING = true;   // false：不读取分簇缓冲区，遍历所有点光源
+layout(constant_id = 1) const int FIXED_LIGHT_COUNT = 0;        // >0：点光源数量固定，循环可完全展开
+layout(constant_id = 2) const int SHADING_MODEL = 0;            // 0：Blinn-Phong，1：只计算Lambert漫反射
+
+vec3 fragPosWorld;
+vec3 surfaceNormal;
+vec3 viewDirection;
+vec3 diffuseLight;
+vec3 specularLight;
+
+void AddPointLight(uint index) {
+    PointLight light = lights.pointLights[index];
+    vec3 directionToLight = light.position.xyz - fragPosWorld;
+    float distanceSquared = dot(directionToLight, directionToLight);
+    float attenuation = 1.0 / distanceSquared;
+    float falloff = clamp(1.0 - distanceSquared * distanceSquared / pow(light.position.w, 4.0), 0.0, 1.0);
+    attenuation *= falloff * falloff;
+    directionToLight = normalize(directionToLight);
+
+    float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0.0);
+    vec3 intensity = light.color.xyz * light.color.w * attenuation;
+
+    diffuseLight += intensity * cosAngIncidence;
+
+    if (SHADING_MODEL == 0) {
+        vec3 halfAngle = normalize(directionToLight + viewDirection);
+        float blinnTerm = dot(surfaceNormal, halfAngle);
+        blinnTerm = clamp(blinnTerm, 0, 1);
+        blinnTerm = pow(blinnTerm, 32.0);
+        specularLight += light.color.xyz * intensity * blinnTerm;
+    }
+}
+
+void main() {
+    float depth = subpassLoad(gbufferDepth).r;
+    if (depth >= 1.0) {
+        discard;    // 没有几何体，保留清屏颜色
+    }
+
+    /*透视投影下 depth = P[2][2] + P[3][2] / viewZ，反解视图空间深度，再由NDC还原xy*/
+    float viewZ = ubo.projection[3][2] / (depth - ubo.projection[2][2]);
+    vec2 ndc = gl_FragCoord.xy * ubo.clusterParams.zw * 2.0 - 1.0;
+    vec3 positionView = vec3(ndc.x * viewZ / ubo.projection[0][0], ndc.y * viewZ / ubo.projection[1][1], viewZ);
+    fragPosWorld = (ubo.invView * vec4(positionView, 1.0)).xyz;
+
+    vec3 albedo = subpassLoad(gbufferAlbedo).rgb;
+    surfaceNormal = normalize(subpassLoad(gbufferNormal).xyz * 2.0 - 1.0);
+    vec3 cameraPosWorld = ubo.invView[3].xyz;
+    viewDirection = normalize(cameraPosWorld - fragPosWorld);
+
+    diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+    specularLight = vec3(0.0);
+
+    if (FIXED_LIGHT_COUNT > 0) {
+        for (int i = 0; i < FIXED_LIGHT_COUNT; i++) {
+            AddPointLight(uint(i));
+        }
+    } else if (!CLUSTERED_LIGHTING || ubo.clusterGrid.w == 0u) {
+        for (int i = 0; i < ubo.numLights; i++) {
+            AddPointLight(uint(i));
+        }
+    } else {
+        vec2 tile = floor(gl_FragCoord.xy * ubo.clusterParams.zw * vec2(ubo.clusterGrid.xy));
+        tile = clamp(tile, vec2(0.0), vec2(ubo.clusterGrid.xy) - 1.0);
+        float slice = floor(log(viewZ) * ubo.clusterParams.x + ubo.clusterParams.y);
+        slice = clamp(slice, 0.0, float(ubo.clusterGrid.z) - 1.0);
+
+        uint cluster = uint(tile.x) + ubo.clusterGrid.x * (uint(tile.y) + ubo.clusterGrid.y * uint(slice));
+        uint count = lightCounts[cluster];
+        uint first = cluster * ubo.clusterGrid.w;
+        for (uint i = 0; i < count; i++) {
+            AddPointLight(lightIndices[first + i]);
+        }
+    }
+
+    outColor = vec4(diffuseLight * albedo + specularLight * albedo, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 450
+
+// 延迟渲染的几何子通道：只写G-buffer，光照在deferred_lighting.frag中按像素计算
+layout(location = 0) in vec3 fragColor;
+layout(location = 2) in vec3 fragNormalWorld;
+
+layout(location = 0) out vec4 outAlbedo;    // 顶点颜色
+layout(location = 1) out vec4 outNormal;    // 世界空间法线，映射到[0, 1]
+
+void main() {
+    outAlbedo = vec4(fragColor, 1.0);
+    outNormal = vec4(normalize(fragNormalWorld) * 0.5 + 0.5, 0.0);
+}
\ No newline at end of file
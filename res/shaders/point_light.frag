@@ -1,28 +1,19 @@
 #version 450
 
 layout (location = 0) in vec2 fragOffset;
+layout (location = 1) in vec4 fragColor;
 layout (location = 0) out vec4 outColor;
 
-struct PointLight {
-    vec4 position;  // ignore w
-    vec4 color;     // w is intensity
-};
-
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projection;
     mat4 view;
     mat4 invView;
     vec4 ambientLightColor;
-    PointLight pointLights[10]; //应使用特化常量而非硬编码
-    int numLights;
+    uvec4 clusterGrid;      // xyz: 分簇网格尺寸, w: 每簇最多光源数（0表示不分簇）
+    vec4 clusterParams;     // x: 深度切片scale, y: bias, zw: 1 / 屏幕尺寸
+    int numLights;  // 点光源数据在binding 1的存储缓冲区中
 }ubo;
 
-layout(push_constant) uniform Push {
-    vec4 position;
-    vec4 color;
-    float radius;
-}push;
-
 const float M_PI = 3.14159265358;
 
 void main() {
@@ -30,5 +21,5 @@ void main() {
     if(dis >= 1.0) {
         discard;
     }
-    outColor = vec4(push.color.xyz, 0.5 * (cos(dis * M_PI) + 1.0));
+    outColor = vec4(fragColor.xyz, 0.5 * (cos(dis * M_PI) + 1.0));
 }
\ No newline at end of file
@@ -10,35 +10,39 @@ const vec2 OFFSETS[6] = vec2[](
 );
 
 layout(location = 0) out vec2 fragOffset;
-
-struct PointLight {
-    vec4 position;  // ignore w
-    vec4 color;     // w is intensity
-};
+layout(location = 1) out vec4 fragColor;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projection;
     mat4 view;
     mat4 invView;
     vec4 ambientLightColor;
-    PointLight pointLights[10]; //应使用特化常量而非硬编码
-    int numLights;
+    uvec4 clusterGrid;      // xyz: 分簇网格尺寸, w: 每簇最多光源数（0表示不分簇）
+    vec4 clusterParams;     // x: 深度切片scale, y: bias, zw: 1 / 屏幕尺寸
+    int numLights;  // 点光源数据在binding 1的存储缓冲区中
 }ubo;
 
-layout(push_constant) uniform Push {
-    vec4 position;
-    vec4 color;
-    float radius;
-}push;
+struct LightInstance {
+    vec4 position;  // w: 公告板半径
+    vec4 color;     // w: 强度
+};
+
+// 已按从后到前排序，每个实例一个公告板
+layout(std430, set = 1, binding = 0) readonly buffer LightInstances {
+    LightInstance instances[];
+};
 
 void main() {
+    LightInstance light = instances[gl_InstanceIndex];
     fragOffset = OFFSETS[gl_VertexIndex];
+    fragColor = light.color;
     vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};   // 摄像机右向量
     vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 
-    vec3 positionWorld = push.position.xyz
-        + push.radius * fragOffset.x * cameraRightWorld
-        + push.radius * fragOffset.y * cameraUpWorld;
+    float radius = light.position.w;
+    vec3 positionWorld = light.position.xyz
+        + radius * fragOffset.x * cameraRightWorld
+        + radius * fragOffset.y * cameraUpWorld;
 
     gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
 }
\ No newline at end of file
@@ -7,7 +7,7 @@ layout(location = 2) in vec3 fragNormalWorld;
 layout(location = 0) out vec4 outColor;	// 输出到颜色附件的第0个位置
 
 struct PointLight {
-    vec4 position;  // ignore w
+    vec4 position;  // w is range
     vec4 color;     // w is intensity
 };
 
@@ -16,43 +16,91 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 view;
     mat4 invView;
     vec4 ambientLightColor;
-    PointLight pointLights[10]; //应使用特化常量而非硬编码
-    int numLights;
+    uvec4 clusterGrid;      // xyz: 分簇网格尺寸, w: 每簇最多光源数（0表示不分簇）
+    vec4 clusterParams;     // x: 深度切片scale, y: bias, zw: 1 / 屏幕尺寸
+    int numLights;  // 点光源数据在binding 1的存储缓冲区中
 }ubo;
 
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffer {
+    PointLight pointLights[];
+}lights;
 
-layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-} push;
+// light_cluster.comp的输出：每簇的光源数量，以及每簇clusterGrid.w个槽位的光源下标
+layout(std430, set = 0, binding = 2) readonly buffer ClusterLightCount {
+    uint lightCounts[];
+};
 
-void main() {
-    vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
-    vec3 specularLight = vec3(0.0); // 存储每个点光源对镜面反射的贡献
-    vec3 surfaceNormal = normalize(fragNormalWorld);
+layout(std430, set = 0, binding = 3) readonly buffer ClusterLightIndex {
+    uint lightIndices[];
+};
 
-    vec3 cameraPosWorld = ubo.invView[3].xyz;   // 逆视图矩阵最后一列为相机在世界空间的位置
-    vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);  // 指向观察者的表面向量
+// 特化常量，constant_id与LveFrameInfo.h的LightingConstant一致；取值在创建管线时确定，未使用的分支被消除
+layout(constant_id = 0) const bool CLUSTERED_LIGHTING = true;   // false：不读取分簇缓冲区，遍历所有点光源
+layout(constant_id = 1) const int FIXED_LIGHT_COUNT = 0;        // >0：点光源数量固定，循环可完全展开
+layout(constant_id = 2) const int SHADING_MODEL = 0;            // 0：Blinn-Phong，1：只计算Lambert漫反射
+
+vec3 surfaceNormal;
+vec3 viewDirection;     // 指向观察者的表面向量
+vec3 diffuseLight;
+vec3 specularLight;     // 存储每个点光源对镜面反射的贡献
 
-    /*遍历所有点光源*/
-    for(int i = 0; i < ubo.numLights; i++) {
-        /*计算每个光源对总漫反射的贡献*/
-        PointLight light = ubo.pointLights[i];
-        vec3 directionToLight = light.position.xyz - fragPosWorld;  // 计算点光源方向
-        float attenuation = 1.0 / dot(directionToLight, directionToLight);  // 衰减因子，与光源距离平方成反比
-        directionToLight = normalize(directionToLight);
+/*累加一个点光源对漫反射与镜面反射的贡献*/
+void AddPointLight(uint index) {
+    PointLight light = lights.pointLights[index];
+    vec3 directionToLight = light.position.xyz - fragPosWorld;  // 计算点光源方向
+    float distanceSquared = dot(directionToLight, directionToLight);
+    float attenuation = 1.0 / distanceSquared;  // 衰减因子，与光源距离平方成反比
+    // 在影响半径处平滑衰减到0，与分簇时使用的半径一致，簇边界不会出现跳变
+    float falloff = clamp(1.0 - distanceSquared * distanceSquared / pow(light.position.w, 4.0), 0.0, 1.0);
+    attenuation *= falloff * falloff;
+    directionToLight = normalize(directionToLight);
 
-        float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0.0);
-        vec3 intensity = light.color.xyz * light.color.w * attenuation; // 根据点光源强度来缩放其颜色
+    float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0.0);
+    vec3 intensity = light.color.xyz * light.color.w * attenuation; // 根据点光源强度来缩放其颜色
 
-        diffuseLight += intensity * cosAngIncidence;
+    diffuseLight += intensity * cosAngIncidence;
 
-        // 计算镜面反射
+    // 计算镜面反射
+    if (SHADING_MODEL == 0) {
         vec3 halfAngle = normalize(directionToLight + viewDirection);
         float blinnTerm = dot(surfaceNormal, halfAngle);
         blinnTerm = clamp(blinnTerm, 0, 1);
         blinnTerm = pow(blinnTerm, 32.0); // higher values -> sharper highlights
-        specularLight = light.color.xyz * intensity * blinnTerm; 
+        specularLight += light.color.xyz * intensity * blinnTerm;
+    }
+}
+
+void main() {
+    diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+    specularLight = vec3(0.0);
+    surfaceNormal = normalize(fragNormalWorld);
+
+    vec3 cameraPosWorld = ubo.invView[3].xyz;   // 逆视图矩阵最后一列为相机在世界空间的位置
+    viewDirection = normalize(cameraPosWorld - fragPosWorld);
+
+    if (FIXED_LIGHT_COUNT > 0) {
+        /*光源数量在特化时固定：循环次数为常量*/
+        for (int i = 0; i < FIXED_LIGHT_COUNT; i++) {
+            AddPointLight(uint(i));
+        }
+    } else if (!CLUSTERED_LIGHTING || ubo.clusterGrid.w == 0u) {
+        /*未分簇：遍历所有点光源*/
+        for (int i = 0; i < ubo.numLights; i++) {
+            AddPointLight(uint(i));
+        }
+    } else {
+        /*只遍历片段所在簇的光源列表；gl_FragCoord.w为1 / 视图空间深度*/
+        vec2 tile = floor(gl_FragCoord.xy * ubo.clusterParams.zw * vec2(ubo.clusterGrid.xy));
+        tile = clamp(tile, vec2(0.0), vec2(ubo.clusterGrid.xy) - 1.0);
+        float slice = floor(log(1.0 / gl_FragCoord.w) * ubo.clusterParams.x + ubo.clusterParams.y);
+        slice = clamp(slice, 0.0, float(ubo.clusterGrid.z) - 1.0);
+
+        uint cluster = uint(tile.x) + ubo.clusterGrid.x * (uint(tile.y) + ubo.clusterGrid.y * uint(slice));
+        uint count = lightCounts[cluster];
+        uint first = cluster * ubo.clusterGrid.w;
+        for (uint i = 0; i < count; i++) {
+            AddPointLight(lightIndices[first + i]);
+        }
     }
 
 	outColor = vec4(diffuseLight * fragColor + specularLight * fragColor, 1.0);
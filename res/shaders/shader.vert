@@ -9,31 +9,33 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;    // 顶点世界位置
 layout(location = 2) out vec3 fragNormalWorld;    //片段中的法线
 
-struct PointLight {
-    vec4 position;  // ignore w
-    vec4 color;     // w is intensity
-};
-
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projection;
     mat4 view;
     mat4 invView;
     vec4 ambientLightColor;
-    PointLight pointLights[10]; //应使用特化常量而非硬编码
-    int numLights;
+    uvec4 clusterGrid;      // xyz: 分簇网格尺寸, w: 每簇最多光源数（0表示不分簇）
+    vec4 clusterParams;     // x: 深度切片scale, y: bias, zw: 1 / 屏幕尺寸
+    int numLights;  // 点光源数据在binding 1的存储缓冲区中
 }ubo;
 
-layout(push_constant) uniform Push {
+struct InstanceData {
     mat4 modelMatrix;
     mat4 normalMatrix;
-} push;
+};
+
+// 每个实例的矩阵，gl_InstanceIndex已包含绘制时的firstInstance
+layout(std430, set = 1, binding = 0) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
 
 void main() {
-    vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);    // 先将顶点从模型坐标系转换到世界坐标系，再计算光源方向
+    InstanceData instance = instances[gl_InstanceIndex];
+    vec4 positionWorld = instance.modelMatrix * vec4(position, 1.0);    // 先将顶点从模型坐标系转换到世界坐标系，再计算光源方向
 
-    gl_Position = ubo.projection * ubo.view * push.modelMatrix * vec4(position, 1.0);
+    gl_Position = ubo.projection * ubo.view * positionWorld;
 
-    fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+    fragNormalWorld = normalize(mat3(instance.normalMatrix) * normal);
     fragPosWorld = positionWorld.xyz;
     fragColor = color;
 }
\ No newline at end of file
@@ -1,35 +1,85 @@
 ﻿#include "FirstApp.h"
 
 #include "lve/LveBuffer.h"
+#include "lve/LveThreadPool.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <array>
 #include <iostream>
 #include <numeric>
+#include <cstring>
+#include <cstdlib>
+#include <random>
 
 namespace lve {
 
 static constexpr float ORBIT_SENS = 0.005f; // 每像素旋转弧度
 static constexpr float PAN_SENS = 0.002f;   // 每像素平移比例
 static constexpr float DOLLY_RATE = 0.12f;    // 滚轮step的缩放比率
+static constexpr uint32_t MIN_LIGHT_CAPACITY = 64;
+static constexpr int32_t MAX_UNROLLED_LIGHTS = 16;  // 不分簇且光源不超过该数量时按固定数量特化光照循环
 
-FirstApp::FirstApp(void* nativeWindowHandle, void* nativeInstanceHandle, int w, int h, std::string name)
+FirstAppOptions FirstAppOptions::FromCommandLine(int argc, char* argv[])
+{
+    FirstAppOptions options{};
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--indirect") == 0) {
+            options.indirectDraw = true;
+        }
+        else if (std::strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+            int count = std::atoi(argv[++i]);
+            options.lightCount = count > 0 ? static_cast<uint32_t>(count) : 0;
+        }
+        else if (std::strcmp(argv[i], "--no-light-clusters") == 0) {
+            options.lightClusters = false;
+        }
+        else if (std::strcmp(argv[i], "--deferred") == 0) {
+            options.deferred = true;
+        }
+        else if (std::strcmp(argv[i], "--no-specular") == 0) {
+            options.specular = false;
+        }
+    }
+    return options;
+}
+
+FirstApp::FirstApp(void* nativeWindowHandle, void* nativeInstanceHandle, int w, int h, std::string name,
+    const FirstAppOptions& options)
+    : m_options{ options }
 {
     SetLveComponants(nativeWindowHandle, nativeInstanceHandle, w, h, name);
-    LoadObjects();
+    LoadObjects();    // 模型在工作线程上加载，不阻塞第一帧
+
+    /*输出各内存堆的分配情况*/
+    for (const auto& heap : m_lveDevice->queryMemoryHeapUsage()) {
+        if (heap.blockCount == 0) continue;
+        std::cout << "memory heap " << heap.heapIndex
+            << ": blocks " << heap.blockCount
+            << ", allocations " << heap.allocationCount
+            << ", used " << heap.allocationBytes / 1024 << " KiB / "
+            << heap.blockBytes / 1024 << " KiB"
+            << ", budget " << heap.budget / (1024 * 1024) << " MiB\n";
+    }
 }
 
 void FirstApp::SetLveComponants(void* nativeWindowHandle, void* nativeInstanceHandle, int w, int h, std::string name)
 {
     m_lveWindow = std::make_unique<LveWindow>(nativeWindowHandle, nativeInstanceHandle, w, h, name);
     m_lveDevice = std::make_unique<LveDevice>(*m_lveWindow);
-    m_lveRenderer = std::make_unique<LveRenderer>(*m_lveWindow, *m_lveDevice);
+    if (m_options.indirectDraw) {
+        /*所有模型放进同一对大缓冲区，供间接绘制使用*/
+        m_meshPool = std::make_unique<LveMeshPool>(*m_lveDevice);
+    }
+    m_assetManager = std::make_unique<LveAssetManager>(*m_lveDevice, m_meshPool.get());
+    m_lveRenderer = std::make_unique<LveRenderer>(*m_lveWindow, *m_lveDevice, m_options.deferred);
     m_lveCamera = std::make_unique<LveCamera>();
 
     /*ubo*/
     m_globalPool = LveDescriptorPool::Builder(*m_lveDevice)
         .SetMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
         .AddPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
         .Build();
 
     m_uboBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT); //2
@@ -44,26 +94,85 @@ void FirstApp::SetLveComponants(void* nativeWindowHandle, void* nativeInstanceHa
         m_uboBuffers[i]->Map();
     }
 
+    /*点光源*/
+    m_lightBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < m_lightBuffers.size(); i++) {
+        m_lightBuffers[i] = std::make_unique<LveBuffer>(
+            *m_lveDevice,
+            sizeof(PointLight),
+            MIN_LIGHT_CAPACITY,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        );
+        m_lightBuffers[i]->Map();
+    }
+
+    /*分簇计算着色器同样使用全局描述符集，binding 2/3由它写入、shader.frag读取*/
     m_globalSetLayout = LveDescriptorSetLayout::Builder(*m_lveDevice)
-        .AddBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+        .AddBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT)
+        .AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+        .AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+        .AddBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
         .Build();
+    /*各系统只登记管线，构造完后统一在线程池上并行编译*/
+    m_pipelineQueue = std::make_unique<LvePipelineQueue>(*m_lveDevice);
+    LvePipelineQueue& pipelineQueue = *m_pipelineQueue;
+    /*动态渲染时GetSwapChainRenderPass为空，管线只依赖附件格式，交换链重建不影响管线*/
+    if (m_lveRenderer->UsesDynamicRendering()) {
+        pipelineQueue.SetAttachmentFormats(m_lveRenderer->GetSwapChainImageFormat(), m_lveRenderer->GetSwapChainDepthFormat());
+    }
+    m_lightClusterSystem = std::make_unique<LightClusterSystem>(*m_lveDevice, pipelineQueue, *m_globalSetLayout);
+    m_lightClusterSystem->SetEnabled(m_options.lightClusters);
+
     m_globalDescriptorSets.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
     for (int i = 0; i < m_globalDescriptorSets.size(); i++) {
         auto bufferInfo = m_uboBuffers[i]->DescriptorInfo();
+        auto lightInfo = m_lightBuffers[i]->DescriptorInfo();
+        auto clusterCountInfo = m_lightClusterSystem->GetLightCountInfo(i);
+        auto clusterIndexInfo = m_lightClusterSystem->GetLightIndexInfo(i);
         LveDescriptorWriter(*m_globalSetLayout, *m_globalPool)
             .WriteBuffer(0, &bufferInfo)
+            .WriteBuffer(1, &lightInfo)
+            .WriteBuffer(2, &clusterCountInfo)
+            .WriteBuffer(3, &clusterIndexInfo)
             .Build(m_globalDescriptorSets[i]);
     }
 
-    m_renderSystem = std::make_unique<RenderSystem>(*m_lveDevice, 
-        m_lveRenderer->GetSwapChainRenderPass(), m_globalSetLayout->GetDescriptorSetLayout());
-    m_pointLightSystem = std::make_unique<PointLightSystem>(*m_lveDevice,
-        m_lveRenderer->GetSwapChainRenderPass(), m_globalSetLayout->GetDescriptorSetLayout());
+    /*分簇开关在启动时确定；不分簇时每个可展开的光源数量各编译一个变体*/
+    LightingSpecializations lighting{};
+    lighting.base = MakeLightingSpecialization(0);
+    if (!m_options.lightClusters) {
+        for (int32_t count = 1; count <= MAX_UNROLLED_LIGHTS; count++) {
+            lighting.variants.push_back(MakeLightingSpecialization(count));
+        }
+    }
+
+    m_renderSystem = std::make_unique<RenderSystem>(*m_lveDevice, pipelineQueue,
+        m_lveRenderer->GetSwapChainRenderPass(), *m_globalSetLayout, lighting, m_options.deferred);
+    if (m_options.indirectDraw) {
+        m_renderSystem->SetIndirectDrawEnabled(true);
+    }
+    /*延迟模式下：几何写入子通道0，光照与点光源公告板在子通道1*/
+    if (m_options.deferred) {
+        m_deferredLightingSystem = std::make_unique<DeferredLightingSystem>(*m_lveDevice, pipelineQueue,
+            m_lveRenderer->GetSwapChainRenderPass(), *m_globalSetLayout, lighting);
+    }
+    m_pointLightSystem = std::make_unique<PointLightSystem>(*m_lveDevice, pipelineQueue,
+        m_lveRenderer->GetSwapChainRenderPass(), *m_globalSetLayout, m_options.deferred ? 1u : 0u);
+
+    /*计时用于对比管线缓存冷/热启动*/
+    size_t pipelineCount = pipelineQueue.GetPendingCount();
+    auto pipelineStart = std::chrono::high_resolution_clock::now();
+    pipelineQueue.Compile();
+    double pipelineMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipelineStart).count();
+    std::cout << "pipeline creation: " << pipelineCount << " pipelines on "
+        << LveThreadPool::Shared().GetThreadCount() << " threads, " << pipelineMs << " ms ("
+        << (m_lveDevice->isPipelineCacheWarm() ? "warm" : "cold") << " pipeline cache)\n";
 
     m_lastTick = std::chrono::high_resolution_clock::now();
 }
 
-void FirstApp::runFrame()
+bool FirstApp::runFrame()
 {
     if (m_lveWindow->WasWindowResized()) {
         m_lveWindow->ResetWindowResizedFlag();
@@ -76,8 +185,15 @@ void FirstApp::runFrame()
 
     VkCommandBuffer commandBuffer = m_lveRenderer->BeginFrame();
     if (commandBuffer == nullptr) {
-        /*此处不做任何阻塞，等待下一次QTimer*/
-        return;
+        /*此处不做任何阻塞，由渲染线程决定何时重试*/
+        return false;
+    }
+
+    /*修改过的着色器在后台重新编译，完成后在这里换入*/
+    m_pipelineQueue->ReloadChangedShaders(m_lveRenderer->GetSwapChainRenderPass());
+    /*被释放的网格池区间在所有在途帧结束后才复用*/
+    if (m_meshPool) {
+        m_meshPool->NextFrame();
     }
 
     /*设置相机的视图与投影*/
@@ -93,7 +209,7 @@ void FirstApp::runFrame()
         commandBuffer,
         *m_lveCamera,
         m_globalDescriptorSets[frameIndex],
-        m_objects
+        m_scene
     };
 
     /*将PV矩阵写入UBO*/
@@ -101,49 +217,113 @@ void FirstApp::runFrame()
     ubo.projection = m_lveCamera->GetProjection();
     ubo.view = m_lveCamera->GetView();
     ubo.inverseView = m_lveCamera->GetInverseView();
-    m_pointLightSystem->Update(frameInfo, ubo);
+    ReserveLightBuffer(frameIndex, static_cast<uint32_t>(m_scene.View<PointLightComponent>().Size()));
+    /*先修改局部变换，传播世界矩阵后再读取光源的世界位置*/
+    m_pointLightSystem->Animate(frameInfo);
+    m_scene.UpdateTransforms();
+    m_pointLightSystem->Update(frameInfo, ubo, *m_lightBuffers[frameIndex]);
+    m_lightClusterSystem->Update(frameInfo, ubo, m_lveRenderer->GetSwapChainExtent());
+
+    /*光照管线变体：不分簇且光源较少时固定光源数量，组合都已在启动时编译*/
+    int32_t fixedLightCount = !m_options.lightClusters && ubo.numLights <= MAX_UNROLLED_LIGHTS ? ubo.numLights : 0;
+    m_lightingVariant = MakeLightingSpecialization(fixedLightCount);
+    frameInfo.lightingVariant = &m_lightingVariant;
     m_uboBuffers[frameIndex]->WriteToBuffer(&ubo);
 
+    /*RenderPass外的计算通道：点光源分簇，间接绘制模式下的视锥剔除*/
+    m_lightClusterSystem->BuildClusters(frameInfo);
+    m_renderSystem->CullObjects(frameInfo);
+
     /*进入本帧的主RenderPass*/
     m_lveRenderer->BeginSwapChainRenderPass(commandBuffer);
 
     /*绘制*/
     m_renderSystem->RenderObjects(frameInfo);
+    if (m_deferredLightingSystem) {
+        m_lveRenderer->NextSubpass(commandBuffer);
+        m_deferredLightingSystem->Render(frameInfo, *m_lveRenderer);
+    }
     m_pointLightSystem->Render(frameInfo);
+    PrintFrameStats(now);
 
     /*结束本帧RenderPass并提交*/
     m_lveRenderer->EndSwapChainRenderPass(commandBuffer);
     m_lveRenderer->EndFrame();
+    return true;
+}
+
+/*剔除结果或变换重算数量变化时输出，最多每秒一次；点光源基准场景每秒输出平均帧时间*/
+void FirstApp::PrintFrameStats(std::chrono::high_resolution_clock::time_point now)
+{
+    m_statsFrameCount++;
+    m_statsFrameTimeSec += m_frameTimeSec;
+    if (now - m_lastStatsReport < std::chrono::seconds(1)) {
+        return;
+    }
+
+    if (m_options.lightCount > 0) {
+        m_lastStatsReport = now;
+        std::cout << "lights: " << m_scene.View<PointLightComponent>().Size()
+            << (m_lightClusterSystem->IsEnabled() ? " clustered" : " unclustered")
+            << ", frame: " << m_statsFrameTimeSec / m_statsFrameCount * 1000.f << " ms\n";
+        m_statsFrameCount = 0;
+        m_statsFrameTimeSec = 0.f;
+    }
+
+    RenderSystem::CullStats stats = m_renderSystem->GetCullStats();
+    uint32_t transformUpdates = m_scene.GetTransformUpdateCount();
+    if (stats.total == m_lastCullStats.total && stats.visible == m_lastCullStats.visible
+        && transformUpdates == m_lastTransformUpdates) {
+        return;
+    }
+    m_lastStatsReport = now;
+    m_lastCullStats = stats;
+    m_lastTransformUpdates = transformUpdates;
+    std::cout << "cull: " << stats.visible << " / " << stats.total << " visible, "
+        << (stats.total - stats.visible) << " culled; transforms recomputed: " << transformUpdates << "\n";
+}
+
+void FirstApp::ReserveLightBuffer(int frameIndex, uint32_t count)
+{
+    if (count <= m_lightBuffers[frameIndex]->GetInstanceCount()) {
+        return;
+    }
+
+    /*BeginFrame已等待本帧的fence，旧缓冲区和描述符集都不再被GPU使用*/
+    uint32_t capacity = (std::max)(count, m_lightBuffers[frameIndex]->GetInstanceCount() * 2);
+    m_lightBuffers[frameIndex] = std::make_unique<LveBuffer>(
+        *m_lveDevice,
+        sizeof(PointLight),
+        capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    );
+    m_lightBuffers[frameIndex]->Map();
+
+    auto lightInfo = m_lightBuffers[frameIndex]->DescriptorInfo();
+    LveDescriptorWriter(*m_globalSetLayout, *m_globalPool)
+        .WriteBuffer(1, &lightInfo)
+        .Overwrite(m_globalDescriptorSets[frameIndex]);
 }
 
 void FirstApp::LoadObjects() {
-    std::shared_ptr<LveModel> lveModel = LveModel::CreateModelFromFile(*m_lveDevice, "res/models/flat_vase.obj");
-    auto flatVase = LveObject::CreateObject();
-    flatVase.model = lveModel;
-    flatVase.transform.translation = { -.5f, .5f, 0.f };
-    // gameObj.transform.scale = glm::vec3(3.f);
-    flatVase.transform.scale = { 3.f, 1.5f, 3.f };
-    m_objects.emplace(flatVase.getId(), std::move(flatVase));
-
-    lveModel = LveModel::CreateModelFromFile(*m_lveDevice, "res/models/smooth_vase.obj");
-    auto smoothVase = LveObject::CreateObject();
-    smoothVase.model = lveModel;
-    smoothVase.transform.translation = { .5f, .5f, 0.f };
-    // gameObj.transform.scale = glm::vec3(3.f);
-    smoothVase.transform.scale = { 3.f, 1.5f, 3.f };
-    m_objects.emplace(smoothVase.getId(), std::move(smoothVase));
+    TransformComponent transform{};
+    transform.translation = { -.5f, .5f, 0.f };
+    // transform.scale = glm::vec3(3.f);
+    transform.scale = { 3.f, 1.5f, 3.f };
+    m_scene.CreateModelEntity(m_assetManager->LoadModel("res/models/flat_vase.obj"), transform);
+
+    transform.translation = { .5f, .5f, 0.f };
+    transform.scale = { 3.f, 1.5f, 3.f };
+    m_scene.CreateModelEntity(m_assetManager->LoadModel("res/models/smooth_vase.obj"), transform);
 
     /*地板*/
-    lveModel = LveModel::CreateModelFromFile(*m_lveDevice, "D:/Data/Study/vulkan/FirstApp/res/models/quad.obj");
-    auto quad = LveObject::CreateObject();
-    quad.model = lveModel;
-    quad.transform.translation = { 0.f, .5f, 0.f };
-    quad.transform.scale = { 3.f, 1.f, 3.f };
-    m_objects.emplace(quad.getId(), std::move(quad));
+    transform.translation = { 0.f, .5f, 0.f };
+    transform.scale = { 3.f, 1.f, 3.f };
+    m_scene.CreateModelEntity(m_assetManager->LoadModel("D:/Data/Study/vulkan/FirstApp/res/models/quad.obj"), transform);
 
     /*原点点光源*/
-    auto pointLight = LveObject::MakePointLight(0.2f);
-    m_objects.emplace(pointLight.getId(), std::move(pointLight));
+    m_scene.CreatePointLight(0.2f);
 
     std::vector<glm::vec3> lightColors{
         {1.f, .1f, .1f},
@@ -155,11 +335,31 @@ void FirstApp::LoadObjects() {
     };
 
     for (int i = 0; i < lightColors.size(); i++) {
-        auto pointLight = LveObject::MakePointLight(0.2f);
-        pointLight.color = lightColors[i];
+        LveEntity pointLight = m_scene.CreatePointLight(0.2f, 0.1f, lightColors[i]);
         auto rotateLight = glm::rotate(glm::mat4(1.f), (i * glm::two_pi<float>()) / lightColors.size(), { 0.f, -1.f, 0.f });
-        pointLight.transform.translation = glm::vec3(rotateLight * glm::vec4(-1.f, -1.f, -1.f, 1.f));
-        m_objects.emplace(pointLight.getId(), std::move(pointLight));
+        m_scene.Get<TransformComponent>(pointLight).translation = glm::vec3(rotateLight * glm::vec4(-1.f, -1.f, -1.f, 1.f));
+    }
+
+    if (m_options.lightCount > 0) {
+        LoadBenchmarkLights(m_options.lightCount);
+    }
+}
+
+/* 光源均匀分布在地板（x、z在[-3, 3]，y = 0.5）上方
+ * 影响半径随数量缩小，每个位置被覆盖的光源数大致不变，分簇列表不会溢出
+ */
+void FirstApp::LoadBenchmarkLights(uint32_t count)
+{
+    std::mt19937 rng{ 1234 };
+    std::uniform_real_distribution<float> horizontal(-3.f, 3.f);
+    std::uniform_real_distribution<float> height(.2f, .45f);
+    std::uniform_real_distribution<float> channel(.2f, 1.f);
+
+    float range = .4f * std::sqrt(1000.f / count);
+    for (uint32_t i = 0; i < count; i++) {
+        LveEntity pointLight = m_scene.CreatePointLight(.05f, .02f, { channel(rng), channel(rng), channel(rng) });
+        m_scene.Get<PointLightComponent>(pointLight).range = range;
+        m_scene.Get<TransformComponent>(pointLight).translation = { horizontal(rng), height(rng), horizontal(rng) };
     }
 }
 
@@ -222,17 +422,31 @@ void FirstApp::ResetView()
     m_orbit.pitch = 0.f;
 }
 
+/*与shader.frag、deferred_lighting.frag的特化常量对应，分簇与着色模型取自启动选项*/
+LveSpecialization FirstApp::MakeLightingSpecialization(int32_t fixedLightCount) const
+{
+    LveSpecialization specialization;
+    specialization.SetBool(LIGHTING_CLUSTERED, m_options.lightClusters)
+        .SetInt(LIGHTING_FIXED_LIGHT_COUNT, fixedLightCount)
+        .SetInt(LIGHTING_SHADING_MODEL, m_options.specular ? SHADING_BLINN_PHONG : SHADING_LAMBERT);
+    return specialization;
+}
+
 void FirstApp::WaitIdle()
 {
     if (m_lveDevice) {
-        vkDeviceWaitIdle(m_lveDevice->device());
+        m_lveDevice->waitIdle();
     }
 }
 
 FirstApp::~FirstApp()
 {
+    /*先让加载线程结束，它们会向传输队列提交*/
+    if (m_assetManager) {
+        m_assetManager->WaitIdle();
+    }
     if (m_lveDevice) {
-        vkDeviceWaitIdle(m_lveDevice->device());
+        m_lveDevice->waitIdle();
     }
 }
 
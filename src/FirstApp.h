@@ -6,7 +6,13 @@
 #include "lve/LveCamera.h"
 #include "lve/systems/RenderSystem.h"
 #include "lve/systems/PointLightSystem.h"
+#include "lve/systems/LightClusterSystem.h"
+#include "lve/systems/DeferredLightingSystem.h"
 #include "lve/LveDescriptors.h"
+#include "lve/LvePipelineQueue.h"
+#include "lve/LveAssetManager.h"
+#include "lve/LveMeshPool.h"
+#include "lve/LveScene.h"
 
 #include <memory>
 #include <vector>
@@ -14,9 +20,21 @@
 
 namespace lve {
 
+/*命令行启动选项*/
+struct FirstAppOptions {
+	bool indirectDraw = false;	// --indirect：静态场景使用共享大缓冲区 + 间接绘制
+	uint32_t lightCount = 0;	// --lights N：额外生成N个随机点光源的基准场景，每秒输出平均帧时间
+	bool lightClusters = true;	// --no-light-clusters：关闭分簇，逐片段遍历所有点光源
+	bool deferred = false;		// --deferred：G-buffer + 光照子通道的延迟渲染，光照按像素而不是按绘制的片段计算
+	bool specular = true;		// --no-specular：只计算Lambert漫反射，通过特化常量选择管线变体
+
+	static FirstAppOptions FromCommandLine(int argc, char* argv[]);
+};
+
 class FirstApp {
 public:
-	FirstApp(void* nativeWindowHandle, void* nativeInstanceHandle, int w, int h, std::string name);
+	FirstApp(void* nativeWindowHandle, void* nativeInstanceHandle, int w, int h, std::string name,
+		const FirstAppOptions& options = {});
 	~FirstApp();
 
 	FirstApp(const FirstApp&) = delete;
@@ -24,9 +42,10 @@ public:
 
 	LveWindow* GetLveWindow() const { return m_lveWindow.get(); }
 
-	void runFrame();
+	/*录制并提交一帧；没有可用的交换链图像（窗口最小化或交换链刚重建）时返回false*/
+	bool runFrame();
 	void WaitIdle();
-	/*交互接口*/
+	/*交互接口，只在调用runFrame的线程上调用*/
 	void Orbit(float dxPixels, float dyPixels);	// 左键拖拽旋转
 	void Pan(float dxPixels, float dyPixels);	// 中键平移
 	void Dolly(float steps);					// 滚轮缩放
@@ -42,26 +61,46 @@ private:
 
 	std::unique_ptr<LveWindow> m_lveWindow;
 	std::unique_ptr<LveDevice> m_lveDevice;
+	std::unique_ptr<LveMeshPool> m_meshPool;
+	std::unique_ptr<LveAssetManager> m_assetManager;
     std::unique_ptr<LveRenderer> m_lveRenderer;
 	std::unique_ptr<LveCamera> m_lveCamera;
 	std::unique_ptr<RenderSystem> m_renderSystem;
 	std::unique_ptr<PointLightSystem> m_pointLightSystem;
+	std::unique_ptr<LightClusterSystem> m_lightClusterSystem;
+	std::unique_ptr<DeferredLightingSystem> m_deferredLightingSystem;	// 只在延迟模式下创建
+	std::unique_ptr<LvePipelineQueue> m_pipelineQueue;	// 保留各系统的管线登记用于着色器热重载，先于各系统析构
 	std::unique_ptr<LveDescriptorPool> m_globalPool;
 	std::vector<std::unique_ptr<LveBuffer>> m_uboBuffers;
+	std::vector<std::unique_ptr<LveBuffer>> m_lightBuffers;	// 每帧的点光源存储缓冲区，按场景中的点光源数量扩容
 	std::unique_ptr<LveDescriptorSetLayout> m_globalSetLayout;
 	std::vector<VkDescriptorSet> m_globalDescriptorSets;
+	LveSpecialization m_lightingVariant;	// 每帧按光源数量更新，光照管线据此选择预编译的变体
 
-	LveObject::Map m_objects;
+	LveScene m_scene;
 
 	glm::vec3 m_cameraTraget{ 0.f, 0.f, 1.f };
 	float m_cameraDistance{ 0.1f };
 
 	std::chrono::high_resolution_clock::time_point m_lastTick{};
+	std::chrono::high_resolution_clock::time_point m_lastStatsReport{};
+	RenderSystem::CullStats m_lastCullStats{};
+	uint32_t m_lastTransformUpdates = 0;
+	uint32_t m_statsFrameCount = 0;		// 上次输出以来的帧数与总帧时间，用于平均帧时间
+	float m_statsFrameTimeSec = 0.f;
 	float m_frameTimeSec = 0.f;
 
+	FirstAppOptions m_options;
+
 	void SetLveComponants(void* nativeWindowHandle, void* nativeInstanceHandle, int w, int h, std::string name);
 	void LoadObjects();
+	/*在地板上方随机生成count个小半径点光源*/
+	void LoadBenchmarkLights(uint32_t count);
 	void UpdateCameraFromOrbit();
+	LveSpecialization MakeLightingSpecialization(int32_t fixedLightCount) const;
+	void PrintFrameStats(std::chrono::high_resolution_clock::time_point now);
+	/*确保本帧的点光源缓冲区能容纳count个点光源，不够时按倍数扩容并重写全局描述符集的binding 1*/
+	void ReserveLightBuffer(int frameIndex, uint32_t count);
 
 };
 
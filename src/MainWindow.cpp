@@ -5,15 +5,14 @@
 #include <QPushButton>
 #include <QHBoxLayout>
 #include <QVBoxLayout>
-#include <QTimer>
 #include <QEvent>
 #include <QMouseEvent>
 
 #include <windows.h>
 #include <iostream>
 
-MainWindow::MainWindow(QWidget* parent)
-    : QMainWindow(parent), m_renderWidget(new QWidget(this)), m_renderTimer(new QTimer(this)), m_buttonWidget(new QWidget(this))
+MainWindow::MainWindow(const lve::FirstAppOptions& options, QWidget* parent)
+    : QMainWindow(parent), m_renderWidget(new QWidget(this)), m_buttonWidget(new QWidget(this)), m_options(options)
 {
     setWindowTitle("FirstApp");
 
@@ -44,13 +43,11 @@ void MainWindow::InitRenderWidget()
     m_renderWidget->installEventFilter(this);
 
     /*创建vulkanApp，传入Qt窗口句柄*/
-    m_vulkanApp = std::make_unique<lve::FirstApp>(hwnd, hinstance, 800, 600, "Vulkan App");
+    m_vulkanApp = std::make_unique<lve::FirstApp>(hwnd, hinstance, 800, 600, "Vulkan App", m_options);
 
-    /*启动渲染循环*/
-    connect(m_renderTimer, &QTimer::timeout, [this]() {
-        m_vulkanApp->runFrame();
-        });
-    m_renderTimer->start(16); // 60 FPS
+    /*启动渲染线程，帧率由交换链的呈现模式决定*/
+    m_renderThread = std::make_unique<lve::RenderThread>(*m_vulkanApp);
+    m_renderThread->Start();
 
 }
 
@@ -68,7 +65,7 @@ void MainWindow::InitUI()
     buttonLayout->addWidget(btnQuit);
 
     connect(btnReset, &QPushButton::clicked, [this]() {
-        m_vulkanApp->ResetView();
+        m_renderThread->Post({ lve::RenderInput::Type::ResetView });
     });
 }
 
@@ -91,12 +88,13 @@ bool MainWindow::eventFilter(QObject* obj, QEvent* event)
                 auto* e = static_cast<QMouseEvent*>(event);
                 QPoint d = e->pos() - m_lastPos;
                 m_lastPos = e->pos();
-                if(!m_vulkanApp) return true;
+                if(!m_renderThread) return true;
+                /*交互状态在渲染线程上修改，这里只投递增量*/
                 if (m_leftDown) {
-                    m_vulkanApp->Orbit(d.x(), d.y());
+                    m_renderThread->Post({ lve::RenderInput::Type::Orbit, float(d.x()), float(d.y()) });
                 }
                 else if (m_midDown || m_rightDown) {
-                    m_vulkanApp->Pan(-d.x(), d.y());
+                    m_renderThread->Post({ lve::RenderInput::Type::Pan, float(-d.x()), float(d.y()) });
                 }
                 return true;
             }
@@ -123,8 +121,8 @@ bool MainWindow::eventFilter(QObject* obj, QEvent* event)
                     steps = float(e->angleDelta().y()) / 120.f;
                 }
 
-                if (m_vulkanApp && steps != 0.f) {
-                    m_vulkanApp->Dolly(steps);
+                if (m_renderThread && steps != 0.f) {
+                    m_renderThread->Post({ lve::RenderInput::Type::Dolly, steps });
                 }
                 return true;
             }
@@ -146,16 +144,14 @@ void MainWindow::resizeEvent(QResizeEvent* event)
 
 void MainWindow::closeEvent(QCloseEvent* e) 
 {
-    if (m_renderTimer) m_renderTimer->stop();
+    if (m_renderThread) m_renderThread->Stop();
     QMainWindow::closeEvent(e);
 }
 
 MainWindow::~MainWindow()
 {
-    if (m_renderTimer) {
-        m_renderTimer->stop();
-        disconnect(m_renderTimer, nullptr, this, nullptr);
-    }
+    /*先停止渲染线程，之后FirstApp只在GUI线程上使用*/
+    m_renderThread.reset();
 
     if (m_vulkanApp) {
         /*等待GPU完成所有命令*/
@@ -3,18 +3,18 @@
 #include <QtWidgets/QMainWindow>
 
 #include "FirstApp.h"
+#include "RenderThread.h"
 
 #include <memory>
 
 class VulkanWindow;
-class QTimer;
 
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
 public:
-    explicit MainWindow(QWidget* parent = nullptr);
+    explicit MainWindow(const lve::FirstAppOptions& options = {}, QWidget* parent = nullptr);
     ~MainWindow();
 
 protected:
@@ -25,8 +25,9 @@ protected:
 private:
     QWidget* m_renderWidget;
     QWidget* m_buttonWidget;
-    QTimer* m_renderTimer;
     std::unique_ptr<lve::FirstApp> m_vulkanApp;
+    std::unique_ptr<lve::RenderThread> m_renderThread;   // 驱动m_vulkanApp的帧循环，先于它析构
+    lve::FirstAppOptions m_options;
 
     /*窗口交互转台*/
     QPoint m_lastPos;
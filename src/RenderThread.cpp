@@ -0,0 +1,70 @@
+﻿#include "RenderThread.h"
+
+#include <chrono>
+
+namespace lve {
+
+RenderThread::RenderThread(FirstApp& app)
+    : m_app{ app }
+{
+}
+
+RenderThread::~RenderThread()
+{
+    Stop();
+}
+
+void RenderThread::Start()
+{
+    if (m_running.exchange(true)) {
+        return;
+    }
+    m_thread = std::thread([this]() { Run(); });
+}
+
+void RenderThread::Stop()
+{
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool RenderThread::Post(const RenderInput& input)
+{
+    return m_inputQueue.TryPush(input);
+}
+
+void RenderThread::Run()
+{
+    while (m_running.load()) {
+        ApplyInput();
+        if (!m_app.runFrame()) {
+            /*窗口最小化时拿不到交换链图像，让出CPU后重试*/
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+void RenderThread::ApplyInput()
+{
+    RenderInput input;
+    while (m_inputQueue.TryPop(input)) {
+        switch (input.type) {
+            case RenderInput::Type::Orbit:
+                m_app.Orbit(input.x, input.y);
+                break;
+            case RenderInput::Type::Pan:
+                m_app.Pan(input.x, input.y);
+                break;
+            case RenderInput::Type::Dolly:
+                m_app.Dolly(input.x);
+                break;
+            case RenderInput::Type::ResetView:
+                m_app.ResetView();
+                break;
+        }
+    }
+}
+
+}  // namespace lve
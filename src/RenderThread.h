@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include "FirstApp.h"
+#include "lve/LveSpscQueue.h"
+
+#include <atomic>
+#include <thread>
+
+namespace lve {
+
+/*GUI线程发往渲染线程的交互输入，参数含义与FirstApp的交互接口一致*/
+struct RenderInput {
+	enum class Type { Orbit, Pan, Dolly, ResetView };
+	Type type = Type::Orbit;
+	float x = 0.f;	// Orbit/Pan：像素偏移x，Dolly：滚轮步数
+	float y = 0.f;
+};
+
+/* 独占FirstApp帧循环的渲染线程
+ * 帧率只受交换链呈现模式限制，不再与Qt事件循环串行；GUI线程的输入经无锁队列在每帧开始前应用
+ * Start之后FirstApp只能由渲染线程使用（窗口尺寸通知除外），Stop返回后才能在其他线程WaitIdle或销毁
+ */
+class RenderThread {
+public:
+	explicit RenderThread(FirstApp& app);
+	~RenderThread();
+
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	void Start();
+	/*等待当前帧提交后返回，可重复调用*/
+	void Stop();
+
+	/*只在GUI线程调用；队列满时丢弃该输入并返回false*/
+	bool Post(const RenderInput& input);
+
+private:
+	static constexpr size_t INPUT_CAPACITY = 1024;	// 每帧都会清空，远大于两帧之间的鼠标事件数
+
+	void Run();
+	void ApplyInput();
+
+	FirstApp& m_app;
+	LveSpscQueue<RenderInput, INPUT_CAPACITY> m_inputQueue;
+	std::atomic<bool> m_running{ false };
+	std::thread m_thread;
+};
+
+}  // namespace lve
@@ -0,0 +1,87 @@
+﻿#include "LveAssetManager.h"
+
+#include "LveThreadPool.h"
+
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+
+namespace lve {
+
+LveAssetManager::LveAssetManager(LveDevice& device, LveMeshPool* meshPool)
+	: m_lveDevice{ device }, m_meshPool{ meshPool }
+{
+}
+
+LveAssetManager::~LveAssetManager()
+{
+	/*工作线程持有模型和设备引用，必须在设备销毁前结束*/
+	WaitIdle();
+}
+
+std::shared_ptr<LveModel> LveAssetManager::LoadModel(const std::string& filepath)
+{
+	/*规范化路径，"a/../b.obj"与"b.obj"视为同一资源*/
+	std::string key = std::filesystem::path(filepath).lexically_normal().generic_string();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_models.find(key);
+	if (it != m_models.end()) {
+		return it->second;
+	}
+
+	auto model = std::make_shared<LveModel>(m_lveDevice);
+	m_models.emplace(key, model);
+
+	/*顺手清理已完成的任务*/
+	std::erase_if(m_loads, [](const std::future<void>& load) {
+		return load.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	});
+
+	m_pendingCount++;
+	m_loads.push_back(LveThreadPool::Shared().Submit([this, filepath, model]() { LoadAsync(filepath, model); }));
+	return model;
+}
+
+void LveAssetManager::LoadAsync(const std::string& filepath, std::shared_ptr<LveModel> model)
+{
+	try {
+		LveModel::Builder builder;
+		builder.LoadModel(filepath);
+		model->UploadGeometry(builder, m_meshPool);
+		/*立即提交，不必等到下一帧的flushUploads*/
+		m_lveDevice.flushUploads();
+	}
+	catch (const std::exception& e) {
+		/*加载失败的模型保持占位状态，永远不会被绘制*/
+		std::cerr << "failed to load model " << filepath << ": " << e.what() << "\n";
+	}
+	m_pendingCount--;
+}
+
+void LveAssetManager::ReleaseUnused()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::erase_if(m_models, [](const auto& entry) { return entry.second.use_count() == 1; });
+}
+
+void LveAssetManager::WaitIdle()
+{
+	std::vector<std::future<void>> loads;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		loads.swap(m_loads);
+	}
+	for (auto& load : loads) {
+		load.wait();
+	}
+}
+
+size_t LveAssetManager::GetCachedCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_models.size();
+}
+
+}  // namespace lve
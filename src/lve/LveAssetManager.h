@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include "LveDevice.h"
+#include "LveModel.h"
+#include "LveMeshPool.h"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+/* 异步模型加载与共享缓存
+ * 同一路径只加载一次，所有引用共享同一个LveModel（同一份GPU缓冲）
+ * LoadModel立即返回一个占位模型，解析与上传在工作线程池上完成，
+ * 上传完成前IsResident()为false，渲染系统会跳过它
+ */
+class LveAssetManager {
+public:
+	/*meshPool非空时模型放进共享大缓冲区，可用于间接绘制*/
+	explicit LveAssetManager(LveDevice& device, LveMeshPool* meshPool = nullptr);
+	~LveAssetManager();
+
+	LveAssetManager(const LveAssetManager&) = delete;
+	LveAssetManager& operator=(const LveAssetManager&) = delete;
+
+	std::shared_ptr<LveModel> LoadModel(const std::string& filepath);
+
+	/*释放只被缓存自身引用的模型*/
+	void ReleaseUnused();
+	/*阻塞直到所有已提交的加载任务结束*/
+	void WaitIdle();
+
+	uint32_t GetPendingCount() const { return m_pendingCount.load(); }
+	size_t GetCachedCount();
+
+private:
+	void LoadAsync(const std::string& filepath, std::shared_ptr<LveModel> model);
+
+	LveDevice& m_lveDevice;
+	LveMeshPool* m_meshPool;
+
+	std::mutex m_mutex;
+	std::unordered_map<std::string, std::shared_ptr<LveModel>> m_models;
+	std::vector<std::future<void>> m_loads;
+	std::atomic<uint32_t> m_pendingCount{ 0 };
+};
+
+}  // namespace lve
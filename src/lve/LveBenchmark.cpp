@@ -0,0 +1,224 @@
+﻿#include "LveBenchmark.h"
+
+#include "LveModel.h"
+#include "LveThreadPool.h"
+#include "LveCamera.h"
+#include "LveFrustumCuller.h"
+#include "LveObject.h"
+#include "LveTransformBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace lve {
+
+/*返回最快一次的耗时（秒），以减少缓存和调度抖动的影响*/
+template <typename F>
+static double TimeBest(int iterations, F&& fn)
+{
+	double best = 1e30;
+	for (int i = 0; i < iterations; i++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		fn();
+		auto end = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration<double>(end - start).count();
+		best = seconds < best ? seconds : best;
+	}
+	return best;
+}
+
+int LveBenchmark::Run(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--bench-obj") == 0) {
+			if (i + 1 >= argc) {
+				std::cerr << "usage: --bench-obj <file.obj> [iterations]\n";
+				return 1;
+			}
+			int iterations = (i + 2 < argc) ? std::atoi(argv[i + 2]) : 5;
+			return RunObjLoad(argv[i + 1], iterations > 0 ? iterations : 5);
+		}
+		if (std::strcmp(argv[i], "--bench-cull") == 0) {
+			int iterations = (i + 1 < argc) ? std::atoi(argv[i + 1]) : 20;
+			return RunCull(iterations > 0 ? iterations : 20);
+		}
+		if (std::strcmp(argv[i], "--bench-transform") == 0) {
+			int iterations = (i + 1 < argc) ? std::atoi(argv[i + 1]) : 10;
+			return RunTransform(iterations > 0 ? iterations : 10);
+		}
+	}
+	return -1;
+}
+
+int LveBenchmark::RunObjLoad(const std::string& path, int iterations)
+{
+	try {
+		LveModel::Builder serial;
+		LveModel::Builder parallel;
+
+		double serialSeconds = TimeBest(iterations, [&]() { serial.ParseObj(path, false); });
+		double parallelSeconds = TimeBest(iterations, [&]() { parallel.ParseObj(path, true); });
+
+		const size_t corners = serial.indices.size();
+		bool identical = serial.vertices.size() == parallel.vertices.size() &&
+			serial.indices == parallel.indices &&
+			std::memcmp(serial.vertices.data(), parallel.vertices.data(),
+				serial.vertices.size() * sizeof(LveModel::Vertex)) == 0;
+
+		std::cout << "obj: " << path << "\n"
+			<< "face corners: " << corners << ", unique vertices: " << serial.vertices.size() << "\n"
+			<< "threads: " << LveThreadPool::Shared().GetThreadCount() + 1 << "\n"
+			<< "serial:   " << serialSeconds * 1000.0 << " ms, " << corners / serialSeconds / 1e6 << " M vertices/s\n"
+			<< "parallel: " << parallelSeconds * 1000.0 << " ms, " << corners / parallelSeconds / 1e6 << " M vertices/s\n"
+			<< "speedup: " << serialSeconds / parallelSeconds << "x\n"
+			<< "identical: " << (identical ? "yes" : "NO") << "\n";
+		return identical ? 0 : 2;
+	}
+	catch (const std::exception& e) {
+		std::cerr << "benchmark failed: " << e.what() << "\n";
+		return 1;
+	}
+}
+
+int LveBenchmark::RunCull(int iterations)
+{
+	/*与FirstApp相同的透视投影，相机位于场景中心看向+z，约6%的对象落在视锥内*/
+	LveCamera camera;
+	camera.SetPerspectiveProjection(glm::radians(50.f), 16.f / 9.f, 0.1f, 1000.f);
+	camera.SetViewDirection(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f));
+	const std::array<glm::vec4, 6> planes = camera.GetFrustumPlanes();
+
+	const LveFrustumCuller::Backend backends[] = {
+		LveFrustumCuller::Backend::Scalar,
+		LveFrustumCuller::Backend::SSE,
+		LveFrustumCuller::Backend::AVX,
+	};
+
+	bool identical = true;
+	for (size_t objectCount : { size_t(10000), size_t(100000) }) {
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> position(-500.f, 500.f);
+		std::uniform_real_distribution<float> radius(0.1f, 5.f);
+
+		LveFrustumCuller culler;
+		culler.Reserve(objectCount);
+		for (size_t i = 0; i < objectCount; i++) {
+			culler.Add(glm::vec4(position(rng), position(rng), position(rng), radius(rng)));
+		}
+
+		std::cout << "objects: " << objectCount << "\n";
+		std::vector<uint32_t> reference;
+		for (LveFrustumCuller::Backend backend : backends) {
+			if (!IsSimdLevelSupported(backend)) {
+				std::cout << "  " << GetSimdLevelName(backend) << ": not supported\n";
+				continue;
+			}
+			culler.SetBackend(backend);
+			double seconds = TimeBest(iterations, [&]() { culler.Cull(planes); });
+			const std::vector<uint32_t>& visible = culler.Cull(planes);
+			if (backend == LveFrustumCuller::Backend::Scalar) {
+				reference = visible;
+			}
+			bool same = visible == reference;
+			identical = identical && same;
+
+			std::cout << "  " << GetSimdLevelName(backend) << ": "
+				<< seconds * 1e6 << " us, " << objectCount / (seconds * 1e6) << " objects/us, "
+				<< visible.size() << " visible" << (same ? "" : " (MISMATCH)") << "\n";
+		}
+	}
+	std::cout << "identical: " << (identical ? "yes" : "NO") << "\n";
+	return identical ? 0 : 2;
+}
+
+/*两组矩阵逐元素的最大绝对误差*/
+static float MaxMatrixError(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b,
+	const std::vector<glm::mat3>& an, const std::vector<glm::mat3>& bn)
+{
+	float error = 0.f;
+	for (size_t i = 0; i < a.size(); i++) {
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				error = (std::max)(error, std::abs(a[i][c][r] - b[i][c][r]));
+			}
+		}
+		for (int c = 0; c < 3; c++) {
+			for (int r = 0; r < 3; r++) {
+				error = (std::max)(error, std::abs(an[i][c][r] - bn[i][c][r]));
+			}
+		}
+	}
+	return error;
+}
+
+int LveBenchmark::RunTransform(int iterations)
+{
+	const size_t objectCount = 100000;
+	std::mt19937 rng(5678);
+	std::uniform_real_distribution<float> translation(-100.f, 100.f);
+	std::uniform_real_distribution<float> rotation(-glm::pi<float>(), glm::pi<float>());
+	std::uniform_real_distribution<float> scale(0.5f, 3.f);
+
+	std::vector<float> input[9];
+	for (int k = 0; k < 9; k++) {
+		input[k].resize(objectCount);
+		for (float& value : input[k]) {
+			value = k < 3 ? translation(rng) : (k < 6 ? rotation(rng) : scale(rng));
+		}
+	}
+	LveTransformBatch::Input batchInput{
+		input[0].data(), input[1].data(), input[2].data(),
+		input[3].data(), input[4].data(), input[5].data(),
+		input[6].data(), input[7].data(), input[8].data(),
+	};
+
+	/*原有路径：每个对象独立的TransformComponent，新建的组件没有缓存，必定重算*/
+	std::vector<glm::mat4> referenceModels(objectCount);
+	std::vector<glm::mat3> referenceNormals(objectCount);
+	double perObjectSeconds = TimeBest(iterations, [&]() {
+		for (size_t i = 0; i < objectCount; i++) {
+			TransformComponent transform{};
+			transform.translation = { input[0][i], input[1][i], input[2][i] };
+			transform.rotation = { input[3][i], input[4][i], input[5][i] };
+			transform.scale = { input[6][i], input[7][i], input[8][i] };
+			transform.UpdateLocalMatrices();
+			transform.UpdateWorldMatrices(nullptr);
+			referenceModels[i] = transform.mat4();
+			referenceNormals[i] = transform.normalMatrix();
+		}
+	});
+
+	std::cout << "transforms: " << objectCount << "\n"
+		<< "  per-object: " << perObjectSeconds * 1000.0 << " ms, " << objectCount / perObjectSeconds / 1e6 << " M matrices/s\n";
+
+	const LveSimdLevel levels[] = { LveSimdLevel::Scalar, LveSimdLevel::SSE, LveSimdLevel::AVX };
+	std::vector<glm::mat4> models(objectCount);
+	std::vector<glm::mat3> normals(objectCount);
+	bool accurate = true;
+	for (LveSimdLevel level : levels) {
+		if (!IsSimdLevelSupported(level)) {
+			std::cout << "  batch " << GetSimdLevelName(level) << ": not supported\n";
+			continue;
+		}
+		double seconds = TimeBest(iterations, [&]() {
+			LveTransformBatch::Compute(batchInput, objectCount, models.data(), normals.data(), level);
+		});
+		float error = MaxMatrixError(models, referenceModels, normals, referenceNormals);
+		/*缩放最大为3、法线矩阵分量最大为2，多项式sin/cos的误差远小于该阈值*/
+		accurate = accurate && error < 1e-4f;
+		std::cout << "  batch " << GetSimdLevelName(level) << ": " << seconds * 1000.0 << " ms, "
+			<< objectCount / seconds / 1e6 << " M matrices/s, speedup " << perObjectSeconds / seconds
+			<< "x, max error " << error << "\n";
+	}
+	std::cout << "accurate: " << (accurate ? "yes" : "NO") << "\n";
+	return accurate ? 0 : 2;
+}
+
+}  // namespace lve
@@ -0,0 +1,26 @@
+﻿#pragma once
+
+#include <string>
+
+namespace lve {
+
+/* 命令行基准测试入口，不创建窗口和Vulkan设备
+ * 用法：APP --bench-obj <file.obj> [iterations]
+ *       APP --bench-cull [iterations]
+ *       APP --bench-transform [iterations]
+ */
+class LveBenchmark {
+public:
+	/*识别到基准参数时运行并返回进程退出码，否则返回-1交给正常启动流程*/
+	static int Run(int argc, char* argv[]);
+
+private:
+	/*单线程与多线程OBJ解析+去重，比较结果并输出每秒处理的面角数*/
+	static int RunObjLoad(const std::string& path, int iterations);
+	/*1万/10万个随机包围球的视锥剔除，比较标量/SSE/AVX结果并输出每微秒处理的对象数*/
+	static int RunCull(int iterations);
+	/*10万个随机变换：逐对象的TransformComponent路径与各SIMD级别的批量路径，输出每秒生成的矩阵数与最大误差*/
+	static int RunTransform(int iterations);
+};
+
+}  // namespace lve
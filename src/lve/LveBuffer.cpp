@@ -35,18 +35,20 @@ namespace lve {
         m_memoryPropertyFlags{ memoryPropertyFlags } {
         m_alignmentSize = GetAlignment(instanceSize, minOffsetAlignment);
         m_bufferSize = m_alignmentSize * instanceCount;
-        device.createBuffer(m_bufferSize, usageFlags, memoryPropertyFlags, m_buffer, m_memory);
+        device.createBuffer(m_bufferSize, usageFlags, memoryPropertyFlags, m_buffer, m_allocation);
     }
 
     LveBuffer::~LveBuffer() {
         Unmap();
-        vkDestroyBuffer(m_lveDevice.device(), m_buffer, nullptr);
-        vkFreeMemory(m_lveDevice.device(), m_memory, nullptr);
+        vmaDestroyBuffer(m_lveDevice.allocator(), m_buffer, m_allocation);
     }
 
     /**
      * Map a memory range of this buffer. If successful, m_mapped points to the specified buffer range.
      *
+     * @note The allocation may share a VkDeviceMemory block with other buffers, so the whole
+     * allocation is mapped through VMA and m_mapped is offset into it
+     *
      * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
      * buffer range.
      * @param offset (Optional) Byte offset from beginning
@@ -55,8 +57,13 @@ namespace lve {
      */
     VkResult LveBuffer::Map(VkDeviceSize size, VkDeviceSize offset) 
     {
-        assert(m_buffer && m_memory && "Called map on buffer before create");
-        return vkMapMemory(m_lveDevice.device(), m_memory, offset, size, 0, &m_mapped);
+        assert(m_buffer && m_allocation && "Called map on buffer before create");
+        void* data = nullptr;
+        VkResult result = vmaMapMemory(m_lveDevice.allocator(), m_allocation, &data);
+        if (result == VK_SUCCESS) {
+            m_mapped = static_cast<char*>(data) + offset;
+        }
+        return result;
     }
 
     /**
@@ -66,7 +73,7 @@ namespace lve {
      */
     void LveBuffer::Unmap() {
         if (m_mapped) {
-            vkUnmapMemory(m_lveDevice.device(), m_memory);
+            vmaUnmapMemory(m_lveDevice.allocator(), m_allocation);
             m_mapped = nullptr;
         }
     }
@@ -105,12 +112,7 @@ namespace lve {
      * @return VkResult of the flush call
      */
     VkResult LveBuffer::Flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = m_memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(m_lveDevice.device(), 1, &mappedRange);
+        return vmaFlushAllocation(m_lveDevice.allocator(), m_allocation, offset, size);
     }
 
     /**
@@ -125,12 +127,7 @@ namespace lve {
      * @return VkResult of the invalidate call
      */
     VkResult LveBuffer::Invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = m_memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(m_lveDevice.device(), 1, &mappedRange);
+        return vmaInvalidateAllocation(m_lveDevice.allocator(), m_allocation, offset, size);
     }
 
     /**
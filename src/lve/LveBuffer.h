@@ -46,7 +46,7 @@ namespace lve {
         LveDevice& m_lveDevice;
         void* m_mapped = nullptr;
         VkBuffer m_buffer = VK_NULL_HANDLE;
-        VkDeviceMemory m_memory = VK_NULL_HANDLE;
+        VmaAllocation m_allocation = VK_NULL_HANDLE;
 
         VkDeviceSize m_bufferSize;
         uint32_t m_instanceCount;
@@ -1,11 +1,36 @@
 ﻿#include "LveCamera.h"
 
 #include <cassert>
+#include <cmath>
 #include <limits>
 #include <iostream>
 
 namespace lve { 
 
+std::array<glm::vec4, 6> LveCamera::GetFrustumPlanes() const
+{
+	/*Gribb-Hartmann：从裁剪矩阵的行提取平面，深度范围为[0, 1]*/
+	glm::mat4 clip = m_projectionMatrix * m_viewMatrix;
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+	}
+
+	std::array<glm::vec4, 6> planes = {
+		rows[3] + rows[0],	// 左
+		rows[3] - rows[0],	// 右
+		rows[3] + rows[1],	// 下
+		rows[3] - rows[1],	// 上
+		rows[2],			// 近
+		rows[3] - rows[2],	// 远
+	};
+	for (auto& plane : planes) {
+		float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		plane = plane * (1.f / length);
+	}
+	return planes;
+}
+
 void LveCamera::SetOrthographicProjection(
 	float left, float right, float top, float bottom, float near, float far)
 {
@@ -16,6 +41,8 @@ void LveCamera::SetOrthographicProjection(
 	m_projectionMatrix[3][0] = -(right + left) / (right - left);
 	m_projectionMatrix[3][1] = -(bottom + top) / (bottom - top);
 	m_projectionMatrix[3][2] = -near / (far - near);
+	m_near = near;
+	m_far = far;
 }
 
 void LveCamera::SetPerspectiveProjection(float fovy, float aspect, float near, float far) 
@@ -28,6 +55,8 @@ void LveCamera::SetPerspectiveProjection(float fovy, float aspect, float near, f
 	m_projectionMatrix[2][2] = far / (far - near);
 	m_projectionMatrix[2][3] = 1.f;
 	m_projectionMatrix[3][2] = -(far * near) / (far - near);
+	m_near = near;
+	m_far = far;
 }
 
 /* 用相机位置和朝向构造视图矩阵
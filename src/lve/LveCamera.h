@@ -4,6 +4,8 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE	//深度缓冲区值范围从0到1，而不是-1到1（OpenGL）
 #include <glm.hpp>
 
+#include <array>
+
 namespace lve { 
 
 /*将相机姿态与投影参数封装成V和P矩阵*/
@@ -27,11 +29,20 @@ public:
 	const glm::mat4& GetView() const { return m_viewMatrix; }
 	const glm::mat4& GetInverseView() const { return m_inverseViewMatirx; }
 	const glm::vec3 GetPosition() const { return glm::vec3(m_inverseViewMatirx[3]); }
+	float GetNearClip() const { return m_near; }
+	float GetFarClip() const { return m_far; }
+
+	/* 世界空间中的六个视锥平面（左、右、下、上、近、远），xyz为指向视锥内部的单位法线
+	 * 点p在平面内侧当且仅当dot(xyz, p) + w >= 0
+	 */
+	std::array<glm::vec4, 6> GetFrustumPlanes() const;
 
 private:
 	glm::mat4 m_projectionMatrix{1.f};
 	glm::mat4 m_viewMatrix{1.f};	// 视图矩阵，存储相机变换
 	glm::mat4 m_inverseViewMatirx{1.f}; // 逆视图矩阵
+	float m_near = 0.1f;	// 最近一次设置投影时的近/远裁剪面
+	float m_far = 1000.f;
 };
 
 }
\ No newline at end of file
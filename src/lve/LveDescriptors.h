@@ -34,6 +34,7 @@ namespace lve {
         LveDescriptorSetLayout& operator=(const LveDescriptorSetLayout&) = delete;
 
         VkDescriptorSetLayout GetDescriptorSetLayout() const { return m_descriptorSetLayout; }
+        const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& GetBindings() const { return m_bindings; }
 
     private:
         LveDevice& m_lveDevice;
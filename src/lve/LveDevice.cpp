@@ -1,8 +1,18 @@
 ﻿#include "lveDevice.h"
 
+#include "LveLayoutCache.h"
+#include "LveStagingRing.h"
+
+#define VMA_IMPLEMENTATION
+#include <vma/vk_mem_alloc.h>
+
 // std headers
+#include <chrono>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <set>
 #include <unordered_set>
 
@@ -53,11 +63,20 @@ LveDevice::LveDevice(LveWindow &window) : window{window} {
   createSurface();          // 创建依赖GLFW的窗口
   pickPhysicalDevice();     // 选择物理设备（系统中能与Vulkan协同工作的设备（GPU））
   createLogicalDevice();    // 创建逻辑设备（描述了希望使用物理设备的哪些功能）
+  createAllocator();        // 创建设备级内存分配器（VMA），所有缓冲区与图像都从这里分配
   createCommandPool();      // 创建命令池
+  createPipelineCache();    // 从磁盘加载管线缓存，驱动可跳过已编译过的管线
+  stagingRing_ = std::make_unique<LveStagingRing>(*this);  // 上传用的staging环
+  layoutCache_ = std::make_unique<LveLayoutCache>(*this);
 }
 
 LveDevice::~LveDevice() {
+  stagingRing_.reset();
+  layoutCache_.reset();
+  savePipelineCache();
+  vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
   vkDestroyCommandPool(device_, commandPool, nullptr);
+  vmaDestroyAllocator(allocator_);
   vkDestroyDevice(device_, nullptr);
 
   if (enableValidationLayers) {
@@ -86,6 +105,11 @@ void LveDevice::createInstance() {
   createInfo.pApplicationInfo = &appInfo;
 
   auto extensions = getRequiredExtensions();
+  /*VK_EXT_memory_budget依赖该实例扩展，可选*/
+  if (isInstanceExtensionSupported(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    physicalDeviceProperties2Enabled_ = true;
+  }
   createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
   createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -135,17 +159,23 @@ void LveDevice::pickPhysicalDevice() {
 
 void LveDevice::createLogicalDevice() {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+  queueFamilies_ = indices;
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  std::set<uint32_t> uniqueQueueFamilies = {
+      indices.graphicsFamily, indices.presentFamily, indices.transferFamily};
 
-  float queuePriority = 1.0f;
+  float queuePriorities[] = {1.0f, 1.0f};
   for (uint32_t queueFamily : uniqueQueueFamilies) {
     VkDeviceQueueCreateInfo queueCreateInfo = {};
     queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     queueCreateInfo.queueFamilyIndex = queueFamily;
     queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    /*传输回退到图形队列族时，额外申请一个队列，避免与渲染提交共用同一个VkQueue*/
+    if (queueFamily == indices.transferFamily && indices.transferQueueIndex > 0) {
+      queueCreateInfo.queueCount = indices.transferQueueIndex + 1;
+    }
+    queueCreateInfo.pQueuePriorities = queuePriorities;
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
@@ -154,15 +184,87 @@ void LveDevice::createLogicalDevice() {
   deviceFeatures.fillModeNonSolid = VK_TRUE;
   deviceFeatures.wideLines = VK_TRUE;
 
+  /*GPU驱动绘制所需的可选特性，不支持时渲染系统回退到逐组录制*/
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+  deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+  /*可选扩展：独立分配（大资源/渲染目标单独占用VkDeviceMemory）与显存预算查询*/
+  std::vector<const char *> enabledExtensions = deviceExtensions;
+  if (isDeviceExtensionSupported(physicalDevice, VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME) &&
+      isDeviceExtensionSupported(physicalDevice, VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME)) {
+    enabledExtensions.push_back(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
+    enabledExtensions.push_back(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+    dedicatedAllocationEnabled_ = true;
+  }
+  if (physicalDeviceProperties2Enabled_ &&
+      isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+    enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    memoryBudgetEnabled_ = true;
+  }
+  /*GPU剔除后由计数缓冲决定实际绘制数量*/
+  bool drawIndirectCountEnabled = false;
+  if (isDeviceExtensionSupported(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+    enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    drawIndirectCountEnabled = true;
+  }
+
+  /* 动态渲染与扩展动态状态：1.0设备上还需要启用动态渲染依赖的扩展，特性通过pNext链查询与启用
+   * 任一不支持时渲染器回退到VkRenderPass，管线回退到烘焙的固定功能状态
+   */
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{};
+  extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  const char *dynamicRenderingExtensions[] = {
+      VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+      VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+      VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+      VK_KHR_MULTIVIEW_EXTENSION_NAME,
+      VK_KHR_MAINTENANCE2_EXTENSION_NAME};
+  bool dynamicRenderingEnabled = false;
+  bool extendedDynamicStateEnabled = false;
+  auto getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+      vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+  if (physicalDeviceProperties2Enabled_ && getPhysicalDeviceFeatures2 != nullptr) {
+    dynamicRenderingFeatures.pNext = &extendedDynamicStateFeatures;
+    VkPhysicalDeviceFeatures2KHR features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    features2.pNext = &dynamicRenderingFeatures;
+    getPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+    dynamicRenderingEnabled = dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+    for (const char *extension : dynamicRenderingExtensions) {
+      dynamicRenderingEnabled = dynamicRenderingEnabled && isDeviceExtensionSupported(physicalDevice, extension);
+    }
+    extendedDynamicStateEnabled = extendedDynamicStateFeatures.extendedDynamicState == VK_TRUE &&
+        isDeviceExtensionSupported(physicalDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+  }
+
+  /*只把启用的特性结构体留在pNext链上*/
+  void *featureChain = nullptr;
+  if (extendedDynamicStateEnabled) {
+    enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    extendedDynamicStateFeatures.pNext = featureChain;
+    featureChain = &extendedDynamicStateFeatures;
+  }
+  if (dynamicRenderingEnabled) {
+    enabledExtensions.insert(enabledExtensions.end(), std::begin(dynamicRenderingExtensions), std::end(dynamicRenderingExtensions));
+    dynamicRenderingFeatures.pNext = featureChain;
+    featureChain = &dynamicRenderingFeatures;
+  }
+  createInfo.pNext = featureChain;
+
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -176,9 +278,61 @@ void LveDevice::createLogicalDevice() {
   if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device_) != VK_SUCCESS) {
     throw std::runtime_error("failed to create logical device!");
   }
+  enabledFeatures_ = deviceFeatures;
+  if (drawIndirectCountEnabled) {
+    cmdDrawIndexedIndirectCount_ = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+        vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+  }
+  if (dynamicRenderingEnabled) {
+    cmdBeginRendering_ = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+        vkGetDeviceProcAddr(device_, "vkCmdBeginRenderingKHR"));
+    cmdEndRendering_ = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+        vkGetDeviceProcAddr(device_, "vkCmdEndRenderingKHR"));
+  }
+  if (extendedDynamicStateEnabled) {
+    extendedDynamicState_.setCullMode = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(
+        vkGetDeviceProcAddr(device_, "vkCmdSetCullModeEXT"));
+    extendedDynamicState_.setFrontFace = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(
+        vkGetDeviceProcAddr(device_, "vkCmdSetFrontFaceEXT"));
+    extendedDynamicState_.setPrimitiveTopology = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(
+        vkGetDeviceProcAddr(device_, "vkCmdSetPrimitiveTopologyEXT"));
+    extendedDynamicState_.setDepthTestEnable = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(
+        vkGetDeviceProcAddr(device_, "vkCmdSetDepthTestEnableEXT"));
+    extendedDynamicState_.setDepthWriteEnable = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(
+        vkGetDeviceProcAddr(device_, "vkCmdSetDepthWriteEnableEXT"));
+    extendedDynamicState_.setDepthCompareOp = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(
+        vkGetDeviceProcAddr(device_, "vkCmdSetDepthCompareOpEXT"));
+  }
+  std::cout << "dynamic rendering: " << (dynamicRenderingEnabled ? "on" : "off")
+            << ", extended dynamic state: " << (extendedDynamicStateEnabled ? "on" : "off") << std::endl;
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  vkGetDeviceQueue(device_, indices.transferFamily, indices.transferQueueIndex, &transferQueue_);
+}
+
+void LveDevice::createAllocator() {
+  VmaVulkanFunctions vulkanFunctions{};
+  vulkanFunctions.vkGetInstanceProcAddr = vkGetInstanceProcAddr;
+  vulkanFunctions.vkGetDeviceProcAddr = vkGetDeviceProcAddr;
+
+  VmaAllocatorCreateInfo allocatorInfo{};
+  allocatorInfo.physicalDevice = physicalDevice;
+  allocatorInfo.device = device_;
+  allocatorInfo.instance = instance;
+  allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_0;
+  allocatorInfo.preferredLargeHeapBlockSize = kPreferredBlockSize;
+  allocatorInfo.pVulkanFunctions = &vulkanFunctions;
+  if (dedicatedAllocationEnabled_) {
+    allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT;
+  }
+  if (memoryBudgetEnabled_) {
+    allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+  }
+
+  if (vmaCreateAllocator(&allocatorInfo, &allocator_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create memory allocator!");
+  }
 }
 
 void LveDevice::createCommandPool() {
@@ -195,6 +349,88 @@ void LveDevice::createCommandPool() {
   }
 }
 
+/* 缓存数据以VkPipelineCacheHeaderVersionOne开头
+ * 驱动、显卡或驱动版本（pipelineCacheUUID）变化后旧数据无用，直接丢弃
+ */
+bool LveDevice::isPipelineCacheCompatible(const std::vector<char> &data) {
+  VkPipelineCacheHeaderVersionOne header{};
+  if (data.size() < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  return header.headerSize >= sizeof(header) &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID &&
+         header.deviceID == properties.deviceID &&
+         memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void LveDevice::createPipelineCache() {
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::vector<char> data;
+  {
+    std::ifstream in(kPipelineCachePath, std::ios::binary | std::ios::ate);
+    if (in) {
+      data.resize(static_cast<size_t>(in.tellg()));
+      in.seekg(0);
+      if (!in.read(data.data(), data.size())) {
+        data.clear();
+      }
+    }
+  }
+  if (!data.empty() && !isPipelineCacheCompatible(data)) {
+    std::cout << "pipeline cache: ignoring " << kPipelineCachePath << " (device or driver changed)" << std::endl;
+    data.clear();
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+    /*数据通过了头部检查仍被拒绝时，退回空缓存*/
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = nullptr;
+    data.clear();
+    if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create pipeline cache!");
+    }
+  }
+  pipelineCacheWarm_ = !data.empty();
+
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+  std::cout << "pipeline cache: " << (pipelineCacheWarm_ ? "warm, " : "cold, ") << data.size() / 1024
+            << " KiB loaded in " << ms << " ms" << std::endl;
+}
+
+/*先写临时文件再重命名，写入失败只打印警告*/
+void LveDevice::savePipelineCache() {
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, nullptr) != VK_SUCCESS || size == 0) {
+    return;
+  }
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, data.data()) != VK_SUCCESS) {
+    return;
+  }
+
+  const std::string tempPath = std::string(kPipelineCachePath) + ".tmp";
+  {
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out || !out.write(data.data(), size)) {
+      std::cerr << "failed to write pipeline cache: " << kPipelineCachePath << "\n";
+      return;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tempPath, kPipelineCachePath, ec);
+  if (ec) {
+    std::filesystem::remove(tempPath, ec);
+    std::cerr << "failed to write pipeline cache: " << kPipelineCachePath << "\n";
+  }
+}
+
 void LveDevice::createSurface() { window.CreateWindowSurface(instance, &surface_); }
 
 bool LveDevice::isDeviceSuitable(VkPhysicalDevice device) {
@@ -321,6 +557,39 @@ bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool LveDevice::isDeviceExtensionSupported(VkPhysicalDevice device, const char *extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      device,
+      nullptr,
+      &extensionCount,
+      availableExtensions.data());
+
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LveDevice::isInstanceExtensionSupported(const char *extensionName) {
+  uint32_t extensionCount = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+  for (const auto &extension : extensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
 
@@ -332,23 +601,33 @@ QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
 
   int i = 0;
   for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+    if (!indices.graphicsFamilyHasValue && queueFamily.queueCount > 0 &&
+        queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
       indices.graphicsFamily = i;
       indices.graphicsFamilyHasValue = true;
     }
     VkBool32 presentSupport = false;
     vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-    if (queueFamily.queueCount > 0 && presentSupport) {
+    if (!indices.presentFamilyHasValue && queueFamily.queueCount > 0 && presentSupport) {
       indices.presentFamily = i;
       indices.presentFamilyHasValue = true;
     }
-    if (indices.isComplete()) {
-      break;
+    /*只有传输能力的队列族（DMA引擎），与渲染并行执行复制*/
+    if (!indices.dedicatedTransferFamily && queueFamily.queueCount > 0 &&
+        (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+        !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      indices.transferFamily = i;
+      indices.dedicatedTransferFamily = true;
     }
 
     i++;
   }
 
+  if (!indices.dedicatedTransferFamily && indices.graphicsFamilyHasValue) {
+    indices.transferFamily = indices.graphicsFamily;
+    indices.transferQueueIndex = queueFamilies[indices.graphicsFamily].queueCount > 1 ? 1 : 0;
+  }
+
   return indices;
 }
 
@@ -412,7 +691,7 @@ void LveDevice::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) 
+    VmaAllocation &bufferAllocation) 
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -420,23 +699,26 @@ void LveDevice::createBuffer(
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create vertex buffer!");
+    /*由专用传输队列写入、图形队列读取的缓冲区在两个队列族间共享，省去所有权转移屏障*/
+    uint32_t queueFamilyIndices[] = {queueFamilies_.graphicsFamily, queueFamilies_.transferFamily};
+    if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) &&
+        queueFamilies_.transferFamily != queueFamilies_.graphicsFamily) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
+    /*由VMA从对应内存类型的大块中子分配，不再每个缓冲区调用一次vkAllocateMemory*/
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_UNKNOWN;
+    allocInfo.requiredFlags = properties;
+    if (size >= kDedicatedAllocationThreshold) {
+        allocInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
     }
 
-    vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+    if (vmaCreateBuffer(allocator_, &bufferInfo, &allocInfo, &buffer, &bufferAllocation, nullptr) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
 }
 
 VkCommandBuffer LveDevice::beginSingleTimeCommands() {
@@ -465,9 +747,21 @@ void LveDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
 
-  vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue_);
+  /*只等待本次提交，而不是vkQueueWaitIdle排空整个图形队列*/
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence;
+  if (vkCreateFence(device_, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create single time command fence!");
+  }
+
+  {
+    auto queueLock = lockQueue(graphicsQueue_);
+    vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence);
+  }
+  vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
 
+  vkDestroyFence(device_, fence, nullptr);
   vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
@@ -483,6 +777,31 @@ void LveDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize
   endSingleTimeCommands(commandBuffer);
 }
 
+std::unique_lock<std::mutex> LveDevice::lockQueue(VkQueue queue) {
+  if (queue == transferQueue_ && transferQueue_ != graphicsQueue_) {
+    return std::unique_lock<std::mutex>(transferQueueMutex_);
+  }
+  return std::unique_lock<std::mutex>(graphicsQueueMutex_);
+}
+
+void LveDevice::waitIdle() {
+  std::scoped_lock lock(graphicsQueueMutex_, transferQueueMutex_);
+  vkDeviceWaitIdle(device_);
+}
+
+UploadTicket LveDevice::uploadToBuffer(
+    const void *data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset) {
+  return stagingRing_->Upload(data, size, dstBuffer, dstOffset);
+}
+
+void LveDevice::flushUploads() { stagingRing_->Flush(); }
+
+void LveDevice::waitForUploads() { stagingRing_->WaitIdle(); }
+
+bool LveDevice::isUploadComplete(UploadTicket ticket) { return stagingRing_->IsComplete(ticket); }
+
+void LveDevice::waitForUpload(UploadTicket ticket) { stagingRing_->Wait(ticket); }
+
 void LveDevice::copyBufferToImage(
     VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
   VkCommandBuffer commandBuffer = beginSingleTimeCommands();
@@ -514,26 +833,46 @@ void LveDevice::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory) {
-  if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create image!");
+    VmaAllocation &imageAllocation) {
+  VmaAllocationCreateInfo allocInfo{};
+  allocInfo.usage = VMA_MEMORY_USAGE_UNKNOWN;
+  allocInfo.requiredFlags = properties;
+  /*渲染目标随交换链重建频繁创建销毁，单独分配避免在公共块中产生碎片*/
+  if (imageInfo.usage &
+      (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
+    allocInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+  }
+  /*瞬态附件优先使用延迟分配的内存，分块渲染的GPU上不占用实际显存；没有该类型时退回普通显存*/
+  if (imageInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+    allocInfo.preferredFlags |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
   }
 
-  VkMemoryRequirements memRequirements;
-  vkGetImageMemoryRequirements(device_, image, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
+  if (vmaCreateImage(allocator_, &imageInfo, &allocInfo, &image, &imageAllocation, nullptr) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create image!");
   }
+}
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-    throw std::runtime_error("failed to bind image memory!");
+std::vector<MemoryHeapUsage> LveDevice::queryMemoryHeapUsage() {
+  const VkPhysicalDeviceMemoryProperties *memProperties = nullptr;
+  vmaGetMemoryProperties(allocator_, &memProperties);
+
+  std::vector<VmaBudget> budgets(memProperties->memoryHeapCount);
+  vmaGetHeapBudgets(allocator_, budgets.data());
+
+  std::vector<MemoryHeapUsage> heaps(memProperties->memoryHeapCount);
+  for (uint32_t i = 0; i < memProperties->memoryHeapCount; i++) {
+    heaps[i].heapIndex = i;
+    heaps[i].flags = memProperties->memoryHeaps[i].flags;
+    heaps[i].heapSize = memProperties->memoryHeaps[i].size;
+    heaps[i].blockCount = budgets[i].statistics.blockCount;
+    heaps[i].allocationCount = budgets[i].statistics.allocationCount;
+    heaps[i].blockBytes = budgets[i].statistics.blockBytes;
+    heaps[i].allocationBytes = budgets[i].statistics.allocationBytes;
+    heaps[i].usage = budgets[i].usage;
+    heaps[i].budget = budgets[i].budget;
   }
+  return heaps;
 }
 
 }  // namespace lve
\ No newline at end of file
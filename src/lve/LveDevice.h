@@ -2,12 +2,20 @@
 
 #include "lveWindow.h"
 
+// vma
+#include <vma/vk_mem_alloc.h>
+
 // std lib headers
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace lve {
 
+class LveStagingRing;
+class LveLayoutCache;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -17,11 +25,40 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  uint32_t transferFamily;          // 专用传输队列族；没有时与graphicsFamily相同
+  uint32_t transferQueueIndex = 0;  // 回退到图形队列族时，若该族有多个队列则使用第1号队列
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool dedicatedTransferFamily = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
+// VK_EXT_extended_dynamic_state的命令，设备不支持时全部为空
+struct ExtendedDynamicStateCommands {
+  PFN_vkCmdSetCullModeEXT setCullMode = nullptr;
+  PFN_vkCmdSetFrontFaceEXT setFrontFace = nullptr;
+  PFN_vkCmdSetPrimitiveTopologyEXT setPrimitiveTopology = nullptr;
+  PFN_vkCmdSetDepthTestEnableEXT setDepthTestEnable = nullptr;
+  PFN_vkCmdSetDepthWriteEnableEXT setDepthWriteEnable = nullptr;
+  PFN_vkCmdSetDepthCompareOpEXT setDepthCompareOp = nullptr;
+};
+
+// 上传票据：由uploadToBuffer返回，单调递增，渲染器用它查询/等待数据是否已到达GPU
+using UploadTicket = uint64_t;
+
+/*单个内存堆的使用情况，来自VMA统计*/
+struct MemoryHeapUsage {
+  uint32_t heapIndex;
+  VkMemoryHeapFlags flags;
+  VkDeviceSize heapSize;
+  uint32_t blockCount;          // 该堆上的VkDeviceMemory块数量（即vkAllocateMemory次数）
+  uint32_t allocationCount;     // 从块中子分配出的资源数量
+  VkDeviceSize blockBytes;      // 所有块占用的字节数
+  VkDeviceSize allocationBytes; // 实际被资源使用的字节数
+  VkDeviceSize usage;           // 驱动报告的当前进程用量（无VK_EXT_memory_budget时为估计值）
+  VkDeviceSize budget;          // 驱动报告的可用预算
+};
+
 /* 整个Vulkan工程的硬件抽象层，负责管理Vulkan的设备与命令资源
  * 封装了所有与GPU、实例、队列、命令池相关的底层操作
  */
@@ -42,11 +79,42 @@ public:
   LveDevice(LveDevice &&) = delete;
   LveDevice &operator=(LveDevice &&) = delete;
 
+  // 管线缓存文件，位于工作目录，退出时写回
+  static constexpr const char *kPipelineCachePath = "pipeline_cache.bin";
+
+  // 单块VkDeviceMemory的大小，资源从块中子分配
+  static constexpr VkDeviceSize kPreferredBlockSize = 64ull * 1024 * 1024;
+  // 超过该大小的资源使用独立的VkDeviceMemory，不占用公共块
+  static constexpr VkDeviceSize kDedicatedAllocationThreshold = 16ull * 1024 * 1024;
+
   VkCommandPool getCommandPool() { return commandPool; }
   VkDevice device() { return device_; }
+  VmaAllocator allocator() { return allocator_; }
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  VkQueue transferQueue() { return transferQueue_; }
+  // 所有vkCreate*Pipelines共用的管线缓存
+  VkPipelineCache pipelineCache() { return pipelineCache_; }
+  // 启动时是否从磁盘加载到了可用的缓存数据（热启动）
+  bool isPipelineCacheWarm() const { return pipelineCacheWarm_; }
+  // 由着色器反射生成、在各系统之间共享的描述符集布局与管线布局
+  LveLayoutCache &layoutCache() { return *layoutCache_; }
+  const VkPhysicalDeviceFeatures &enabledFeatures() const { return enabledFeatures_; }
+  // VK_KHR_draw_indirect_count，不支持时为空
+  PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount() const { return cmdDrawIndexedIndirectCount_; }
+  // VK_KHR_dynamic_rendering：不需要VkRenderPass/VkFramebuffer，不支持时为空
+  bool dynamicRenderingEnabled() const { return cmdBeginRendering_ != nullptr; }
+  PFN_vkCmdBeginRenderingKHR cmdBeginRendering() const { return cmdBeginRendering_; }
+  PFN_vkCmdEndRenderingKHR cmdEndRendering() const { return cmdEndRendering_; }
+  // 剔除、朝向、拓扑与深度状态在录制时设置，而不是烘焙进管线
+  bool extendedDynamicStateEnabled() const { return extendedDynamicState_.setCullMode != nullptr; }
+  const ExtendedDynamicStateCommands &extendedDynamicState() const { return extendedDynamicState_; }
+
+  // 队列提交需外部同步：资源加载线程与渲染线程可能同时提交，提交/呈现前先取得对应队列的锁
+  std::unique_lock<std::mutex> lockQueue(VkQueue queue);
+  // 持有所有队列锁后vkDeviceWaitIdle
+  void waitIdle();
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -60,10 +128,17 @@ public:
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      VmaAllocation &bufferAllocation);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+
+  // 经由持久映射的staging环在传输队列上异步上传，复制命令批量录制，不等待GPU
+  UploadTicket uploadToBuffer(const void *data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+  void flushUploads();      // 提交已录制的上传批次（fence同步，非阻塞）
+  void waitForUploads();    // 阻塞直到所有上传完成
+  bool isUploadComplete(UploadTicket ticket);  // 非阻塞查询
+  void waitForUpload(UploadTicket ticket);     // 阻塞直到该票据所在批次完成
   void copyBufferToImage(
       VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
@@ -71,7 +146,10 @@ public:
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      VmaAllocation &imageAllocation);
+
+  // 查询每个内存堆的块数量、子分配数量与预算
+  std::vector<MemoryHeapUsage> queryMemoryHeapUsage();
 
   VkPhysicalDeviceProperties properties;
 
@@ -81,7 +159,10 @@ public:
   void createSurface();
   void pickPhysicalDevice();
   void createLogicalDevice();
+  void createAllocator();
   void createCommandPool();
+  void createPipelineCache();
+  void savePipelineCache();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
@@ -91,6 +172,9 @@ public:
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isDeviceExtensionSupported(VkPhysicalDevice device, const char *extensionName);
+  bool isInstanceExtensionSupported(const char *extensionName);
+  bool isPipelineCacheCompatible(const std::vector<char> &data);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
@@ -103,6 +187,25 @@ public:
   VkSurfaceKHR surface_;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
+  QueueFamilyIndices queueFamilies_;
+  VkPhysicalDeviceFeatures enabledFeatures_{};
+  PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount_ = nullptr;
+  PFN_vkCmdBeginRenderingKHR cmdBeginRendering_ = nullptr;
+  PFN_vkCmdEndRenderingKHR cmdEndRendering_ = nullptr;
+  ExtendedDynamicStateCommands extendedDynamicState_{};
+  std::mutex graphicsQueueMutex_;   // 图形/呈现队列，传输回退到图形队列族同一队列时也用它
+  std::mutex transferQueueMutex_;
+  VmaAllocator allocator_ = VK_NULL_HANDLE;
+  VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+  bool pipelineCacheWarm_ = false;
+  std::unique_ptr<LveStagingRing> stagingRing_;
+  std::unique_ptr<LveLayoutCache> layoutCache_;
+
+  // 可选扩展：支持时启用，让VMA使用独立分配提示与显存预算查询
+  bool dedicatedAllocationEnabled_ = false;
+  bool memoryBudgetEnabled_ = false;
+  bool physicalDeviceProperties2Enabled_ = false;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -1,16 +1,38 @@
 ﻿#pragma once
 
 #include "LveCamera.h"
-#include "LveObject.h"
+#include "LvePipeline.h"
+#include "LveScene.h"
 
 #include <vulkan/vulkan.h>
 
+#include <vector>
+
 namespace lve {
 
-#define MAX_LIGHTS 10
+/*shader.frag与deferred_lighting.frag中光照相关特化常量的constant_id*/
+enum LightingConstant : uint32_t {
+	LIGHTING_CLUSTERED = 0,			// bool：false时不读取分簇缓冲区，遍历所有点光源
+	LIGHTING_FIXED_LIGHT_COUNT = 1,	// int：>0时点光源数量固定为该值，循环次数为常量可完全展开
+	LIGHTING_SHADING_MODEL = 2,		// int：ShadingModel
+};
+
+enum ShadingModel : int32_t {
+	SHADING_BLINN_PHONG = 0,
+	SHADING_LAMBERT = 1,	// 只计算漫反射，镜面反射分支在特化时消除
+};
+
+/* 光照管线的特化常量组合，由FirstApp按启动选项生成
+ * base编译为基础管线，variants与它一起在启动时并行编译，每帧选择的组合都在其中
+ */
+struct LightingSpecializations {
+	LveSpecialization base;
+	std::vector<LveSpecialization> variants;
+};
 
+/*与shader.frag中存储缓冲区的PointLight一致（std430）*/
 struct PointLight {
-	glm::vec4 position{};	// ignore w
+	glm::vec4 position{};	// w：影响半径
 	glm::vec4 color{};
 };
 
@@ -19,9 +41,13 @@ struct GlobalUbo {
 	glm::mat4 view{ 1.f };
 	glm::mat4 inverseView{ 1.f };	// 通过视图逆矩阵最后一列获取相机位置
 
-	/*点光源*/
+	/*点光源：数据在每帧的存储缓冲区（set 0, binding 1），UBO只保存数量*/
 	glm::vec4 ambientLightColor{ 1.f, 1.f, 1.f, .02f }; // w is intensity
-	PointLight pointLights[MAX_LIGHTS];
+	/* 分簇光照参数，由LightClusterSystem填写
+	 * 视图空间按屏幕tile和指数深度切片划分，slice = log(viewZ) * scale + bias
+	 */
+	glm::uvec4 clusterGrid{ 0 };	// xyz：网格尺寸，w：每簇最多光源数（0表示不分簇，逐片段遍历所有点光源）
+	glm::vec4 clusterParams{ 0.f };	// x：scale，y：bias，zw：1 / 屏幕尺寸
 	int numLights;
 };
 
@@ -31,7 +57,11 @@ struct FrameInfo {
 	VkCommandBuffer commandBuffer;
 	LveCamera& camera;
 	VkDescriptorSet globalDescriptorSet;
-	LveObject::Map& objects;
+	LveScene& scene;
+	/*图形绑定点上最近一次绑定globalDescriptorSet时的管线布局，布局在set 0上兼容的系统不再重复绑定*/
+	VkPipelineLayout boundGlobalLayout = VK_NULL_HANDLE;
+	/*本帧光照管线使用的特化常量（LightingConstant），为空时使用基础管线*/
+	const LveSpecialization* lightingVariant = nullptr;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,173 @@
+﻿#include "LveFrustumCuller.h"
+
+namespace lve {
+
+LveFrustumCuller::LveFrustumCuller()
+	: m_backend{ DetectSimdLevel() }
+{
+}
+
+void LveFrustumCuller::SetBackend(Backend backend)
+{
+	m_backend = IsSimdLevelSupported(backend) ? backend : DetectSimdLevel();
+}
+
+void LveFrustumCuller::Clear()
+{
+	m_centerX.clear();
+	m_centerY.clear();
+	m_centerZ.clear();
+	m_radius.clear();
+}
+
+void LveFrustumCuller::Reserve(size_t count)
+{
+	m_centerX.reserve(count);
+	m_centerY.reserve(count);
+	m_centerZ.reserve(count);
+	m_radius.reserve(count);
+	m_visible.reserve(count);
+}
+
+uint32_t LveFrustumCuller::Add(const glm::vec4& sphere)
+{
+	m_centerX.push_back(sphere.x);
+	m_centerY.push_back(sphere.y);
+	m_centerZ.push_back(sphere.z);
+	m_radius.push_back(sphere.w);
+	return static_cast<uint32_t>(m_radius.size() - 1);
+}
+
+const std::vector<uint32_t>& LveFrustumCuller::Cull(const std::array<glm::vec4, 6>& planes)
+{
+	m_visible.clear();
+	switch (m_backend) {
+	case Backend::AVX:
+		CullAVX(planes);
+		break;
+	case Backend::SSE:
+		CullSSE(planes);
+		break;
+	default:
+		CullScalar(planes, 0);
+		break;
+	}
+	return m_visible;
+}
+
+/*球心到任一平面的有符号距离小于-r时整个球在视锥外*/
+void LveFrustumCuller::CullScalar(const std::array<glm::vec4, 6>& planes, size_t begin)
+{
+	const size_t count = m_radius.size();
+	for (size_t i = begin; i < count; i++) {
+		bool visible = true;
+		for (const glm::vec4& plane : planes) {
+			/*与SIMD路径保持相同的求和顺序，保证边界上的结果一致*/
+			float distance = (plane.x * m_centerX[i] + plane.y * m_centerY[i]) + (plane.z * m_centerZ[i] + plane.w);
+			if (distance < -m_radius[i]) {
+				visible = false;
+				break;
+			}
+		}
+		if (visible) {
+			m_visible.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+#if defined(LVE_SIMD_X86)
+
+/*逐平面累积"在外侧"掩码，6个平面都测完后一次性写出可见下标；尾部不足一组的走标量*/
+void LveFrustumCuller::CullSSE(const std::array<glm::vec4, 6>& planes)
+{
+	const size_t count = m_radius.size();
+	const size_t simdCount = count & ~size_t(3);
+
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm_set1_ps(planes[p].x);
+		planeY[p] = _mm_set1_ps(planes[p].y);
+		planeZ[p] = _mm_set1_ps(planes[p].z);
+		planeW[p] = _mm_set1_ps(planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (size_t i = 0; i < simdCount; i += 4) {
+		__m128 x = _mm_loadu_ps(&m_centerX[i]);
+		__m128 y = _mm_loadu_ps(&m_centerY[i]);
+		__m128 z = _mm_loadu_ps(&m_centerZ[i]);
+		__m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(&m_radius[i]));
+
+		__m128 outside = zero;
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negRadius));
+		}
+
+		int visibleMask = ~_mm_movemask_ps(outside) & 0xF;
+		while (visibleMask != 0) {
+			int lane = 0;
+			while ((visibleMask & (1 << lane)) == 0) lane++;
+			m_visible.push_back(static_cast<uint32_t>(i + lane));
+			visibleMask &= visibleMask - 1;
+		}
+	}
+	CullScalar(planes, simdCount);
+}
+
+LVE_TARGET_AVX void LveFrustumCuller::CullAVX(const std::array<glm::vec4, 6>& planes)
+{
+	const size_t count = m_radius.size();
+	const size_t simdCount = count & ~size_t(7);
+
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm256_set1_ps(planes[p].x);
+		planeY[p] = _mm256_set1_ps(planes[p].y);
+		planeZ[p] = _mm256_set1_ps(planes[p].z);
+		planeW[p] = _mm256_set1_ps(planes[p].w);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (size_t i = 0; i < simdCount; i += 8) {
+		__m256 x = _mm256_loadu_ps(&m_centerX[i]);
+		__m256 y = _mm256_loadu_ps(&m_centerY[i]);
+		__m256 z = _mm256_loadu_ps(&m_centerZ[i]);
+		__m256 negRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(&m_radius[i]));
+
+		__m256 outside = zero;
+		for (int p = 0; p < 6; p++) {
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+				_mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negRadius, _CMP_LT_OQ));
+		}
+
+		int visibleMask = ~_mm256_movemask_ps(outside) & 0xFF;
+		while (visibleMask != 0) {
+			int lane = 0;
+			while ((visibleMask & (1 << lane)) == 0) lane++;
+			m_visible.push_back(static_cast<uint32_t>(i + lane));
+			visibleMask &= visibleMask - 1;
+		}
+	}
+	CullScalar(planes, simdCount);
+}
+
+#else
+
+void LveFrustumCuller::CullSSE(const std::array<glm::vec4, 6>& planes)
+{
+	CullScalar(planes, 0);
+}
+
+void LveFrustumCuller::CullAVX(const std::array<glm::vec4, 6>& planes)
+{
+	CullScalar(planes, 0);
+}
+
+#endif
+
+}  // namespace lve
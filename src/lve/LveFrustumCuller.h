@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include "LveSimd.h"
+
+#include <glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+/* CPU端批量视锥剔除
+ * 世界空间包围球按SoA（x/y/z/r各一个数组）存放，一次对4个（SSE）或8个（AVX）球做6个平面的测试
+ * 指令集在运行时检测，不支持时退回标量实现，三条路径输出完全一致
+ */
+class LveFrustumCuller {
+public:
+	using Backend = LveSimdLevel;
+
+	/*默认使用当前CPU支持的最快实现*/
+	LveFrustumCuller();
+
+	/*基准测试用，不支持的实现会退回DetectSimdLevel的结果*/
+	void SetBackend(Backend backend);
+	Backend GetBackend() const { return m_backend; }
+
+	void Clear();
+	void Reserve(size_t count);
+	/*sphere的xyz为世界空间球心，w为半径；返回该球的下标*/
+	uint32_t Add(const glm::vec4& sphere);
+	size_t GetCount() const { return m_radius.size(); }
+
+	/* planes为LveCamera::GetFrustumPlanes()的结果（法线指向视锥内部且已归一化）
+	 * 返回可见球的下标，按升序排列；返回的引用在下一次Cull之前有效
+	 */
+	const std::vector<uint32_t>& Cull(const std::array<glm::vec4, 6>& planes);
+
+private:
+	void CullScalar(const std::array<glm::vec4, 6>& planes, size_t begin);
+	void CullSSE(const std::array<glm::vec4, 6>& planes);
+	void CullAVX(const std::array<glm::vec4, 6>& planes);
+
+	Backend m_backend;
+
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_radius;
+
+	std::vector<uint32_t> m_visible;
+};
+
+}  // namespace lve
@@ -0,0 +1,323 @@
+﻿#include "LveLayoutCache.h"
+
+#include "LveShaderCompiler.h"
+
+#include <spirv_cross/spirv_cross_c.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve {
+
+template <typename T>
+static void AppendKey(std::string& key, const T& value)
+{
+	key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static bool StageFromExecutionModel(SpvExecutionModel model, VkShaderStageFlagBits& stage)
+{
+	switch (model) {
+	case SpvExecutionModelVertex: stage = VK_SHADER_STAGE_VERTEX_BIT; return true;
+	case SpvExecutionModelFragment: stage = VK_SHADER_STAGE_FRAGMENT_BIT; return true;
+	case SpvExecutionModelGLCompute: stage = VK_SHADER_STAGE_COMPUTE_BIT; return true;
+	default: return false;
+	}
+}
+
+LveLayoutCache::LveLayoutCache(LveDevice& device)
+	: m_lveDevice{ device }
+{
+}
+
+LveLayoutCache::~LveLayoutCache()
+{
+	for (auto& [key, layout] : m_pipelineLayouts) {
+		vkDestroyPipelineLayout(m_lveDevice.device(), layout->pipelineLayout, nullptr);
+	}
+}
+
+/*把一个着色器的描述符与push常量合并进layout，同一绑定在多个阶段出现时合并阶段标志*/
+void LveLayoutCache::Reflect(const std::string& path, const std::vector<std::string>& defines, ShaderLayout& layout)
+{
+	std::vector<char> code = LveShaderCompiler::Shared().Load(path, defines);
+
+	spvc_context context = nullptr;
+	if (spvc_context_create(&context) != SPVC_SUCCESS) {
+		throw std::runtime_error("failed to create spirv-cross context!");
+	}
+	/*出错时销毁context（连带其中的所有对象）再抛出*/
+	auto fail = [&context, &path]() {
+		std::string message = std::string("failed to reflect shader ") + path + ": " + spvc_context_get_last_error_string(context);
+		spvc_context_destroy(context);
+		throw std::runtime_error(message);
+	};
+
+	spvc_parsed_ir ir = nullptr;
+	spvc_compiler compiler = nullptr;
+	spvc_resources resources = nullptr;
+	if (spvc_context_parse_spirv(context, reinterpret_cast<const SpvId*>(code.data()), code.size() / sizeof(SpvId), &ir) != SPVC_SUCCESS ||
+		spvc_context_create_compiler(context, SPVC_BACKEND_NONE, ir, SPVC_CAPTURE_MODE_TAKE_OWNERSHIP, &compiler) != SPVC_SUCCESS ||
+		spvc_compiler_create_shader_resources(compiler, &resources) != SPVC_SUCCESS) {
+		fail();
+	}
+
+	VkShaderStageFlagBits stage;
+	if (!StageFromExecutionModel(spvc_compiler_get_execution_model(compiler), stage)) {
+		spvc_context_destroy(context);
+		throw std::runtime_error("unsupported shader stage for reflection: " + path);
+	}
+
+	static const std::pair<spvc_resource_type, VkDescriptorType> descriptorTypes[] = {
+		{ SPVC_RESOURCE_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER },
+		{ SPVC_RESOURCE_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		{ SPVC_RESOURCE_TYPE_SUBPASS_INPUT, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT },
+		{ SPVC_RESOURCE_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER },
+		{ SPVC_RESOURCE_TYPE_SEPARATE_IMAGE, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE },
+		{ SPVC_RESOURCE_TYPE_SEPARATE_SAMPLERS, VK_DESCRIPTOR_TYPE_SAMPLER },
+		{ SPVC_RESOURCE_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE },
+	};
+	for (const auto& [resourceType, descriptorType] : descriptorTypes) {
+		const spvc_reflected_resource* list = nullptr;
+		size_t count = 0;
+		if (spvc_resources_get_resource_list_for_type(resources, resourceType, &list, &count) != SPVC_SUCCESS) {
+			fail();
+		}
+		for (size_t i = 0; i < count; i++) {
+			uint32_t set = spvc_compiler_get_decoration(compiler, list[i].id, SpvDecorationDescriptorSet);
+			uint32_t binding = spvc_compiler_get_decoration(compiler, list[i].id, SpvDecorationBinding);
+
+			/*数组绑定的描述符数量为各维长度之积*/
+			uint32_t descriptorCount = 1;
+			spvc_type type = spvc_compiler_get_type_handle(compiler, list[i].type_id);
+			for (unsigned d = 0; d < spvc_type_get_num_array_dimensions(type); d++) {
+				descriptorCount *= (std::max)(spvc_type_get_array_dimension(type, d), 1u);
+			}
+
+			if (layout.sets.size() <= set) {
+				layout.sets.resize(set + 1);
+			}
+			auto& bindings = layout.sets[set];
+			auto it = std::find_if(bindings.begin(), bindings.end(),
+				[binding](const VkDescriptorSetLayoutBinding& b) { return b.binding == binding; });
+			if (it == bindings.end()) {
+				VkDescriptorSetLayoutBinding layoutBinding{};
+				layoutBinding.binding = binding;
+				layoutBinding.descriptorType = descriptorType;
+				layoutBinding.descriptorCount = descriptorCount;
+				layoutBinding.stageFlags = stage;
+				bindings.push_back(layoutBinding);
+			}
+			else if (it->descriptorType != descriptorType) {
+				spvc_context_destroy(context);
+				throw std::runtime_error("descriptor type mismatch between stages at set " + std::to_string(set) +
+					", binding " + std::to_string(binding) + " in " + path);
+			}
+			else {
+				it->stageFlags |= stage;
+				it->descriptorCount = (std::max)(it->descriptorCount, descriptorCount);
+			}
+		}
+	}
+
+	/*push常量块：所有阶段共用一个从0开始的范围，大小取最大值*/
+	const spvc_reflected_resource* pushConstants = nullptr;
+	size_t pushConstantCount = 0;
+	if (spvc_resources_get_resource_list_for_type(resources, SPVC_RESOURCE_TYPE_PUSH_CONSTANT, &pushConstants, &pushConstantCount) != SPVC_SUCCESS) {
+		fail();
+	}
+	if (pushConstantCount > 0) {
+		size_t size = 0;
+		spvc_type type = spvc_compiler_get_type_handle(compiler, pushConstants[0].base_type_id);
+		if (spvc_compiler_get_declared_struct_size(compiler, type, &size) != SPVC_SUCCESS) {
+			fail();
+		}
+		if (layout.pushConstantRanges.empty()) {
+			layout.pushConstantRanges.push_back({ 0, 0, 0 });
+		}
+		VkPushConstantRange& range = layout.pushConstantRanges[0];
+		range.stageFlags |= stage;
+		range.size = (std::max)(range.size, static_cast<uint32_t>(size));
+	}
+
+	spvc_context_destroy(context);
+}
+
+LveDescriptorSetLayout* LveLayoutCache::GetSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings)
+{
+	std::sort(bindings.begin(), bindings.end(),
+		[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+	std::string key;
+	for (const auto& binding : bindings) {
+		AppendKey(key, binding.binding);
+		AppendKey(key, binding.descriptorType);
+		AppendKey(key, binding.descriptorCount);
+		AppendKey(key, binding.stageFlags);
+	}
+
+	auto it = m_setLayouts.find(key);
+	if (it != m_setLayouts.end()) {
+		return it->second.get();
+	}
+
+	std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindingMap;
+	for (const auto& binding : bindings) {
+		bindingMap[binding.binding] = binding;
+	}
+	auto setLayout = std::make_unique<LveDescriptorSetLayout>(m_lveDevice, bindingMap);
+	LveDescriptorSetLayout* result = setLayout.get();
+	m_setLayouts.emplace(std::move(key), std::move(setLayout));
+	return result;
+}
+
+const LveLayoutCache::PipelineLayout& LveLayoutCache::GetPipelineLayout(const std::vector<std::string>& shaderPaths,
+	const std::unordered_map<uint32_t, LveDescriptorSetLayout*>& sharedSets, const std::vector<std::string>& defines)
+{
+	ShaderLayout reflected;
+	for (const std::string& path : shaderPaths) {
+		Reflect(path, defines, reflected);
+	}
+	for (const auto& [set, setLayout] : sharedSets) {
+		if (reflected.sets.size() <= set) {
+			reflected.sets.resize(set + 1);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<LveDescriptorSetLayout*> setLayouts(reflected.sets.size());
+	for (uint32_t set = 0; set < reflected.sets.size(); set++) {
+		auto shared = sharedSets.find(set);
+		if (shared == sharedSets.end()) {
+			setLayouts[set] = GetSetLayout(reflected.sets[set]);
+			continue;
+		}
+
+		/*共享的set由C++端手写，着色器里的声明必须是它的子集*/
+		const auto& declared = shared->second->GetBindings();
+		for (const auto& binding : reflected.sets[set]) {
+			auto it = declared.find(binding.binding);
+			if (it == declared.end() ||
+				it->second.descriptorType != binding.descriptorType ||
+				it->second.descriptorCount < binding.descriptorCount ||
+				(binding.stageFlags & ~it->second.stageFlags) != 0) {
+				throw std::runtime_error("shader binding set " + std::to_string(set) + ", binding " +
+					std::to_string(binding.binding) + " does not match the shared descriptor set layout");
+			}
+		}
+		setLayouts[set] = shared->second;
+	}
+
+	std::string key;
+	for (LveDescriptorSetLayout* setLayout : setLayouts) {
+		AppendKey(key, setLayout->GetDescriptorSetLayout());
+	}
+	for (const auto& range : reflected.pushConstantRanges) {
+		AppendKey(key, range.stageFlags);
+		AppendKey(key, range.offset);
+		AppendKey(key, range.size);
+	}
+
+	auto it = m_pipelineLayouts.find(key);
+	if (it != m_pipelineLayouts.end()) {
+		return *it->second;
+	}
+
+	std::vector<VkDescriptorSetLayout> handles;
+	for (LveDescriptorSetLayout* setLayout : setLayouts) {
+		handles.push_back(setLayout->GetDescriptorSetLayout());
+	}
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(handles.size());
+	pipelineLayoutInfo.pSetLayouts = handles.data();
+	pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(reflected.pushConstantRanges.size());
+	pipelineLayoutInfo.pPushConstantRanges = reflected.pushConstantRanges.data();
+
+	auto layout = std::make_unique<PipelineLayout>();
+	if (vkCreatePipelineLayout(m_lveDevice.device(), &pipelineLayoutInfo, nullptr, &layout->pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+	layout->setLayouts = std::move(setLayouts);
+	layout->pushConstantRanges = std::move(reflected.pushConstantRanges);
+
+	const PipelineLayout& result = *layout;
+	m_byHandle[layout->pipelineLayout] = layout.get();
+	m_pipelineLayouts.emplace(std::move(key), std::move(layout));
+	return result;
+}
+
+void LveLayoutCache::Validate(VkPipelineLayout pipelineLayout, const std::vector<std::string>& shaderPaths,
+	const std::vector<std::string>& defines) const
+{
+	ShaderLayout reflected;
+	for (const std::string& path : shaderPaths) {
+		Reflect(path, defines, reflected);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_byHandle.find(pipelineLayout);
+	if (it == m_byHandle.end()) {
+		throw std::runtime_error("pipeline layout was not created by the layout cache");
+	}
+	const PipelineLayout& layout = *it->second;
+
+	for (uint32_t set = 0; set < reflected.sets.size(); set++) {
+		if (reflected.sets[set].empty()) continue;
+		if (set >= layout.setLayouts.size()) {
+			throw std::runtime_error("shader uses set " + std::to_string(set) + " which is not in the pipeline layout");
+		}
+		const auto& declared = layout.setLayouts[set]->GetBindings();
+		for (const auto& binding : reflected.sets[set]) {
+			auto declaredIt = declared.find(binding.binding);
+			if (declaredIt == declared.end() ||
+				declaredIt->second.descriptorType != binding.descriptorType ||
+				declaredIt->second.descriptorCount < binding.descriptorCount ||
+				(binding.stageFlags & ~declaredIt->second.stageFlags) != 0) {
+				throw std::runtime_error("shader binding set " + std::to_string(set) + ", binding " +
+					std::to_string(binding.binding) + " no longer matches the pipeline layout");
+			}
+		}
+	}
+
+	auto sameRange = [](const VkPushConstantRange& x, const VkPushConstantRange& y) {
+		return x.stageFlags == y.stageFlags && x.offset == y.offset && x.size == y.size;
+	};
+	if (!std::equal(reflected.pushConstantRanges.begin(), reflected.pushConstantRanges.end(),
+		layout.pushConstantRanges.begin(), layout.pushConstantRanges.end(), sameRange)) {
+		throw std::runtime_error("shader push constants no longer match the pipeline layout");
+	}
+}
+
+bool LveLayoutCache::IsCompatible(VkPipelineLayout a, VkPipelineLayout b, uint32_t set) const
+{
+	if (a == b) {
+		return a != VK_NULL_HANDLE;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto itA = m_byHandle.find(a);
+	auto itB = m_byHandle.find(b);
+	if (itA == m_byHandle.end() || itB == m_byHandle.end()) {
+		return false;
+	}
+	const PipelineLayout& layoutA = *itA->second;
+	const PipelineLayout& layoutB = *itB->second;
+	if (layoutA.setLayouts.size() <= set || layoutB.setLayouts.size() <= set) {
+		return false;
+	}
+	for (uint32_t i = 0; i <= set; i++) {
+		if (layoutA.setLayouts[i] != layoutB.setLayouts[i]) {
+			return false;
+		}
+	}
+
+	auto sameRange = [](const VkPushConstantRange& x, const VkPushConstantRange& y) {
+		return x.stageFlags == y.stageFlags && x.offset == y.offset && x.size == y.size;
+	};
+	return std::equal(layoutA.pushConstantRanges.begin(), layoutA.pushConstantRanges.end(),
+		layoutB.pushConstantRanges.begin(), layoutB.pushConstantRanges.end(), sameRange);
+}
+
+}  // namespace lve
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include "LveDescriptors.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+/* 由SPIR-V反射生成描述符集布局与管线布局
+ * 用spirv_cross读取着色器中各set/binding的描述符类型与push常量块，按阶段合并
+ * 绑定完全相同的set layout、组成完全相同的pipeline layout只创建一次，句柄在各系统之间共享
+ * 由LveDevice持有，设备销毁前释放所有布局
+ */
+class LveLayoutCache {
+public:
+	struct PipelineLayout {
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::vector<LveDescriptorSetLayout*> setLayouts;	// 下标为set编号
+		std::vector<VkPushConstantRange> pushConstantRanges;
+	};
+
+	explicit LveLayoutCache(LveDevice& device);
+	~LveLayoutCache();
+
+	LveLayoutCache(const LveLayoutCache&) = delete;
+	LveLayoutCache& operator=(const LveLayoutCache&) = delete;
+
+	/* 反射shaderPaths（GLSL源码或.spv）并返回共享的管线布局
+	 * sharedSets中给出的set（如全局set 0）直接使用，反射结果只用来校验：
+	 * 着色器用到的每个绑定都必须在其中存在、类型相同、阶段被包含，否则抛出
+	 */
+	const PipelineLayout& GetPipelineLayout(const std::vector<std::string>& shaderPaths,
+		const std::unordered_map<uint32_t, LveDescriptorSetLayout*>& sharedSets = {},
+		const std::vector<std::string>& defines = {});
+
+	/* 热重载时校验修改后的着色器仍能使用已创建的管线布局：
+	 * 用到的每个绑定都必须在布局中存在、类型相同、数量足够、阶段被包含，push常量范围必须完全相同，否则抛出
+	 */
+	void Validate(VkPipelineLayout pipelineLayout, const std::vector<std::string>& shaderPaths,
+		const std::vector<std::string>& defines = {}) const;
+
+	/* a与b在set 0..set上兼容（这些set layout相同且push常量范围相同）时，
+	 * 切换管线布局后已绑定的这些描述符集仍然有效，不需要重新绑定
+	 */
+	bool IsCompatible(VkPipelineLayout a, VkPipelineLayout b, uint32_t set) const;
+
+private:
+	struct ShaderLayout {
+		std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+		std::vector<VkPushConstantRange> pushConstantRanges;
+	};
+
+	static void Reflect(const std::string& path, const std::vector<std::string>& defines, ShaderLayout& layout);
+	LveDescriptorSetLayout* GetSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+
+	LveDevice& m_lveDevice;
+	mutable std::mutex m_mutex;
+	std::unordered_map<std::string, std::unique_ptr<LveDescriptorSetLayout>> m_setLayouts;	// 键为排序后的绑定
+	std::unordered_map<std::string, std::unique_ptr<PipelineLayout>> m_pipelineLayouts;	// 键为set layout句柄 + push常量范围
+	std::unordered_map<VkPipelineLayout, const PipelineLayout*> m_byHandle;
+};
+
+}  // namespace lve
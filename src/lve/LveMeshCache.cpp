@@ -0,0 +1,275 @@
+﻿#include "LveMeshCache.h"
+
+#include "LveUtils.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+namespace lve {
+
+static constexpr char MESH_CACHE_MAGIC[8] = { 'L', 'V', 'E', 'M', 'E', 'S', 'H', '\0' };
+
+// *************** Mapped File *********************
+
+std::shared_ptr<LveMappedFile> LveMappedFile::Open(const std::string& path)
+{
+	std::shared_ptr<LveMappedFile> file(new LveMappedFile());
+#ifdef _WIN32
+	/*允许写共享，缓存命中时需要在映射期间回写文件头*/
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+	file->m_file = handle;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+		return nullptr;
+	}
+	file->m_size = static_cast<size_t>(size.QuadPart);
+
+	file->m_mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (file->m_mapping == nullptr) {
+		return nullptr;
+	}
+	file->m_data = static_cast<const char*>(MapViewOfFile(file->m_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return nullptr;
+	}
+	struct stat st{};
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return nullptr;
+	}
+	file->m_size = static_cast<size_t>(st.st_size);
+	void* data = mmap(nullptr, file->m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	/*映射建立后即可关闭描述符*/
+	close(fd);
+	if (data == MAP_FAILED) {
+		return nullptr;
+	}
+	file->m_data = static_cast<const char*>(data);
+#endif
+	if (file->m_data == nullptr) {
+		return nullptr;
+	}
+	return file;
+}
+
+LveMappedFile::~LveMappedFile()
+{
+#ifdef _WIN32
+	if (m_data != nullptr) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping != nullptr) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file != nullptr) {
+		CloseHandle(m_file);
+	}
+#else
+	if (m_data != nullptr) {
+		munmap(const_cast<char*>(m_data), m_size);
+	}
+#endif
+}
+
+// *************** Mesh Cache *********************
+
+/*读取源文件的修改时间与大小，失败时返回false*/
+static bool QuerySourceStamp(const std::string& sourcePath, int64_t& mtime, uint64_t& size)
+{
+	std::error_code ec;
+	auto time = std::filesystem::last_write_time(sourcePath, ec);
+	if (ec) {
+		return false;
+	}
+	auto fileSize = std::filesystem::file_size(sourcePath, ec);
+	if (ec) {
+		return false;
+	}
+	mtime = static_cast<int64_t>(time.time_since_epoch().count());
+	size = static_cast<uint64_t>(fileSize);
+	return true;
+}
+
+/*对源文件内容做哈希；只在修改时间对不上时才需要读取整个源文件*/
+static bool HashSourceFile(const std::string& sourcePath, uint64_t& hash)
+{
+	std::shared_ptr<LveMappedFile> source = LveMappedFile::Open(sourcePath);
+	if (!source) {
+		return false;
+	}
+	hash = HashBytes(source->GetData(), source->GetSize());
+	return true;
+}
+
+static uint64_t HashHeader(const LveMeshCache::Header& header)
+{
+	return HashBytes(&header, offsetof(LveMeshCache::Header, headerHash));
+}
+
+/*只回写文件头，负载不变，已映射的顶点与索引数据不受影响；失败时下次加载仍会退回到内容哈希*/
+static void RewriteHeader(const std::string& cachePath, const LveMeshCache::Header& header)
+{
+	std::fstream out(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+	if (!out) {
+		return;
+	}
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+static uint64_t HashSourcePath(const std::string& sourcePath)
+{
+	std::error_code ec;
+	std::string canonical = std::filesystem::weakly_canonical(sourcePath, ec).generic_string();
+	if (ec) {
+		canonical = sourcePath;
+	}
+	return HashBytes(canonical.data(), canonical.size());
+}
+
+std::string LveMeshCache::GetCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".lvemesh";
+}
+
+bool LveMeshCache::Load(const std::string& sourcePath, LveModel::Builder& builder)
+{
+	int64_t mtime = 0;
+	uint64_t sourceSize = 0;
+	if (!QuerySourceStamp(sourcePath, mtime, sourceSize)) {
+		return false;
+	}
+
+	std::shared_ptr<LveMappedFile> file = LveMappedFile::Open(GetCachePath(sourcePath));
+	if (!file || file->GetSize() < sizeof(Header)) {
+		return false;
+	}
+
+	Header header;
+	memcpy(&header, file->GetData(), sizeof(Header));
+	if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 ||
+		header.version != VERSION ||
+		header.vertexStride != sizeof(LveModel::Vertex) ||
+		header.headerHash != HashHeader(header) ||
+		header.sourcePathHash != HashSourcePath(sourcePath) ||
+		header.sourceSize != sourceSize) {
+		return false;
+	}
+
+	/*修改时间变了（例如重新检出）时退回到内容哈希比较*/
+	const bool stampChanged = header.sourceMtime != mtime;
+	if (stampChanged) {
+		uint64_t sourceHash = 0;
+		if (!HashSourceFile(sourcePath, sourceHash) || sourceHash != header.sourceHash) {
+			return false;
+		}
+	}
+
+	const uint64_t vertexBytes = header.vertexCount * sizeof(LveModel::Vertex);
+	const uint64_t indexBytes = header.indexCount * sizeof(uint32_t);
+	if (header.vertexCount > UINT32_MAX || header.indexCount > UINT32_MAX ||
+		sizeof(Header) + vertexBytes + indexBytes != file->GetSize()) {
+		return false;
+	}
+
+	/* 热加载只校验文件头哈希与精确的文件大小，不读取负载，保持映射按需换页
+	 * 时间戳变化时本来就要读源文件，顺带校验一次负载；调试构建每次都校验
+	 */
+	const char* payload = file->GetData() + sizeof(Header);
+#ifdef NDEBUG
+	const bool verifyPayload = stampChanged;
+#else
+	const bool verifyPayload = true;
+#endif
+	if (verifyPayload && HashBytes(payload, static_cast<size_t>(vertexBytes + indexBytes)) != header.payloadHash) {
+		std::cerr << "mesh cache corrupted: " << GetCachePath(sourcePath) << "\n";
+		return false;
+	}
+
+	/*内容未变时更新记录的修改时间，之后的加载不必再哈希整个源文件*/
+	if (stampChanged) {
+		header.sourceMtime = mtime;
+		header.sourceSize = sourceSize;
+		header.headerHash = HashHeader(header);
+		RewriteHeader(GetCachePath(sourcePath), header);
+	}
+
+	builder.vertices.clear();
+	builder.indices.clear();
+	builder.mappedCache = file;
+	builder.mappedVertices = reinterpret_cast<const LveModel::Vertex*>(payload);
+	builder.mappedVertexCount = static_cast<uint32_t>(header.vertexCount);
+	builder.mappedIndices = reinterpret_cast<const uint32_t*>(payload + vertexBytes);
+	builder.mappedIndexCount = static_cast<uint32_t>(header.indexCount);
+	return true;
+}
+
+void LveMeshCache::Store(const std::string& sourcePath, const LveModel::Builder& builder)
+{
+	Header header{};
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+	header.version = VERSION;
+	header.vertexStride = sizeof(LveModel::Vertex);
+	header.sourcePathHash = HashSourcePath(sourcePath);
+	if (!QuerySourceStamp(sourcePath, header.sourceMtime, header.sourceSize) ||
+		!HashSourceFile(sourcePath, header.sourceHash)) {
+		return;
+	}
+
+	const size_t vertexBytes = builder.GetVertexCount() * sizeof(LveModel::Vertex);
+	const size_t indexBytes = builder.GetIndexCount() * sizeof(uint32_t);
+	header.vertexCount = builder.GetVertexCount();
+	header.indexCount = builder.GetIndexCount();
+	header.payloadHash = HashBytes(builder.GetVertexData(), vertexBytes);
+	header.payloadHash = HashBytes(builder.GetIndexData(), indexBytes, header.payloadHash);
+	header.headerHash = HashHeader(header);
+
+	const std::string cachePath = GetCachePath(sourcePath);
+	const std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			std::cerr << "failed to write mesh cache: " << cachePath << "\n";
+			return;
+		}
+		out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		out.write(reinterpret_cast<const char*>(builder.GetVertexData()), vertexBytes);
+		out.write(reinterpret_cast<const char*>(builder.GetIndexData()), indexBytes);
+		if (!out) {
+			std::cerr << "failed to write mesh cache: " << cachePath << "\n";
+			return;
+		}
+	}
+
+	/*重命名是原子的，其他进程不会读到写了一半的缓存*/
+	std::error_code ec;
+	std::filesystem::rename(tempPath, cachePath, ec);
+	if (ec) {
+		std::filesystem::remove(tempPath, ec);
+		std::cerr << "failed to write mesh cache: " << cachePath << "\n";
+	}
+}
+
+}  // namespace lve
@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include "LveModel.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace lve {
+
+/*只读内存映射文件，析构时解除映射*/
+class LveMappedFile {
+public:
+	static std::shared_ptr<LveMappedFile> Open(const std::string& path);
+	~LveMappedFile();
+
+	LveMappedFile(const LveMappedFile&) = delete;
+	LveMappedFile& operator=(const LveMappedFile&) = delete;
+
+	const char* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	LveMappedFile() = default;
+
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
+
+/* 二进制网格缓存
+ * 保存去重后的Vertex/index数组，文件为 <源文件>.lvemesh，紧挨着源文件
+ * 头部记录源路径哈希、源文件修改时间、大小和内容哈希，任何一项对不上都视为失效
+ * 热启动时直接映射缓存文件，顶点/索引数据从映射内存拷进staging环，不再经过tinyobj
+ */
+class LveMeshCache {
+public:
+	static constexpr uint32_t VERSION = 2;
+
+	struct Header {
+		char magic[8];				// "LVEMESH\0"
+		uint32_t version;
+		uint32_t vertexStride;		// sizeof(LveModel::Vertex)，顶点布局变化时缓存自动失效
+		uint64_t sourcePathHash;
+		int64_t sourceMtime;
+		uint64_t sourceSize;
+		uint64_t sourceHash;		// 源文件内容哈希，修改时间变了但内容没变时仍可命中
+		uint64_t vertexCount;
+		uint64_t indexCount;
+		uint64_t payloadHash;		// 顶点+索引数据的哈希，只在源文件时间戳变化或调试构建时校验
+		uint64_t headerHash;		// 之前所有字段的哈希，每次加载都校验
+	};
+
+	/*缓存有效时填充builder（数据指向映射内存）并返回true*/
+	static bool Load(const std::string& sourcePath, LveModel::Builder& builder);
+	/*把解析结果写入缓存，先写临时文件再重命名，写入失败只打印警告*/
+	static void Store(const std::string& sourcePath, const LveModel::Builder& builder);
+
+	static std::string GetCachePath(const std::string& sourcePath);
+};
+
+}  // namespace lve
@@ -0,0 +1,117 @@
+﻿#include "LveMeshPool.h"
+
+#include "LveModel.h"
+#include "LveSwapChain.h"
+
+#include <cassert>
+
+namespace lve {
+
+// *************** Range Allocator *********************
+
+bool LveMeshPool::RangeAllocator::Allocate(uint32_t count, uint32_t& offset)
+{
+	for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it) {
+		if (it->second < count) continue;
+
+		offset = it->first;
+		uint32_t remaining = it->second - count;
+		m_freeRanges.erase(it);
+		if (remaining > 0) {
+			m_freeRanges.emplace(offset + count, remaining);
+		}
+		return true;
+	}
+	return false;
+}
+
+void LveMeshPool::RangeAllocator::Free(uint32_t offset, uint32_t count)
+{
+	auto next = m_freeRanges.lower_bound(offset);
+	/*与后一个空闲区间相邻则合并*/
+	if (next != m_freeRanges.end() && offset + count == next->first) {
+		count += next->second;
+		next = m_freeRanges.erase(next);
+	}
+	/*与前一个空闲区间相邻则合并*/
+	if (next != m_freeRanges.begin()) {
+		auto prev = std::prev(next);
+		assert(prev->first + prev->second <= offset && "Double free in mesh pool");
+		if (prev->first + prev->second == offset) {
+			prev->second += count;
+			return;
+		}
+	}
+	m_freeRanges.emplace(offset, count);
+}
+
+// *************** Mesh Pool *********************
+
+LveMeshPool::LveMeshPool(LveDevice& device, uint32_t maxVertices, uint32_t maxIndices)
+	: m_lveDevice{ device }, m_vertexRanges{ maxVertices }, m_indexRanges{ maxIndices }
+{
+	m_vertexBuffer = std::make_unique<LveBuffer>(m_lveDevice,
+		sizeof(LveModel::Vertex),
+		maxVertices,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	m_indexBuffer = std::make_unique<LveBuffer>(m_lveDevice,
+		sizeof(uint32_t),
+		maxIndices,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+LveMeshPool::~LveMeshPool()
+{
+}
+
+bool LveMeshPool::Allocate(uint32_t vertexCount, uint32_t indexCount, Allocation& allocation)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint32_t vertexOffset = 0;
+	if (!m_vertexRanges.Allocate(vertexCount, vertexOffset)) {
+		return false;
+	}
+	uint32_t firstIndex = 0;
+	if (!m_indexRanges.Allocate(indexCount, firstIndex)) {
+		m_vertexRanges.Free(vertexOffset, vertexCount);
+		return false;
+	}
+
+	allocation.vertexOffset = vertexOffset;
+	allocation.vertexCount = vertexCount;
+	allocation.firstIndex = firstIndex;
+	allocation.indexCount = indexCount;
+	return true;
+}
+
+void LveMeshPool::Free(const Allocation& allocation)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_retired.push_back({ m_frameCounter, allocation });
+}
+
+void LveMeshPool::NextFrame()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_frameCounter++;
+	while (!m_retired.empty() && m_frameCounter - m_retired.front().frame >= LveSwapChain::MAX_FRAMES_IN_FLIGHT) {
+		const Allocation& allocation = m_retired.front().allocation;
+		m_vertexRanges.Free(allocation.vertexOffset, allocation.vertexCount);
+		m_indexRanges.Free(allocation.firstIndex, allocation.indexCount);
+		m_retired.pop_front();
+	}
+}
+
+void LveMeshPool::Bind(VkCommandBuffer commandBuffer)
+{
+	VkBuffer buffers[] = { m_vertexBuffer->GetBuffer() };
+	VkDeviceSize offsets[] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+}  // namespace lve
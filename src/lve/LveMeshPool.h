@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include "LveDevice.h"
+#include "LveBuffer.h"
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace lve {
+
+/* 共享的顶点/索引大缓冲区
+ * 静态网格从中子分配一段顶点和一段索引，所有网格共用同一对VkBuffer，
+ * 绘制时只需绑定一次，再用firstIndex/vertexOffset区分网格，可以直接用于间接绘制
+ */
+class LveMeshPool {
+public:
+	static constexpr uint32_t DEFAULT_MAX_VERTICES = 1u << 20;	// 44 MiB
+	static constexpr uint32_t DEFAULT_MAX_INDICES = 4u << 20;	// 16 MiB
+
+	/*以元素为单位，不是字节*/
+	struct Allocation {
+		uint32_t vertexOffset = 0;
+		uint32_t vertexCount = 0;
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+	};
+
+	LveMeshPool(LveDevice& device, uint32_t maxVertices = DEFAULT_MAX_VERTICES, uint32_t maxIndices = DEFAULT_MAX_INDICES);
+	~LveMeshPool();
+
+	LveMeshPool(const LveMeshPool&) = delete;
+	LveMeshPool& operator=(const LveMeshPool&) = delete;
+
+	/*空间不足时返回false，调用者应改用独立缓冲区；线程安全*/
+	bool Allocate(uint32_t vertexCount, uint32_t indexCount, Allocation& allocation);
+	/*已录制的绘制命令可能仍在读取该区间，MAX_FRAMES_IN_FLIGHT帧之后才真正回收；线程安全*/
+	void Free(const Allocation& allocation);
+	/*每帧调用一次，回收已经没有帧在使用的区间*/
+	void NextFrame();
+
+	void Bind(VkCommandBuffer commandBuffer);
+
+	VkBuffer GetVertexBuffer() const { return m_vertexBuffer->GetBuffer(); }
+	VkBuffer GetIndexBuffer() const { return m_indexBuffer->GetBuffer(); }
+
+private:
+	/*首次适配的区间分配器，释放时与相邻空闲区间合并*/
+	class RangeAllocator {
+	public:
+		explicit RangeAllocator(uint32_t capacity) { m_freeRanges.emplace(0, capacity); }
+		bool Allocate(uint32_t count, uint32_t& offset);
+		void Free(uint32_t offset, uint32_t count);
+
+	private:
+		std::map<uint32_t, uint32_t> m_freeRanges;	// 起点 -> 长度
+	};
+
+	LveDevice& m_lveDevice;
+	std::unique_ptr<LveBuffer> m_vertexBuffer;
+	std::unique_ptr<LveBuffer> m_indexBuffer;
+
+	struct RetiredAllocation {
+		uint64_t frame = 0;
+		Allocation allocation;
+	};
+
+	std::mutex m_mutex;
+	RangeAllocator m_vertexRanges;
+	RangeAllocator m_indexRanges;
+	std::deque<RetiredAllocation> m_retired;	// 等待在途帧结束后回收的区间
+	uint64_t m_frameCounter = 0;
+};
+
+}  // namespace lve
@@ -1,15 +1,20 @@
 ﻿#include "LveModel.h"
 
 #include "LveUtils.h"
+#include "LveMeshCache.h"
+#include "LveThreadPool.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <gtx/hash.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <iostream>
+#include <numeric>
 #include <unordered_map>
 
 namespace std {
@@ -28,13 +33,64 @@ namespace lve {
 LveModel::LveModel(LveDevice& m_lveDevice, const LveModel::Builder& builder)
 	: m_lveDevice{ m_lveDevice }
 {
-	CreateVertexBuffer(builder.vertices);
-	CreateIndexBuffer(builder.indices);
+	UploadGeometry(builder);
+}
+
+LveModel::LveModel(LveDevice& lveDevice)
+	: m_lveDevice{ lveDevice }
+{
 }
 
 LveModel::~LveModel()
 {
-	
+	/*缓冲区可能仍是未完成复制的目标*/
+	m_lveDevice.waitForUpload(m_uploadTicket);
+	if (m_meshPool != nullptr) {
+		m_meshPool->Free(m_poolAllocation);
+	}
+}
+
+void LveModel::UploadGeometry(const Builder& builder, LveMeshPool* meshPool)
+{
+	assert(!m_hasGeometry.load() && "Model geometry already uploaded");
+	m_bounds = builder.ComputeBounds();
+	if (meshPool == nullptr || !UploadToMeshPool(builder, *meshPool)) {
+		CreateVertexBuffer(builder.GetVertexData(), builder.GetVertexCount());
+		CreateIndexBuffer(builder.GetIndexData(), builder.GetIndexCount());
+	}
+	m_hasGeometry.store(true, std::memory_order_release);
+}
+
+bool LveModel::UploadToMeshPool(const Builder& builder, LveMeshPool& meshPool)
+{
+	uint32_t vertexCount = builder.GetVertexCount();
+	assert(vertexCount >= 3 && "Vertex count must be at least 3");
+
+	/*大缓冲区统一走索引绘制*/
+	const uint32_t* indices = builder.GetIndexData();
+	uint32_t indexCount = builder.GetIndexCount();
+	std::vector<uint32_t> sequentialIndices;
+	if (indexCount == 0) {
+		sequentialIndices.resize(vertexCount);
+		std::iota(sequentialIndices.begin(), sequentialIndices.end(), 0u);
+		indices = sequentialIndices.data();
+		indexCount = vertexCount;
+	}
+
+	if (!meshPool.Allocate(vertexCount, indexCount, m_poolAllocation)) {
+		std::cerr << "mesh pool is full, falling back to dedicated buffers\n";
+		return false;
+	}
+	m_meshPool = &meshPool;
+	m_vertexCount = vertexCount;
+	m_indexCount = indexCount;
+	m_hasIndexBuffer = true;
+
+	m_lveDevice.uploadToBuffer(builder.GetVertexData(), sizeof(Vertex) * static_cast<VkDeviceSize>(vertexCount),
+		meshPool.GetVertexBuffer(), sizeof(Vertex) * static_cast<VkDeviceSize>(m_poolAllocation.vertexOffset));
+	m_uploadTicket = m_lveDevice.uploadToBuffer(indices, sizeof(uint32_t) * static_cast<VkDeviceSize>(indexCount),
+		meshPool.GetIndexBuffer(), sizeof(uint32_t) * static_cast<VkDeviceSize>(m_poolAllocation.firstIndex));
+	return true;
 }
 
 std::unique_ptr<LveModel> LveModel::CreateModelFromFile(LveDevice& m_lveDevice, const std::string& filepath)
@@ -42,26 +98,18 @@ std::unique_ptr<LveModel> LveModel::CreateModelFromFile(LveDevice& m_lveDevice,
 	Builder builder;
 	builder.LoadModel(filepath);
 
-	std::cout << "Vertex count: " << builder.vertices.size() << "\n";
+	std::cout << "Vertex count: " << builder.GetVertexCount() << "\n";
 
 	return std::make_unique<LveModel>(m_lveDevice, builder);
 }
 
-void LveModel::CreateVertexBuffer(const std::vector<Vertex>& vertices)
+void LveModel::CreateVertexBuffer(const Vertex* vertices, uint32_t vertexCount)
 {
-	m_vertexCount = static_cast<uint32_t>(vertices.size());
+	m_vertexCount = vertexCount;
 	assert(m_vertexCount >= 3 && "Vertex count must be at least 3");
     VkDeviceSize bufferSize = sizeof(vertices[0]) * m_vertexCount;
 	uint32_t vertexSize = sizeof(vertices[0]);
 
-	LveBuffer stagingBuffer(m_lveDevice, 
-		vertexSize, 
-		m_vertexCount, 
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    stagingBuffer.Map();
-    stagingBuffer.WriteToBuffer((void*)vertices.data());
-
 	/*初始化顶点缓冲区*/
 	m_vertexBuffer = std::make_unique<LveBuffer>(m_lveDevice,
 		vertexSize,
@@ -69,12 +117,13 @@ void LveModel::CreateVertexBuffer(const std::vector<Vertex>& vertices)
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	m_lveDevice.copyBuffer(stagingBuffer.GetBuffer(), m_vertexBuffer->GetBuffer(), bufferSize);
+	/*经staging环上传，复制在下一次flushUploads时随批次提交*/
+	m_uploadTicket = m_lveDevice.uploadToBuffer(vertices, bufferSize, m_vertexBuffer->GetBuffer());
 }
 
-void LveModel::CreateIndexBuffer(const std::vector<uint32_t>& indices)
+void LveModel::CreateIndexBuffer(const uint32_t* indices, uint32_t indexCount)
 {
-	m_indexCount = static_cast<uint32_t>(indices.size());
+	m_indexCount = indexCount;
 	m_hasIndexBuffer = m_indexCount > 0;
 
 	if (!m_hasIndexBuffer) {
@@ -84,36 +133,34 @@ void LveModel::CreateIndexBuffer(const std::vector<uint32_t>& indices)
 	VkDeviceSize bufferSize = sizeof(indices[0]) * m_indexCount;
 	uint32_t indexSize = sizeof(indices[0]);
 
-	LveBuffer stagingBuffer(m_lveDevice,
-		indexSize,
-		m_indexCount,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	stagingBuffer.Map();
-	stagingBuffer.WriteToBuffer((void*)indices.data());
-
 	m_indexBuffer = std::make_unique<LveBuffer>(m_lveDevice,
 		indexSize,
 		m_indexCount,
 		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	m_lveDevice.copyBuffer(stagingBuffer.GetBuffer(), m_indexBuffer->GetBuffer(), bufferSize);
+	m_uploadTicket = m_lveDevice.uploadToBuffer(indices, bufferSize, m_indexBuffer->GetBuffer());
 }
 
-void LveModel::Draw(VkCommandBuffer commandBuffer) 
+void LveModel::Draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance) 
 {
 	/*检查是否存在索引缓冲区*/
 	if (m_hasIndexBuffer) {
-		vkCmdDrawIndexed(commandBuffer, m_indexCount, 1, 0, 0, 0);
+		vkCmdDrawIndexed(commandBuffer, m_indexCount, instanceCount,
+			m_poolAllocation.firstIndex, static_cast<int32_t>(m_poolAllocation.vertexOffset), firstInstance);
 	}
 	else {
-		vkCmdDraw(commandBuffer, m_vertexCount, 1, 0, 0);
+		vkCmdDraw(commandBuffer, m_vertexCount, instanceCount, 0, firstInstance);
 	}
 	
 }
 
 void LveModel::Bind(VkCommandBuffer commandBuffer) {
+	if (m_meshPool != nullptr) {
+		m_meshPool->Bind(commandBuffer);
+		return;
+	}
+
 	VkBuffer buffer[] = { m_vertexBuffer->GetBuffer()};
 	VkDeviceSize offsets[] = { 0 };
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffer, offsets);
@@ -146,6 +193,217 @@ std::vector<VkVertexInputAttributeDescription> LveModel::Vertex::GetAttributeDes
 }
 
 void LveModel::Builder::LoadModel(const std::string& filepath)
+{
+	/*热启动：缓存有效时直接使用映射的顶点/索引数组*/
+	if (LveMeshCache::Load(filepath, *this)) {
+		return;
+	}
+
+	ParseObj(filepath);
+	LveMeshCache::Store(filepath, *this);
+}
+
+LveModel::Bounds LveModel::Builder::ComputeBounds() const
+{
+	Bounds bounds{};
+	const Vertex* data = GetVertexData();
+	uint32_t vertexCount = GetVertexCount();
+	if (vertexCount == 0) {
+		return bounds;
+	}
+
+	bounds.min = data[0].position;
+	bounds.max = data[0].position;
+	for (uint32_t i = 1; i < vertexCount; i++) {
+		bounds.min = glm::min(bounds.min, data[i].position);
+		bounds.max = glm::max(bounds.max, data[i].position);
+	}
+	glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+
+	float radiusSquared = 0.f;
+	for (uint32_t i = 0; i < vertexCount; i++) {
+		glm::vec3 d = data[i].position - center;
+		radiusSquared = (std::max)(radiusSquared, glm::dot(d, d));
+	}
+	bounds.sphere = glm::vec4(center, std::sqrt(radiusSquared));
+	return bounds;
+}
+
+/*面角数少于该值时并行的调度开销不划算*/
+static constexpr size_t PARALLEL_CORNER_THRESHOLD = 64 * 1024;
+static constexpr size_t CORNER_CHUNK = 16 * 1024;
+
+static LveModel::Vertex MakeVertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index)
+{
+	LveModel::Vertex vertex{};
+
+	if (index.vertex_index >= 0) {
+		vertex.position = {
+			attrib.vertices[3 * index.vertex_index + 0],
+			attrib.vertices[3 * index.vertex_index + 1],
+			attrib.vertices[3 * index.vertex_index + 2],
+		};
+
+		vertex.color = {
+			attrib.colors[3 * index.vertex_index + 0],
+			attrib.colors[3 * index.vertex_index + 1],
+			attrib.colors[3 * index.vertex_index + 2],
+		};
+	}
+
+	if (index.normal_index >= 0) {
+		vertex.normal = {
+			attrib.normals[3 * index.normal_index + 0],
+			attrib.normals[3 * index.normal_index + 1],
+			attrib.normals[3 * index.normal_index + 2],
+		};
+	}
+
+	if (index.texcoord_index >= 0) {
+		vertex.uv = {
+			attrib.texcoords[2 * index.texcoord_index + 0],
+			attrib.texcoords[2 * index.texcoord_index + 1],
+		};
+	}
+	return vertex;
+}
+
+/*按位哈希顶点，-0与+0视为同一值，与operator==的浮点比较保持一致*/
+static uint64_t HashVertexBits(const LveModel::Vertex& vertex)
+{
+	static_assert(sizeof(LveModel::Vertex) == 11 * sizeof(float), "Vertex must be tightly packed floats");
+	const float* components = reinterpret_cast<const float*>(&vertex);
+	uint64_t hash = 0;
+	for (int i = 0; i < 11; i++) {
+		float value = components[i] == 0.f ? 0.f : components[i];
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		hash = (hash ^ bits) * 0x9e3779b97f4a7c15ull;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+/*原始路径：逐面角插入基于节点的unordered_map*/
+static void BuildSerial(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+	std::vector<LveModel::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::unordered_map<LveModel::Vertex, uint32_t> uniqueVertices{};
+	for (const auto& shape : shapes) {
+		for (const auto& index : shape.mesh.indices) {
+			LveModel::Vertex vertex = MakeVertex(attrib, index);
+
+			if (uniqueVertices.count(vertex) == 0) {
+				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(vertex);
+			}
+			indices.push_back(uniqueVertices[vertex]);
+		}
+	}
+}
+
+/* 并行路径，结果与BuildSerial逐字节一致
+ * 1. 并行展开所有面角并计算哈希
+ * 2. 并行按哈希高位把面角分到各分区的桶里，每个块内保持面角顺序
+ * 3. 每个线程只负责一个分区，按块顺序遍历桶插入开放寻址表，
+ *    得到每个面角对应的首次出现位置
+ * 4. 按面角顺序给首次出现的顶点编号，再并行写出顶点和索引
+ */
+static void BuildParallel(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+	std::vector<LveModel::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	LveThreadPool& pool = LveThreadPool::Shared();
+
+	std::vector<size_t> shapeOffsets(shapes.size() + 1, 0);
+	for (size_t s = 0; s < shapes.size(); s++) {
+		shapeOffsets[s + 1] = shapeOffsets[s] + shapes[s].mesh.indices.size();
+	}
+	const size_t cornerCount = shapeOffsets.back();
+	assert(cornerCount <= UINT32_MAX && "Too many face corners for 32-bit indices");
+
+	std::vector<LveModel::Vertex> corners(cornerCount);
+	std::vector<uint64_t> hashes(cornerCount);
+	pool.ParallelFor(cornerCount, CORNER_CHUNK, [&](size_t begin, size_t end) {
+		size_t s = std::upper_bound(shapeOffsets.begin(), shapeOffsets.end(), begin) - shapeOffsets.begin() - 1;
+		for (size_t i = begin; i < end; i++) {
+			while (i >= shapeOffsets[s + 1]) s++;
+			corners[i] = MakeVertex(attrib, shapes[s].mesh.indices[i - shapeOffsets[s]]);
+			hashes[i] = HashVertexBits(corners[i]);
+		}
+	});
+
+	/*buckets[block * partitionCount + partition]：该块中属于该分区的面角，按面角顺序*/
+	const size_t partitionCount = pool.GetThreadCount() + 1;
+	const size_t blockCount = (cornerCount + CORNER_CHUNK - 1) / CORNER_CHUNK;
+	std::vector<std::vector<uint32_t>> buckets(blockCount * partitionCount);
+	pool.ParallelFor(blockCount, 1, [&](size_t blockBegin, size_t blockEnd) {
+		for (size_t block = blockBegin; block < blockEnd; block++) {
+			const size_t end = (std::min)(cornerCount, (block + 1) * CORNER_CHUNK);
+			for (size_t i = block * CORNER_CHUNK; i < end; i++) {
+				buckets[block * partitionCount + (hashes[i] >> 40) % partitionCount].push_back(static_cast<uint32_t>(i));
+			}
+		}
+	});
+
+	/*first[i]：与面角i相同的顶点第一次出现的面角下标*/
+	std::vector<uint32_t> first(cornerCount);
+	pool.ParallelFor(partitionCount, 1, [&](size_t partitionBegin, size_t partitionEnd) {
+		for (size_t partition = partitionBegin; partition < partitionEnd; partition++) {
+			size_t ownedCount = 0;
+			for (size_t block = 0; block < blockCount; block++) {
+				ownedCount += buckets[block * partitionCount + partition].size();
+			}
+			size_t capacity = 16;
+			while (capacity < ownedCount * 2) capacity <<= 1;
+			const size_t mask = capacity - 1;
+			std::vector<uint32_t> table(capacity, UINT32_MAX);
+
+			/*块按顺序遍历，桶内也是面角顺序，保证先插入的是首次出现的面角*/
+			for (size_t block = 0; block < blockCount; block++) {
+				for (uint32_t i : buckets[block * partitionCount + partition]) {
+					const uint64_t hash = hashes[i];
+					size_t slot = static_cast<size_t>(hash) & mask;
+					while (true) {
+						uint32_t candidate = table[slot];
+						if (candidate == UINT32_MAX) {
+							table[slot] = i;
+							first[i] = i;
+							break;
+						}
+						if (hashes[candidate] == hash && corners[candidate] == corners[i]) {
+							first[i] = candidate;
+							break;
+						}
+						slot = (slot + 1) & mask;
+					}
+				}
+			}
+		}
+	});
+
+	/*按首次出现顺序编号，与unordered_map路径的编号规则相同*/
+	std::vector<uint32_t> remap(cornerCount);
+	uint32_t uniqueCount = 0;
+	for (size_t i = 0; i < cornerCount; i++) {
+		if (first[i] == i) {
+			remap[i] = uniqueCount++;
+		}
+	}
+
+	vertices.resize(uniqueCount);
+	indices.resize(cornerCount);
+	pool.ParallelFor(cornerCount, CORNER_CHUNK, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			uint32_t index = remap[first[i]];
+			indices[i] = index;
+			if (first[i] == i) {
+				vertices[index] = corners[i];
+			}
+		}
+	});
+}
+
+void LveModel::Builder::ParseObj(const std::string& filepath, bool multithreaded)
 {
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
@@ -159,50 +417,20 @@ void LveModel::Builder::LoadModel(const std::string& filepath)
         throw std::runtime_error(warn + err);
 	}
 
+	mappedCache.reset();
 	vertices.clear();
 	indices.clear();
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+	size_t cornerCount = 0;
 	for (const auto& shape : shapes) {
-		for (const auto& index : shape.mesh.indices) {
-			Vertex vertex{};
-
-			if (index.vertex_index >= 0) {
-				vertex.position = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2],
-				};
-
-				vertex.color = {
-					attrib.colors[3 * index.vertex_index + 0],
-					attrib.colors[3 * index.vertex_index + 1],
-					attrib.colors[3 * index.vertex_index + 2],
-				};
-			}
-
-			if (index.normal_index >= 0) {
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2],
-				};
-			}
-
-			if (index.texcoord_index >= 0) {
-				vertex.uv = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					attrib.texcoords[2 * index.texcoord_index + 1],
-				};
-			}
-
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
-			}
-			indices.push_back(uniqueVertices[vertex]);
+		cornerCount += shape.mesh.indices.size();
+	}
 
-		}
+	if (multithreaded && cornerCount >= PARALLEL_CORNER_THRESHOLD) {
+		BuildParallel(attrib, shapes, vertices, indices);
+	}
+	else {
+		BuildSerial(attrib, shapes, vertices, indices);
 	}
 }
 
@@ -1,17 +1,21 @@
-﻿#pragma
+﻿#pragma once
 
 #include "LveDevice.h"
 #include "LveBuffer.h"
+#include "LveMeshPool.h"
 
 #define GLM_FORCE_RADIANS	// 无论在什么系统上，glm都会希望角度以弧度指定
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE	//深度缓冲区值范围从0到1，而不是-1到1（OpenGL）
 #include <glm.hpp>
 
+#include <atomic>
 #include <vector>
 #include <memory>
 
 namespace lve { 
 
+class LveMappedFile;
+
 /*在CPU创建顶点数据，分配内存并将数据复制到GPU*/
 class LveModel {
 
@@ -35,14 +39,41 @@ public:
         Vertex() = default;
 	};
 
+	/*模型空间包围体：轴对齐包围盒与包围球（xyz为球心，w为半径）*/
+	struct Bounds {
+		glm::vec3 min{ 0.f };
+		glm::vec3 max{ 0.f };
+		glm::vec4 sphere{ 0.f };
+	};
+
 	struct Builder {
 		std::vector<Vertex> vertices{};
 		std::vector<uint32_t> indices{};
 
+		/*从网格缓存加载时数据留在映射内存里，不拷贝进上面的vector*/
+		std::shared_ptr<LveMappedFile> mappedCache;
+		const Vertex* mappedVertices = nullptr;
+		uint32_t mappedVertexCount = 0;
+		const uint32_t* mappedIndices = nullptr;
+		uint32_t mappedIndexCount = 0;
+
+		/*优先读取二进制网格缓存，缓存缺失或失效时用tinyobj解析并写回缓存*/
 		void LoadModel(const std::string& filepath);
+		/*multithreaded为false时走原始的单线程unordered_map去重，两条路径输出完全一致*/
+		void ParseObj(const std::string& filepath, bool multithreaded = true);
+
+		const Vertex* GetVertexData() const { return mappedCache ? mappedVertices : vertices.data(); }
+		uint32_t GetVertexCount() const { return mappedCache ? mappedVertexCount : static_cast<uint32_t>(vertices.size()); }
+		const uint32_t* GetIndexData() const { return mappedCache ? mappedIndices : indices.data(); }
+		uint32_t GetIndexCount() const { return mappedCache ? mappedIndexCount : static_cast<uint32_t>(indices.size()); }
+
+		/*遍历顶点计算包围盒，球心取包围盒中心，半径取最远顶点的距离*/
+		Bounds ComputeBounds() const;
 	};
 
 	LveModel(LveDevice& lveDevice, const Builder& builder);
+	/*空模型：占位用，UploadGeometry之前不可见*/
+	explicit LveModel(LveDevice& lveDevice);
 	~LveModel();
 
 	static std::unique_ptr<LveModel> CreateModelFromFile(LveDevice& lveDevice, const std::string& filepath);
@@ -50,24 +81,56 @@ public:
 	LveModel(const LveModel&) = delete;
 	LveModel& operator = (const LveModel&) = delete;
 
+	/* 创建顶点/索引缓冲并提交上传，可在工作线程调用，每个模型只能调用一次
+	 * 指定meshPool时优先放进共享大缓冲区（没有索引的网格会补上顺序索引），空间不足时退回独立缓冲区
+	 */
+	void UploadGeometry(const Builder& builder, LveMeshPool* meshPool = nullptr);
+
 	void Bind(VkCommandBuffer commandBuffer);
-	void Draw(VkCommandBuffer commandBuffer);
+	/*firstInstance会加到gl_InstanceIndex上，用来索引实例缓冲区*/
+	void Draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+
+	/*顶点/索引数据是否已经由传输队列上传完成，未完成时渲染器跳过该模型*/
+	bool IsResident() const {
+		return m_hasGeometry.load(std::memory_order_acquire) && m_lveDevice.isUploadComplete(m_uploadTicket);
+	}
+	UploadTicket GetUploadTicket() const { return m_uploadTicket; }
+
+	const Bounds& GetBounds() const { return m_bounds; }
+	const glm::vec4& GetBoundingSphere() const { return m_bounds.sphere; }
+
+	/*为空表示使用独立缓冲区，不能参与间接绘制*/
+	LveMeshPool* GetMeshPool() const { return m_meshPool; }
+	VkDrawIndexedIndirectCommand GetDrawCommand(uint32_t instanceCount = 1, uint32_t firstInstance = 0) const {
+		return { m_indexCount, instanceCount, m_poolAllocation.firstIndex, static_cast<int32_t>(m_poolAllocation.vertexOffset), firstInstance };
+	}
 
 private:
-	void CreateVertexBuffer(const std::vector<Vertex>& vertices);
-	void CreateIndexBuffer(const std::vector<uint32_t>& indices);
+	void CreateVertexBuffer(const Vertex* vertices, uint32_t vertexCount);
+	void CreateIndexBuffer(const uint32_t* indices, uint32_t indexCount);
+	bool UploadToMeshPool(const Builder& builder, LveMeshPool& meshPool);
 
 	LveDevice& m_lveDevice;
 
 	/*顶点缓冲区*/
 	std::unique_ptr<LveBuffer> m_vertexBuffer;
-	uint32_t m_vertexCount;
+	uint32_t m_vertexCount = 0;
 
 	bool m_hasIndexBuffer = false;
 
 	/*索引缓冲区*/
 	std::unique_ptr<LveBuffer> m_indexBuffer;
-	uint32_t m_indexCount;
+	uint32_t m_indexCount = 0;
+
+	/*位于共享大缓冲区时的子分配，独立缓冲区时偏移都为0*/
+	LveMeshPool* m_meshPool = nullptr;
+	LveMeshPool::Allocation m_poolAllocation{};
+
+	Bounds m_bounds{};
+
+	UploadTicket m_uploadTicket = 0;
+	/*工作线程写完缓冲区和票据后置位，渲染线程看到true之后才访问它们*/
+	std::atomic<bool> m_hasGeometry{ false };
 };
 
 }
\ No newline at end of file
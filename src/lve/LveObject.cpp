@@ -1,16 +1,34 @@
 ﻿#include "LveObject.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace lve { 
 
-glm::mat4 TransformComponent::mat4()
+static constexpr float LIGHT_CUTOFF = 0.01f;   // 衰减后低于该值的光照贡献视为0
+
+bool TransformComponent::UpdateLocalMatrices()
 {
+    if (m_localUpdatedExternally) {
+        m_localUpdatedExternally = false;
+        return true;
+    }
+    if (m_cacheValid && rotation == m_cachedRotation && scale == m_cachedScale) {
+        if (translation == m_cachedTranslation) {
+            return false;
+        }
+        m_localMatrix[3] = glm::vec4(translation, 1.0f);
+        m_cachedTranslation = translation;
+        return true;
+    }
+
     const float c3 = glm::cos(rotation.z);
     const float s3 = glm::sin(rotation.z);
     const float c2 = glm::cos(rotation.x);
     const float s2 = glm::sin(rotation.x);
     const float c1 = glm::cos(rotation.y);
     const float s1 = glm::sin(rotation.y);
-    return glm::mat4{
+    m_localMatrix = glm::mat4{
         {
             scale.x * (c1 * c3 + s1 * s2 * s3),
             scale.x * (c2 * s3),
@@ -30,20 +48,10 @@ glm::mat4 TransformComponent::mat4()
             0.0f,
         },
         {translation.x, translation.y, translation.z, 1.0f} };
-}
-
-glm::mat3 TransformComponent::normalMatrix()
-{
-    const float c3 = glm::cos(rotation.z);
-    const float s3 = glm::sin(rotation.z);
-    const float c2 = glm::cos(rotation.x);
-    const float s2 = glm::sin(rotation.x);
-    const float c1 = glm::cos(rotation.y);
-    const float s1 = glm::sin(rotation.y);
 
     const glm::vec3 invScale = 1.0f / scale;
 
-    return glm::mat3{
+    m_localNormalMatrix = glm::mat3{
         {
             invScale.x * (c1 * c3 + s1 * s2 * s3),
             invScale.x * (c2 * s3),
@@ -61,17 +69,44 @@ glm::mat3 TransformComponent::normalMatrix()
         }
     };
 
+    m_cachedTranslation = translation;
+    m_cachedScale = scale;
+    m_cachedRotation = rotation;
+    m_cacheValid = true;
+    return true;
 }
 
-LveObject LveObject::MakePointLight(float intensity, float radius, glm::vec3 color)
+void TransformComponent::SetLocalMatrices(const glm::mat4& localMatrix, const glm::mat3& localNormalMatrix)
 {
-    LveObject obj = LveObject::CreateObject();
-    obj.color = color;
-    obj.transform.scale.x = radius;
-    obj.pointLight = std::make_unique<PointLightComponent>();
-    obj.pointLight->lightIntensity = intensity;
+    m_localMatrix = localMatrix;
+    m_localNormalMatrix = localNormalMatrix;
+    m_cachedTranslation = translation;
+    m_cachedScale = scale;
+    m_cachedRotation = rotation;
+    m_cacheValid = true;
+    m_localUpdatedExternally = true;
+}
 
-    return obj;
+/*法线矩阵是线性部分的逆转置，乘积的逆转置等于各自逆转置的乘积*/
+void TransformComponent::UpdateWorldMatrices(const TransformComponent* parent)
+{
+    if (parent == nullptr) {
+        m_worldMatrix = m_localMatrix;
+        m_normalMatrix = m_localNormalMatrix;
+        return;
+    }
+    m_worldMatrix = parent->m_worldMatrix * m_localMatrix;
+    m_normalMatrix = parent->m_normalMatrix * m_localNormalMatrix;
+}
+
+/*1 / d^2衰减下，最亮颜色分量降到LIGHT_CUTOFF时的距离*/
+float PointLightComponent::GetRange() const
+{
+    if (range > 0.f) {
+        return range;
+    }
+    float peak = lightIntensity * (std::max)({ color.x, color.y, color.z });
+    return std::sqrt((std::max)(peak, 0.f) / LIGHT_CUTOFF);
 }
 
 }
\ No newline at end of file
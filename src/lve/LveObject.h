@@ -5,7 +5,6 @@
 #include <gtc/matrix_transform.hpp>
 
 #include <memory>
-#include <unordered_map>
 
 namespace lve {
 
@@ -17,45 +16,49 @@ struct TransformComponent {
     // Matrix corrsponds to Translate * Ry * Rx * Rz * Scale
     // Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
     // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
-	glm::mat4 mat4();
-	glm::mat3 normalMatrix();
+	/* 世界矩阵与世界法线矩阵，由LveScene::UpdateTransforms刷新
+	 * 没有父节点时等于局部矩阵，否则为父节点世界矩阵 * 局部矩阵
+	 */
+	const glm::mat4& mat4() const { return m_worldMatrix; }
+	const glm::mat3& normalMatrix() const { return m_normalMatrix; }
+
+	/* translation/rotation/scale与上次计算时的快照不同才重新计算局部矩阵，返回是否重算
+	 * 只有平移变化时直接改写最后一列，不做三角函数计算
+	 */
+	bool UpdateLocalMatrices();
+	/*rotation或scale变化，需要三角函数重算；LveScene据此收集对象交给批量计算*/
+	bool NeedsRotationUpdate() const {
+		return !m_cacheValid || rotation != m_cachedRotation || scale != m_cachedScale;
+	}
+	/*写入外部（批量）计算好的局部矩阵，下一次UpdateLocalMatrices返回true*/
+	void SetLocalMatrices(const glm::mat4& localMatrix, const glm::mat3& localNormalMatrix);
+	/*parent为空表示根节点；parent的世界矩阵必须已经是最新的*/
+	void UpdateWorldMatrices(const TransformComponent* parent);
+
+private:
+	glm::vec3 m_cachedTranslation{};
+	glm::vec3 m_cachedScale{};
+	glm::vec3 m_cachedRotation{};
+	glm::mat4 m_localMatrix{ 1.f };
+	glm::mat3 m_localNormalMatrix{ 1.f };
+	glm::mat4 m_worldMatrix{ 1.f };
+	glm::mat3 m_normalMatrix{ 1.f };
+	bool m_cacheValid = false;
+	bool m_localUpdatedExternally = false;
 };
 
 struct PointLightComponent {
 	float lightIntensity = 1.0f;	// 光照强度
-};
-
-class LveObject {
-public:
-	using id_t = unsigned int;
-	using Map = std::unordered_map<id_t, LveObject>;
-
-	static LveObject CreateObject() {
-		static id_t current_id = 0;
-		return LveObject{ current_id++ };
-	}
+	glm::vec3 color{ 1.f, 1.f, 1.f };
+	float range = 0.f;	// 影响半径，超出后光照衰减为0；为0时按强度自动计算
 
-	LveObject(const LveObject&) = delete;
-	LveObject& operator=(const LveObject&) = delete;
-	LveObject(LveObject&&) = default;
-	LveObject& operator=(LveObject&&) = default;
-
-	id_t getId() const { return id; }
-
-	static LveObject MakePointLight(
-		float intensity = 10.f,
-		float radius = 0.1f,
-		glm::vec3 color = glm::vec3(1.f));
-
-	glm::vec3 color{1.f, 1.f, 1.f};
-	TransformComponent transform{};
-	std::unique_ptr<PointLightComponent> pointLight = nullptr;	// 为空则表示不使用点光源
-	std::shared_ptr<LveModel> model{};	// 若为点光源，则不设置模型指针
-
-private:
-	LveObject(id_t obj_id) : id{ obj_id } {}
+	/*分簇光照使用的影响半径*/
+	float GetRange() const;
+};
 
-	id_t id;
+/*点光源实体不添加该组件*/
+struct ModelComponent {
+	std::shared_ptr<LveModel> model{};
 };
 
 }
\ No newline at end of file
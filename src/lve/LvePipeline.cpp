@@ -1,13 +1,88 @@
 ﻿#include "LvePipeline.h"
 #include "LveModel.h"
+#include "LveShaderCompiler.h"
+#include "LveUtils.h"
 
-#include <fstream>
+#include <algorithm>
 #include <iostream>
-#include <filesystem>
 #include <cassert>
+#include <cstring>
 
 namespace lve {
 
+LveSpecialization& LveSpecialization::SetBool(uint32_t constantId, bool value)
+{
+	SetRaw(constantId, value ? VK_TRUE : VK_FALSE);
+	return *this;
+}
+
+LveSpecialization& LveSpecialization::SetInt(uint32_t constantId, int32_t value)
+{
+	SetRaw(constantId, static_cast<uint32_t>(value));
+	return *this;
+}
+
+LveSpecialization& LveSpecialization::SetUint(uint32_t constantId, uint32_t value)
+{
+	SetRaw(constantId, value);
+	return *this;
+}
+
+LveSpecialization& LveSpecialization::SetFloat(uint32_t constantId, float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	SetRaw(constantId, bits);
+	return *this;
+}
+
+/*每个常量占4字节，条目按constantID有序插入，data与entries一一对应*/
+void LveSpecialization::SetRaw(uint32_t constantId, uint32_t bits)
+{
+	auto it = std::lower_bound(m_entries.begin(), m_entries.end(), constantId,
+		[](const VkSpecializationMapEntry& entry, uint32_t id) { return entry.constantID < id; });
+	size_t index = it - m_entries.begin();
+	if (it != m_entries.end() && it->constantID == constantId) {
+		m_data[index] = bits;
+	}
+	else {
+		m_entries.insert(it, VkSpecializationMapEntry{ constantId, 0, sizeof(uint32_t) });
+		m_data.insert(m_data.begin() + index, bits);
+		for (size_t i = 0; i < m_entries.size(); i++) {
+			m_entries[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+		}
+	}
+
+	m_key = 0;
+	if (!m_entries.empty()) {
+		m_key = HashBytes(m_entries.data(), m_entries.size() * sizeof(VkSpecializationMapEntry));
+		m_key = HashBytes(m_data.data(), m_data.size() * sizeof(uint32_t), m_key);
+	}
+}
+
+VkSpecializationInfo LveSpecialization::GetInfo() const
+{
+	VkSpecializationInfo info{};
+	info.mapEntryCount = static_cast<uint32_t>(m_entries.size());
+	info.pMapEntries = m_entries.data();
+	info.dataSize = m_data.size() * sizeof(uint32_t);
+	info.pData = m_data.data();
+	return info;
+}
+
+bool LveSpecialization::operator==(const LveSpecialization& other) const
+{
+	if (m_key != other.m_key || m_entries.size() != other.m_entries.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < m_entries.size(); i++) {
+		if (m_entries[i].constantID != other.m_entries[i].constantID) {
+			return false;
+		}
+	}
+	return m_data == other.m_data;
+}
+
 LvePipeline::LvePipeline(LveDevice& device, const std::string& vertFilepath, 
 	const std::string& fragFilepath, const PipelineConfigInfo& configInfo)
 	: m_lveDevice{device}
@@ -22,43 +97,59 @@ LvePipeline::~LvePipeline()
 {
 	vkDestroyShaderModule(m_lveDevice.device(), m_vertShaderModule, nullptr);
 	vkDestroyShaderModule(m_lveDevice.device(), m_fragShaderModule, nullptr);
-	vkDestroyPipeline(m_lveDevice.device(), m_graphicsPipeline, nullptr);
-}
-
-/*读取文件*/
-std::vector<char> LvePipeline::ReadFile(const std::string& filepath)
-{
-	std::cout << "Enter function: " << __FUNCTION__ << "\n";
-	std::cout << "CWD: " << std::filesystem::current_path() << std::endl;
-	std::cout << "filepath: " << filepath << std::endl;
-	std::ifstream file(filepath, std::ios::ate | std::ios::binary);
-
-	if (!file.is_open()) {
-        throw std::runtime_error("failed to open file: " + filepath);
+	for (const Variant& variant : m_variants) {
+		vkDestroyPipeline(m_lveDevice.device(), variant.pipeline, nullptr);
 	}
-
-	size_t fileSize = static_cast<size_t>(file.tellg());
-	std::vector<char> buffer(fileSize);
-
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
-	file.close();
-
-	return buffer;
+	vkDestroyPipeline(m_lveDevice.device(), m_graphicsPipeline, nullptr);
 }
 
 /*创建图形管线*/
 void LvePipeline::CreateGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo)
 {
 	assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
-	assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline: no renderPass provided in configInfo");
+	assert((configInfo.renderPass != VK_NULL_HANDLE || configInfo.colorAttachmentFormat != VK_FORMAT_UNDEFINED) &&
+		"Cannot create graphics pipeline: no renderPass or attachment formats provided in configInfo");
 
-	auto vertCode = ReadFile(vertFilepath);
-	auto fragCode = ReadFile(fragFilepath);
+	auto vertCode = LveShaderCompiler::Shared().Load(vertFilepath, configInfo.shaderDefines);
+	auto fragCode = LveShaderCompiler::Shared().Load(fragFilepath, configInfo.shaderDefines);
 
 	CreateShaderModule(vertCode, &m_vertShaderModule);
 	CreateShaderModule(fragCode, &m_fragShaderModule);
 
+	/*保留配置用于之后按需创建变体，混合附件数组由调用者持有，需要深拷贝*/
+	m_configInfo = configInfo;
+	const VkPipelineColorBlendStateCreateInfo& blendInfo = configInfo.colorBlendInfo;
+	m_blendAttachments.assign(blendInfo.pAttachments, blendInfo.pAttachments + blendInfo.attachmentCount);
+	m_configInfo.colorBlendInfo.pAttachments = m_blendAttachments.data();
+	/*扩展动态状态：这些状态不再区分管线，由Bind按配置设置*/
+	if (m_lveDevice.extendedDynamicStateEnabled()) {
+		for (VkDynamicState state : { VK_DYNAMIC_STATE_CULL_MODE_EXT, VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+				VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT, VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+				VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT }) {
+			auto& states = m_configInfo.dynamicStateEnables;
+			if (std::find(states.begin(), states.end(), state) == states.end()) {
+				states.push_back(state);
+			}
+		}
+	}
+	m_configInfo.dynamicStateInfo.pDynamicStates = m_configInfo.dynamicStateEnables.data();
+	m_configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(m_configInfo.dynamicStateEnables.size());
+
+	m_graphicsPipeline = CreateVariantPipeline(m_configInfo.specialization);
+	for (const LveSpecialization& variant : m_configInfo.variants) {
+		if (!(variant == m_configInfo.specialization)) {
+			m_variants.push_back({ variant, VK_NULL_HANDLE });
+		}
+	}
+}
+
+/*用已有的着色器模块与m_configInfo创建管线，特化常量为specialization；基础管线创建后其余变体从它派生*/
+VkPipeline LvePipeline::CreateVariantPipeline(const LveSpecialization& specialization)
+{
+	const PipelineConfigInfo& configInfo = m_configInfo;
+	VkSpecializationInfo specializationInfo = specialization.GetInfo();
+	const VkSpecializationInfo* pSpecializationInfo = specialization.IsEmpty() ? nullptr : &specializationInfo;
+
 	/*两个着色器阶段：0 = 顶点， 1 = 片段*/
 	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
 	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -67,7 +158,7 @@ void LvePipeline::CreateGraphicsPipeline(const std::string& vertFilepath, const
 	shaderStages[0].pName = "main";	// SPIR-V 的 entry point 名称（GLSL 默认 main，若编译时改过，这里也要一致）
 	shaderStages[0].flags = 0;
     shaderStages[0].pNext = nullptr;
-	shaderStages[0].pSpecializationInfo = nullptr;
+	shaderStages[0].pSpecializationInfo = pSpecializationInfo;
 
 	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -75,7 +166,7 @@ void LvePipeline::CreateGraphicsPipeline(const std::string& vertFilepath, const
 	shaderStages[1].pName = "main";	// SPIR-V 的 entry point 名称（GLSL 默认 main，若编译时改过，这里也要一致）
 	shaderStages[1].flags = 0;
 	shaderStages[1].pNext = nullptr;
-	shaderStages[1].pSpecializationInfo = nullptr;
+	shaderStages[1].pSpecializationInfo = pSpecializationInfo;
 
 	/*顶点输入*/
 	auto& bindingDescription = configInfo.bindingDescriptions;
@@ -109,14 +200,35 @@ void LvePipeline::CreateGraphicsPipeline(const std::string& vertFilepath, const
 	pipelineInfo.renderPass = configInfo.renderPass;
 	pipelineInfo.subpass = configInfo.subpass;
 
-	/*不做派生管线*/
+	/*动态渲染：没有RenderPass，只声明附件格式；含模板分量的深度格式同时作为模板附件*/
+	VkPipelineRenderingCreateInfoKHR renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &configInfo.colorAttachmentFormat;
+	renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+	if (configInfo.depthAttachmentFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || configInfo.depthAttachmentFormat == VK_FORMAT_D24_UNORM_S8_UINT) {
+		renderingInfo.stencilAttachmentFormat = configInfo.depthAttachmentFormat;
+	}
+	if (configInfo.renderPass == VK_NULL_HANDLE) {
+		pipelineInfo.pNext = &renderingInfo;
+	}
+
+	/*变体只有特化常量不同，声明为基础管线的派生管线*/
 	pipelineInfo.basePipelineIndex = -1;
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	if (m_graphicsPipeline == VK_NULL_HANDLE) {
+		pipelineInfo.flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	}
+	else {
+		pipelineInfo.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+		pipelineInfo.basePipelineHandle = m_graphicsPipeline;
+	}
 
-	if (vkCreateGraphicsPipelines(m_lveDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS) {
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(m_lveDevice.device(), m_lveDevice.pipelineCache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline");
 	}
-
+	return pipeline;
 }
 
 void LvePipeline::CreateShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
@@ -132,9 +244,82 @@ void LvePipeline::CreateShaderModule(const std::vector<char>& code, VkShaderModu
 
 }
 
-void LvePipeline::Bind(VkCommandBuffer commandBuffer)
+void LvePipeline::Bind(VkCommandBuffer commandBuffer, const LveSpecialization* variant)
+{
+	VkPipeline pipeline = variant ? GetVariant(*variant) : m_graphicsPipeline;
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	if (m_lveDevice.extendedDynamicStateEnabled()) {
+		SetExtendedDynamicState(commandBuffer);
+	}
+}
+
+/*动态状态不随管线绑定生效，每次绑定都按本管线的配置重新设置*/
+void LvePipeline::SetExtendedDynamicState(VkCommandBuffer commandBuffer)
+{
+	const ExtendedDynamicStateCommands& commands = m_lveDevice.extendedDynamicState();
+	commands.setCullMode(commandBuffer, m_configInfo.rasterizationInfo.cullMode);
+	commands.setFrontFace(commandBuffer, m_configInfo.rasterizationInfo.frontFace);
+	commands.setPrimitiveTopology(commandBuffer, m_configInfo.inputAssemblyInfo.topology);
+	commands.setDepthTestEnable(commandBuffer, m_configInfo.depthStencilInfo.depthTestEnable);
+	commands.setDepthWriteEnable(commandBuffer, m_configInfo.depthStencilInfo.depthWriteEnable);
+	commands.setDepthCompareOp(commandBuffer, m_configInfo.depthStencilInfo.depthCompareOp);
+}
+
+VkPipeline LvePipeline::GetVariant(const LveSpecialization& variant) const
+{
+	for (const Variant& existing : m_variants) {
+		if (existing.pipeline != VK_NULL_HANDLE && existing.specialization == variant) {
+			return existing.pipeline;
+		}
+	}
+	return m_graphicsPipeline;
+}
+
+void LvePipeline::CreateVariant(size_t index)
+{
+	assert(index < m_variants.size() && m_variants[index].pipeline == VK_NULL_HANDLE && "variant already created");
+	m_variants[index].pipeline = CreateVariantPipeline(m_variants[index].specialization);
+}
+
+LveComputePipeline::LveComputePipeline(LveDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+	: m_lveDevice{ device }
+{
+	assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+	auto compCode = LveShaderCompiler::Shared().Load(compFilepath);
+
+	VkShaderModuleCreateInfo moduleInfo{};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = compCode.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t*>(compCode.data());
+	if (vkCreateShaderModule(m_lveDevice.device(), &moduleInfo, nullptr, &m_compShaderModule) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create shader module");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = m_compShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.basePipelineIndex = -1;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+	if (vkCreateComputePipelines(m_lveDevice.device(), m_lveDevice.pipelineCache(), 1, &pipelineInfo, nullptr, &m_computePipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create compute pipeline");
+	}
+}
+
+LveComputePipeline::~LveComputePipeline()
+{
+	vkDestroyShaderModule(m_lveDevice.device(), m_compShaderModule, nullptr);
+	vkDestroyPipeline(m_lveDevice.device(), m_computePipeline, nullptr);
+}
+
+void LveComputePipeline::Bind(VkCommandBuffer commandBuffer)
 {
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
 }
 
 void LvePipeline::DefaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
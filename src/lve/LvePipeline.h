@@ -7,6 +7,31 @@
 
 namespace lve {
 
+/* 特化常量：constant_id -> 32位值，创建管线时同时写入顶点与片段阶段
+ * 着色器中不存在的constant_id会被驱动忽略
+ */
+class LveSpecialization {
+public:
+	LveSpecialization& SetBool(uint32_t constantId, bool value);	// 写入VkBool32
+	LveSpecialization& SetInt(uint32_t constantId, int32_t value);
+	LveSpecialization& SetUint(uint32_t constantId, uint32_t value);
+	LveSpecialization& SetFloat(uint32_t constantId, float value);
+
+	/*返回的结构体指向本对象内部数组，使用期间不能修改本对象*/
+	VkSpecializationInfo GetInfo() const;
+	uint64_t GetKey() const { return m_key; }
+	bool IsEmpty() const { return m_entries.empty(); }
+
+	bool operator==(const LveSpecialization& other) const;
+
+private:
+	void SetRaw(uint32_t constantId, uint32_t bits);
+
+	std::vector<VkSpecializationMapEntry> m_entries;	// 按constantID升序，相同的常量组合得到相同的键
+	std::vector<uint32_t> m_data;
+	uint64_t m_key = 0;
+};
+
 struct PipelineConfigInfo {
 	PipelineConfigInfo() = default;
 	PipelineConfigInfo(const PipelineConfigInfo&) = delete;
@@ -27,10 +52,17 @@ struct PipelineConfigInfo {
 	VkPipelineLayout pipelineLayout = nullptr;
 	VkRenderPass renderPass = nullptr;
 	uint32_t subpass = 0;
+	/*renderPass为空时使用动态渲染，管线只依赖附件格式*/
+	VkFormat colorAttachmentFormat = VK_FORMAT_UNDEFINED;
+	VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+	std::vector<std::string> shaderDefines;	// 编译GLSL时的宏定义，"NAME"或"NAME=VALUE"
+	LveSpecialization specialization;	// 基础管线的特化常量
+	std::vector<LveSpecialization> variants;	// 与基础管线一起预先编译的其他组合，运行时不再创建管线
 };
 
 class LvePipeline {
 public:
+	/*着色器路径可以是GLSL源码（运行时编译并缓存）或预编译的.spv*/
 	LvePipeline(LveDevice& device, const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo);
 
 	~LvePipeline();
@@ -38,23 +70,59 @@ public:
 	LvePipeline(const LvePipeline&) = delete;
     LvePipeline& operator=(const LvePipeline&) = delete;
 
-	void Bind(VkCommandBuffer commandBuffer);
+	/* variant为空时绑定基础管线，否则绑定对应特化常量的变体
+	 * 设备支持扩展动态状态时，剔除、朝向、拓扑与深度状态不烘焙进管线，绑定时按配置设置，之后可以在绘制前覆盖
+	 */
+	void Bind(VkCommandBuffer commandBuffer, const LveSpecialization* variant = nullptr);
+	/*返回特化常量为variant的预编译管线；未登记的组合返回基础管线*/
+	VkPipeline GetVariant(const LveSpecialization& variant) const;
+
+	/* 构造只创建基础管线，configInfo.variants中的组合由CreateVariant逐个创建
+	 * LvePipelineQueue在线程池上并行调用，不同的index可以并发
+	 */
+	size_t GetVariantCount() const { return m_variants.size(); }
+	void CreateVariant(size_t index);
 
 	/*创建默认管道配置的公共函数*/
 	static void DefaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 	static void EnableAlphaBlending(PipelineConfigInfo& configInfo);
 
 private:
-	static std::vector<char> ReadFile(const std::string& filepath);
-
 	void CreateGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo);
+	VkPipeline CreateVariantPipeline(const LveSpecialization& specialization);
 
 	void CreateShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+	void SetExtendedDynamicState(VkCommandBuffer commandBuffer);
+
+	struct Variant {
+		LveSpecialization specialization;
+		VkPipeline pipeline;
+	};
 
 	LveDevice& m_lveDevice;
-	VkPipeline m_graphicsPipeline;		// Vulkan管道对象的句柄
+	VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;	// Vulkan管道对象的句柄，同时是各变体的父管线
+	PipelineConfigInfo m_configInfo;	// 创建变体时使用，混合附件复制到m_blendAttachments
+	std::vector<VkPipelineColorBlendAttachmentState> m_blendAttachments;
+	std::vector<Variant> m_variants;	// 与configInfo.variants一一对应，数量很少，线性查找
 	VkShaderModule m_vertShaderModule;	// Vulkan着色器模块的句柄
 	VkShaderModule m_fragShaderModule;
 };
 
+/*计算管线：单个计算着色器 + 调用者提供的管线布局*/
+class LveComputePipeline {
+public:
+	LveComputePipeline(LveDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+	~LveComputePipeline();
+
+	LveComputePipeline(const LveComputePipeline&) = delete;
+	LveComputePipeline& operator=(const LveComputePipeline&) = delete;
+
+	void Bind(VkCommandBuffer commandBuffer);
+
+private:
+	LveDevice& m_lveDevice;
+	VkPipeline m_computePipeline;
+	VkShaderModule m_compShaderModule;
+};
+
 }
\ No newline at end of file
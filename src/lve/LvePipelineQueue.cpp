@@ -0,0 +1,245 @@
+﻿#include "LvePipelineQueue.h"
+
+#include "LveLayoutCache.h"
+#include "LveSwapChain.h"
+#include "LveThreadPool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+namespace lve {
+
+LvePipelineQueue::LvePipelineQueue(LveDevice& device)
+	: m_lveDevice{ device }
+{
+}
+
+LvePipelineQueue::~LvePipelineQueue()
+{
+	/*后台编译引用了任务，先等它结束*/
+	if (m_reload.valid()) {
+		m_reload.wait();
+	}
+}
+
+void LvePipelineQueue::SetAttachmentFormats(VkFormat colorFormat, VkFormat depthFormat)
+{
+	m_colorFormat = colorFormat;
+	m_depthFormat = depthFormat;
+}
+
+void LvePipelineQueue::Enqueue(const std::string& vertFilepath, const std::string& fragFilepath,
+	const PipelineConfigInfo& configInfo, std::unique_ptr<LvePipeline>& target)
+{
+	auto job = std::make_unique<GraphicsJob>();
+	job->vertFilepath = vertFilepath;
+	job->fragFilepath = fragFilepath;
+	job->configInfo = configInfo;
+	job->target = &target;
+	if (configInfo.renderPass == VK_NULL_HANDLE) {
+		job->configInfo.colorAttachmentFormat = m_colorFormat;
+		job->configInfo.depthAttachmentFormat = m_depthFormat;
+	}
+
+	/*调用者的混合附件数组可能在栈上，拷贝一份并重新指向*/
+	const VkPipelineColorBlendStateCreateInfo& blendInfo = configInfo.colorBlendInfo;
+	job->blendAttachments.assign(blendInfo.pAttachments, blendInfo.pAttachments + blendInfo.attachmentCount);
+	job->configInfo.colorBlendInfo.pAttachments = job->blendAttachments.data();
+	job->configInfo.dynamicStateInfo.pDynamicStates = job->configInfo.dynamicStateEnables.data();
+	job->configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(job->configInfo.dynamicStateEnables.size());
+
+	m_graphicsJobs.push_back(std::move(job));
+}
+
+void LvePipelineQueue::EnqueueCompute(const std::string& compFilepath, VkPipelineLayout pipelineLayout,
+	std::unique_ptr<LveComputePipeline>& target)
+{
+	auto job = std::make_unique<ComputeJob>();
+	job->compFilepath = compFilepath;
+	job->pipelineLayout = pipelineLayout;
+	job->target = &target;
+	m_computeJobs.push_back(std::move(job));
+}
+
+size_t LvePipelineQueue::GetPendingCount() const
+{
+	size_t count = 0;
+	for (const auto& job : m_graphicsJobs) {
+		count += job->compiled ? 0 : 1 + job->configInfo.variants.size();
+	}
+	for (const auto& job : m_computeJobs) {
+		count += job->compiled ? 0 : 1;
+	}
+	return count;
+}
+
+void LvePipelineQueue::Compile()
+{
+	std::vector<GraphicsJob*> graphicsJobs;
+	std::vector<ComputeJob*> computeJobs;
+	for (auto& job : m_graphicsJobs) {
+		if (!job->compiled) {
+			graphicsJobs.push_back(job.get());
+		}
+	}
+	for (auto& job : m_computeJobs) {
+		if (!job->compiled) {
+			computeJobs.push_back(job.get());
+		}
+	}
+
+	Build(graphicsJobs, computeJobs);
+
+	/*全部成功后才写回，失败时各系统保持未创建状态*/
+	for (GraphicsJob* job : graphicsJobs) {
+		*job->target = std::move(job->result);
+		job->compiled = true;
+		Watch(job->vertFilepath);
+		Watch(job->fragFilepath);
+	}
+	for (ComputeJob* job : computeJobs) {
+		*job->target = std::move(job->result);
+		job->compiled = true;
+		Watch(job->compFilepath);
+	}
+}
+
+void LvePipelineQueue::Build(const std::vector<GraphicsJob*>& graphicsJobs, const std::vector<ComputeJob*>& computeJobs,
+	bool validateLayouts)
+{
+	const size_t graphicsCount = graphicsJobs.size();
+	const size_t jobCount = graphicsCount + computeJobs.size();
+
+	/*每个管线一个分块，编译时间差异大，由空闲线程领取剩余任务*/
+	LveThreadPool::Shared().ParallelFor(jobCount, 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			if (i < graphicsCount) {
+				GraphicsJob& job = *graphicsJobs[i];
+				if (validateLayouts) {
+					m_lveDevice.layoutCache().Validate(job.configInfo.pipelineLayout, { job.vertFilepath, job.fragFilepath });
+				}
+				job.result = std::make_unique<LvePipeline>(m_lveDevice, job.vertFilepath, job.fragFilepath, job.configInfo);
+			}
+			else {
+				ComputeJob& job = *computeJobs[i - graphicsCount];
+				if (validateLayouts) {
+					m_lveDevice.layoutCache().Validate(job.pipelineLayout, { job.compFilepath });
+				}
+				job.result = std::make_unique<LveComputePipeline>(m_lveDevice, job.compFilepath, job.pipelineLayout);
+			}
+		}
+	});
+
+	/*特化常量变体从各自的基础管线派生，基础管线全部创建后再并行创建*/
+	std::vector<std::pair<LvePipeline*, size_t>> variants;
+	for (GraphicsJob* job : graphicsJobs) {
+		for (size_t v = 0; v < job->result->GetVariantCount(); v++) {
+			variants.emplace_back(job->result.get(), v);
+		}
+	}
+	LveThreadPool::Shared().ParallelFor(variants.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			variants[i].first->CreateVariant(variants[i].second);
+		}
+	});
+}
+
+void LvePipelineQueue::Watch(const std::string& path)
+{
+	std::error_code ec;
+	auto writeTime = std::filesystem::last_write_time(path, ec);
+	if (!ec) {
+		m_watchedFiles[path] = writeTime;
+	}
+}
+
+void LvePipelineQueue::ReloadChangedShaders(VkRenderPass renderPass)
+{
+	m_frameCounter++;
+	while (!m_retired.empty() && m_frameCounter - m_retired.front().frame >= LveSwapChain::MAX_FRAMES_IN_FLIGHT) {
+		m_retired.pop_front();
+	}
+
+	/*上一批还在编译，不阻塞渲染*/
+	if (m_reload.valid()) {
+		if (m_reload.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			return;
+		}
+		ApplyReload();
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	if (now - m_lastWatchCheck < WATCH_INTERVAL) {
+		return;
+	}
+	m_lastWatchCheck = now;
+
+	/*记录新的修改时间，编译失败也不会反复重试，等下一次保存*/
+	std::vector<std::string> changedFiles;
+	for (auto& [path, writeTime] : m_watchedFiles) {
+		std::error_code ec;
+		auto current = std::filesystem::last_write_time(path, ec);
+		if (!ec && current != writeTime) {
+			writeTime = current;
+			changedFiles.push_back(path);
+		}
+	}
+	if (changedFiles.empty()) {
+		return;
+	}
+
+	auto isChanged = [&changedFiles](const std::string& path) {
+		return std::find(changedFiles.begin(), changedFiles.end(), path) != changedFiles.end();
+	};
+	for (auto& job : m_graphicsJobs) {
+		if (job->compiled && (isChanged(job->vertFilepath) || isChanged(job->fragFilepath))) {
+			job->configInfo.renderPass = renderPass;
+			m_reloadGraphics.push_back(job.get());
+		}
+	}
+	for (auto& job : m_computeJobs) {
+		if (job->compiled && isChanged(job->compFilepath)) {
+			m_reloadCompute.push_back(job.get());
+		}
+	}
+	for (const std::string& path : changedFiles) {
+		std::cout << "shader changed: " << path << "\n";
+	}
+
+	m_reload = LveThreadPool::Shared().Submit([this]() {
+		Build(m_reloadGraphics, m_reloadCompute, true);
+	});
+}
+
+/*在渲染线程上把新管线换进各系统，旧管线等在途帧完成后销毁*/
+void LvePipelineQueue::ApplyReload()
+{
+	try {
+		m_reload.get();
+		for (GraphicsJob* job : m_reloadGraphics) {
+			m_retired.push_back({ m_frameCounter, std::move(*job->target), nullptr });
+			*job->target = std::move(job->result);
+		}
+		for (ComputeJob* job : m_reloadCompute) {
+			m_retired.push_back({ m_frameCounter, nullptr, std::move(*job->target) });
+			*job->target = std::move(job->result);
+		}
+		std::cout << "reloaded " << m_reloadGraphics.size() + m_reloadCompute.size() << " pipelines\n";
+	}
+	catch (const std::exception& e) {
+		/*部分管线可能已经创建，一起丢弃，保持所有系统使用同一版本的着色器*/
+		std::cerr << "shader reload failed: " << e.what() << "\n";
+		for (GraphicsJob* job : m_reloadGraphics) {
+			job->result.reset();
+		}
+		for (ComputeJob* job : m_reloadCompute) {
+			job->result.reset();
+		}
+	}
+	m_reloadGraphics.clear();
+	m_reloadCompute.clear();
+}
+
+}  // namespace lve
@@ -0,0 +1,105 @@
+﻿#pragma once
+
+#include "LvePipeline.h"
+
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+/* 管线编译队列
+ * 各系统在构造时登记管线（配置 + 着色器路径 + 接收结果的unique_ptr），不立即创建
+ * Compile在共享线程池上并行创建全部管线，完成后在调用线程写回各系统
+ * 所有管线共用设备的VkPipelineCache（未设置EXTERNALLY_SYNCHRONIZED，驱动内部同步）
+ * 登记在Compile之后保留，用于着色器热重载；队列需要与登记它的系统活得一样久
+ */
+class LvePipelineQueue {
+public:
+	explicit LvePipelineQueue(LveDevice& device);
+	~LvePipelineQueue();
+
+	LvePipelineQueue(const LvePipelineQueue&) = delete;
+	LvePipelineQueue& operator=(const LvePipelineQueue&) = delete;
+
+	/*使用动态渲染时在登记前设置：renderPass为空的管线按这些附件格式创建*/
+	void SetAttachmentFormats(VkFormat colorFormat, VkFormat depthFormat);
+
+	/*configInfo会被深拷贝（包括混合附件与动态状态数组），调用后即可释放*/
+	void Enqueue(const std::string& vertFilepath, const std::string& fragFilepath,
+		const PipelineConfigInfo& configInfo, std::unique_ptr<LvePipeline>& target);
+	void EnqueueCompute(const std::string& compFilepath, VkPipelineLayout pipelineLayout,
+		std::unique_ptr<LveComputePipeline>& target);
+
+	/*并行创建所有尚未创建的管线；任一管线创建失败时在调用线程抛出*/
+	void Compile();
+
+	/*尚未创建的管线数量，包括特化常量变体*/
+	size_t GetPendingCount() const;
+
+	/* 每帧在BeginFrame之后调用（本帧槽位的fence已等待）
+	 * 每隔WATCH_INTERVAL检查一次已登记着色器的修改时间，受影响的管线在后台线程重新编译，
+	 * 编译完成后的下一次调用中替换到各系统，旧管线在MAX_FRAMES_IN_FLIGHT帧之后销毁
+	 * renderPass为当前交换链的RenderPass（交换链重建后登记时的RenderPass已被销毁），动态渲染时为空
+	 * 编译失败或绑定/push常量与管线布局不再一致时打印日志并保留旧管线，直到文件再次修改
+	 */
+	void ReloadChangedShaders(VkRenderPass renderPass);
+
+private:
+	static constexpr std::chrono::milliseconds WATCH_INTERVAL{ 500 };
+
+	struct GraphicsJob {
+		std::string vertFilepath;
+		std::string fragFilepath;
+		PipelineConfigInfo configInfo;
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;	// configInfo.colorBlendInfo.pAttachments指向这里
+		std::unique_ptr<LvePipeline>* target = nullptr;
+		std::unique_ptr<LvePipeline> result;
+		bool compiled = false;
+	};
+
+	struct ComputeJob {
+		std::string compFilepath;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::unique_ptr<LveComputePipeline>* target = nullptr;
+		std::unique_ptr<LveComputePipeline> result;
+		bool compiled = false;
+	};
+
+	/*被热重载替换下来的管线，可能还在在途帧的命令缓冲中*/
+	struct RetiredPipeline {
+		uint64_t frame = 0;
+		std::unique_ptr<LvePipeline> graphics;
+		std::unique_ptr<LveComputePipeline> compute;
+	};
+
+	/* 在线程池上创建jobs的result，不写回target
+	 * validateLayouts为true时（热重载）先校验修改后的着色器与已有管线布局一致，不一致时抛出
+	 */
+	void Build(const std::vector<GraphicsJob*>& graphicsJobs, const std::vector<ComputeJob*>& computeJobs,
+		bool validateLayouts = false);
+	void Watch(const std::string& path);
+	void ApplyReload();
+
+	LveDevice& m_lveDevice;
+	VkFormat m_colorFormat = VK_FORMAT_UNDEFINED;
+	VkFormat m_depthFormat = VK_FORMAT_UNDEFINED;
+	/*任务里有指向自身的指针，用unique_ptr保持地址不变*/
+	std::vector<std::unique_ptr<GraphicsJob>> m_graphicsJobs;
+	std::vector<std::unique_ptr<ComputeJob>> m_computeJobs;
+
+	std::unordered_map<std::string, std::filesystem::file_time_type> m_watchedFiles;
+	std::chrono::steady_clock::time_point m_lastWatchCheck{};
+	std::vector<GraphicsJob*> m_reloadGraphics;
+	std::vector<ComputeJob*> m_reloadCompute;
+	std::future<void> m_reload;
+	std::deque<RetiredPipeline> m_retired;
+	uint64_t m_frameCounter = 0;
+};
+
+}  // namespace lve
@@ -10,8 +10,8 @@
 
 namespace lve {
 
-LveRenderer::LveRenderer(LveWindow& window, LveDevice& device)
-    : m_lveWindow(window), m_lveDevice(device)
+LveRenderer::LveRenderer(LveWindow& window, LveDevice& device, bool deferred)
+    : m_lveWindow(window), m_lveDevice(device), m_deferred(deferred)
 {
     RecreateSwapChain();
     CreateCommandBuffers(); // 为每个SwapChain图像创建并录制一份命令缓冲
@@ -33,21 +33,22 @@ void LveRenderer::RecreateSwapChain()
     }
 
     /*等待GPU空闲，再重建SwapChain*/
-    vkDeviceWaitIdle(m_lveDevice.device());
+    m_lveDevice.waitIdle();
 
     //lveSwapChain.reset();
     if (m_lveSwapChain == nullptr) {
-        m_lveSwapChain = std::make_unique<LveSwapChain>(m_lveDevice, extent);
+        m_lveSwapChain = std::make_unique<LveSwapChain>(m_lveDevice, extent, m_deferred);
     }
     else {
         std::shared_ptr<LveSwapChain> oldSwapChain = std::move(m_lveSwapChain);
-        m_lveSwapChain = std::make_unique<LveSwapChain>(m_lveDevice, extent, oldSwapChain);
+        m_lveSwapChain = std::make_unique<LveSwapChain>(m_lveDevice, extent, oldSwapChain, m_deferred);
 
         if (!oldSwapChain->CompareSwapFormats(*m_lveSwapChain.get())) {
             // it would probably be better to set up a callback function to notifing the app that a new imcompatible render pass has been created
             throw std::runtime_error("Swap chain image format has changed!");
         }
     }
+    m_swapChainGeneration++;
 
     
 }
@@ -122,6 +123,9 @@ void LveRenderer::EndFrame()
         throw std::runtime_error("failed to record command buffer!");
     }
 
+    /*先提交本帧之前录制的上传批次，保证绘制时数据已在同一队列上排在前面*/
+    m_lveDevice.flushUploads();
+
     auto result = m_lveSwapChain->SubmitCommandBuffers(&commandBuffer, &m_currentImageIndex);
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_lveWindow.WasWindowResized()) {
         m_lveWindow.ResetWindowResizedFlag();
@@ -142,6 +146,42 @@ void LveRenderer::BeginSwapChainRenderPass(VkCommandBuffer commandBuffer)
         commandBuffer == GetCurrentCommandBuffer() && 
         "Can't begin render pass on command buffer from a different frame");
 
+    if (m_lveSwapChain->UsesDynamicRendering()) {
+        BeginDynamicRendering(commandBuffer);
+    }
+    else {
+        BeginRenderPass(commandBuffer);
+    }
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(m_lveSwapChain->GetSwapChainExtent().width);
+    viewport.height = static_cast<float>(m_lveSwapChain->GetSwapChainExtent().height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{ {0, 0}, m_lveSwapChain->GetSwapChainExtent() };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void LveRenderer::EndSwapChainRenderPass(VkCommandBuffer commandBuffer)
+{
+    assert(m_isFrameStarted && "Can't call endSwapChainRenderPass if frame is not in progress");
+    assert(
+        commandBuffer == GetCurrentCommandBuffer() &&
+        "Can't begin render pass on command buffer from a different frame");
+
+    if (m_lveSwapChain->UsesDynamicRendering()) {
+        EndDynamicRendering(commandBuffer);
+    }
+    else {
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+void LveRenderer::BeginRenderPass(VkCommandBuffer commandBuffer)
+{
     /*录制渲染通道*/
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -151,34 +191,107 @@ void LveRenderer::BeginSwapChainRenderPass(VkCommandBuffer commandBuffer)
     renderPassInfo.renderArea.offset = { 0, 0 };
     renderPassInfo.renderArea.extent = m_lveSwapChain->GetSwapChainExtent();
 
-    std::array<VkClearValue, 2> clearValues{};
+    /*延迟模式多出的两个G-buffer附件清零*/
+    std::array<VkClearValue, 4> clearValues{};
     clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
     clearValues[1].depthStencil = { 1.0f, 0 };
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    clearValues[2].color = { 0.f, 0.f, 0.f, 0.f };
+    clearValues[3].color = { 0.f, 0.f, 0.f, 0.f };
+    renderPassInfo.clearValueCount = m_deferred ? 4 : 2;
     renderPassInfo.pClearValues = clearValues.data();
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(m_lveSwapChain->GetSwapChainExtent().width);
-    viewport.height = static_cast<float>(m_lveSwapChain->GetSwapChainExtent().height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    VkRect2D scissor{ {0, 0}, m_lveSwapChain->GetSwapChainExtent() };
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+/* 动态渲染没有RenderPass的布局转换与外部依赖，由这里的屏障代替：
+ * 颜色图像从未定义转为颜色附件（等待获取图像信号量的同一阶段），深度图像等待上一次使用它的深度写入
+ */
+void LveRenderer::BeginDynamicRendering(VkCommandBuffer commandBuffer)
+{
+    VkImage colorImage = m_lveSwapChain->GetImage(m_currentImageIndex);
+    VkImage depthImage = m_lveSwapChain->GetDepthImage(m_currentImageIndex);
+    VkFormat depthFormat = m_lveSwapChain->GetSwapChainDepthFormat();
+    bool hasStencil = depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT;
+
+    std::array<VkImageMemoryBarrier, 2> barriers{};
+    barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[0].srcAccessMask = 0;
+    barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].image = colorImage;
+    barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    barriers[1] = barriers[0];
+    barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    barriers[1].image = depthImage;
+    barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    VkRenderingAttachmentInfoKHR colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    colorAttachment.imageView = m_lveSwapChain->GetImageView(m_currentImageIndex);
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue.color = { 0.01f, 0.01f, 0.01f, 1.0f };
+
+    VkRenderingAttachmentInfoKHR depthAttachment{};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depthAttachment.imageView = m_lveSwapChain->GetDepthImageView(m_currentImageIndex);
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+    VkRenderingInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.renderArea = { { 0, 0 }, m_lveSwapChain->GetSwapChainExtent() };
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+    renderingInfo.pStencilAttachment = hasStencil ? &depthAttachment : nullptr;
+
+    m_lveDevice.cmdBeginRendering()(commandBuffer, &renderingInfo);
 }
 
-void LveRenderer::EndSwapChainRenderPass(VkCommandBuffer commandBuffer)
+/*结束后把颜色图像转为呈现布局，呈现由提交时的信号量同步*/
+void LveRenderer::EndDynamicRendering(VkCommandBuffer commandBuffer)
 {
-    assert(m_isFrameStarted && "Can't call endSwapChainRenderPass if frame is not in progress");
+    m_lveDevice.cmdEndRendering()(commandBuffer);
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_lveSwapChain->GetImage(m_currentImageIndex);
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void LveRenderer::NextSubpass(VkCommandBuffer commandBuffer)
+{
+    assert(m_deferred && "Only the deferred render pass has a lighting subpass");
     assert(
         commandBuffer == GetCurrentCommandBuffer() &&
-        "Can't begin render pass on command buffer from a different frame");
+        "Can't advance subpass on command buffer from a different frame");
 
-    vkCmdEndRenderPass(commandBuffer);
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
 }
 
 
@@ -13,16 +13,24 @@ namespace lve {
 	class LveRenderer {
 	public:
 
-		LveRenderer(LveWindow& window, LveDevice& device);
+		/*deferred为true时使用带G-buffer的两个子通道RenderPass，启动后不可切换*/
+		LveRenderer(LveWindow& window, LveDevice& device, bool deferred = false);
 		~LveRenderer();
 
 		LveRenderer(const LveRenderer&) = delete;
 		LveRenderer& operator=(const LveRenderer&) = delete;
 
-		/*提供给渲染系统的查询*/
+		/*提供给渲染系统的查询；使用动态渲染时RenderPass为空，管线按附件格式创建*/
 		VkRenderPass GetSwapChainRenderPass() const { return m_lveSwapChain->GetRenderPass(); }
+		VkFormat GetSwapChainImageFormat() const { return m_lveSwapChain->GetSwapChainImageFormat(); }
+		VkFormat GetSwapChainDepthFormat() const { return m_lveSwapChain->GetSwapChainDepthFormat(); }
+		bool UsesDynamicRendering() const { return m_lveSwapChain->UsesDynamicRendering(); }
 		VkExtent2D GetSwapChainExtent() const { return m_lveSwapChain->GetSwapChainExtent(); }
 		float GetAspectRatio() const { return m_lveSwapChain->GetExtentAspectRatio(); }
+		bool IsDeferred() const { return m_deferred; }
+		GBufferViews GetGBufferViews() const { return m_lveSwapChain->GetGBufferViews(); }
+		/*每次重建交换链加1，G-buffer视图随之失效*/
+		uint32_t GetSwapChainGeneration() const { return m_swapChainGeneration; }
 		VkCommandBuffer GetCurrentCommandBuffer() const {
 			assert(m_isFrameStarted && "Cannot get command buffer when frame not in progress");
 			return m_commandBuffers[m_currentFrameIndex];
@@ -38,6 +46,8 @@ namespace lve {
 		void EndFrame();
 		void BeginSwapChainRenderPass(VkCommandBuffer commandBuffer);
 		void EndSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		/*延迟模式下从几何子通道进入光照子通道*/
+		void NextSubpass(VkCommandBuffer commandBuffer);
 
 		/*状态查询*/
 		bool IsFrameInProgress() const { return m_isFrameStarted; }
@@ -47,6 +57,9 @@ namespace lve {
 	private:
 		void CreateCommandBuffers();
 		void FreeCommandBuffers();
+		void BeginRenderPass(VkCommandBuffer commandBuffer);
+		void BeginDynamicRendering(VkCommandBuffer commandBuffer);
+		void EndDynamicRendering(VkCommandBuffer commandBuffer);
 
 		/*变量需要从上到下按顺序初始化，从下往上销毁*/
 		LveWindow& m_lveWindow;
@@ -57,6 +70,8 @@ namespace lve {
 		uint32_t m_currentImageIndex;	// 跟踪正在进行的当前帧状态
 		int m_currentFrameIndex{0};
 		bool m_isFrameStarted{false};
+		bool m_deferred{false};
+		uint32_t m_swapChainGeneration{0};
 	};
 
 }  // namespace lve
\ No newline at end of file
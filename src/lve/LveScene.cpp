@@ -0,0 +1,346 @@
+﻿#include "LveScene.h"
+
+#include "LveThreadPool.h"
+#include "LveTransformBatch.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace lve {
+
+/*一层少于该数量的节点时单线程处理*/
+static constexpr size_t PARALLEL_NODE_CHUNK = 4096;
+/*需要重算旋转的变换少于该数量时，收集SoA的开销不划算*/
+static constexpr size_t BATCH_MIN_TRANSFORMS = 64;
+/*被修改的实体超过节点数的1/8时，逐层线性遍历比展开子树再排序更快*/
+static constexpr size_t SPARSE_UPDATE_DIVISOR = 8;
+
+LveEntity LveScene::CreateEntity(const TransformComponent& transform)
+{
+	LveEntity entity{};
+	if (!m_freeIndices.empty()) {
+		entity.index = m_freeIndices.back();
+		m_freeIndices.pop_back();
+	}
+	else {
+		entity.index = static_cast<uint32_t>(m_generations.size());
+		m_generations.push_back(0);
+		m_links.emplace_back();
+		m_transformDirty.push_back(0);
+	}
+	entity.generation = m_generations[entity.index];
+
+	m_transforms.Add(entity, transform);
+	m_hierarchyDirty = true;
+	return entity;
+}
+
+void LveScene::DestroyEntity(LveEntity entity)
+{
+	if (!IsAlive(entity)) {
+		return;
+	}
+
+	Detach(entity.index);
+	DestroySubtree(entity.index);
+	m_hierarchyDirty = true;
+}
+
+void LveScene::DestroySubtree(uint32_t entityIndex)
+{
+	uint32_t child = m_links[entityIndex].firstChild;
+	while (child != LveEntity::INVALID_INDEX) {
+		uint32_t next = m_links[child].nextSibling;
+		DestroySubtree(child);
+		child = next;
+	}
+
+	m_models.Remove(entityIndex);
+	m_pointLights.Remove(entityIndex);
+	m_transforms.Remove(entityIndex);
+
+	m_links[entityIndex] = {};
+	m_generations[entityIndex]++;
+	m_freeIndices.push_back(entityIndex);
+}
+
+void LveScene::SetParent(LveEntity child, LveEntity parent)
+{
+	assert(IsAlive(child) && "Entity is not alive");
+	assert((!parent.IsValid() || IsAlive(parent)) && "Parent entity is not alive");
+
+	/*沿parent向上查找，不能挂到自己的子孙下面*/
+	for (uint32_t ancestor = parent.index; ancestor != LveEntity::INVALID_INDEX; ancestor = m_links[ancestor].parent) {
+		assert(ancestor != child.index && "SetParent would create a cycle");
+		if (ancestor == child.index) {
+			return;
+		}
+	}
+
+	Detach(child.index);
+	if (parent.IsValid()) {
+		HierarchyLinks& links = m_links[child.index];
+		HierarchyLinks& parentLinks = m_links[parent.index];
+		links.parent = parent.index;
+		links.nextSibling = parentLinks.firstChild;
+		if (parentLinks.firstChild != LveEntity::INVALID_INDEX) {
+			m_links[parentLinks.firstChild].prevSibling = child.index;
+		}
+		parentLinks.firstChild = child.index;
+	}
+	m_hierarchyDirty = true;
+}
+
+LveEntity LveScene::GetParent(LveEntity entity) const
+{
+	if (!IsAlive(entity) || m_links[entity.index].parent == LveEntity::INVALID_INDEX) {
+		return {};
+	}
+	uint32_t parent = m_links[entity.index].parent;
+	return { parent, m_generations[parent] };
+}
+
+void LveScene::Detach(uint32_t entityIndex)
+{
+	HierarchyLinks& links = m_links[entityIndex];
+	if (links.parent == LveEntity::INVALID_INDEX) {
+		return;
+	}
+	if (links.prevSibling != LveEntity::INVALID_INDEX) {
+		m_links[links.prevSibling].nextSibling = links.nextSibling;
+	}
+	else {
+		m_links[links.parent].firstChild = links.nextSibling;
+	}
+	if (links.nextSibling != LveEntity::INVALID_INDEX) {
+		m_links[links.nextSibling].prevSibling = links.prevSibling;
+	}
+	links.parent = LveEntity::INVALID_INDEX;
+	links.prevSibling = LveEntity::INVALID_INDEX;
+	links.nextSibling = LveEntity::INVALID_INDEX;
+}
+
+/*从所有根节点开始逐层展开，得到父节点总在前面的层级顺序*/
+void LveScene::RebuildHierarchy()
+{
+	m_nodes.clear();
+	m_levelOffsets.clear();
+	m_nodes.reserve(m_transforms.Size());
+	m_nodeOfEntity.assign(m_generations.size(), LveEntity::INVALID_INDEX);
+
+	for (size_t i = 0; i < m_transforms.Size(); i++) {
+		uint32_t entityIndex = m_transforms.GetEntity(i).index;
+		if (m_links[entityIndex].parent == LveEntity::INVALID_INDEX) {
+			m_nodes.push_back({ entityIndex, LveEntity::INVALID_INDEX });
+		}
+	}
+
+	size_t levelBegin = 0;
+	while (levelBegin < m_nodes.size()) {
+		size_t levelEnd = m_nodes.size();
+		m_levelOffsets.push_back(static_cast<uint32_t>(levelBegin));
+		for (size_t node = levelBegin; node < levelEnd; node++) {
+			m_nodeOfEntity[m_nodes[node].entityIndex] = static_cast<uint32_t>(node);
+			m_nodes[node].firstChild = static_cast<uint32_t>(m_nodes.size());
+			uint32_t child = m_links[m_nodes[node].entityIndex].firstChild;
+			for (; child != LveEntity::INVALID_INDEX; child = m_links[child].nextSibling) {
+				m_nodes.push_back({ child, static_cast<uint32_t>(node) });
+			}
+			m_nodes[node].childEnd = static_cast<uint32_t>(m_nodes.size());
+		}
+		levelBegin = levelEnd;
+	}
+	m_levelOffsets.push_back(static_cast<uint32_t>(m_nodes.size()));
+
+	m_worldChanged.assign(m_nodes.size(), 0);
+	m_nodeQueued.assign(m_nodes.size(), 0);
+	m_hierarchyDirty = false;
+}
+
+void LveScene::Reserve(size_t count)
+{
+	m_generations.reserve(count);
+	m_links.reserve(count);
+	m_transformDirty.reserve(count);
+	m_transforms.Reserve(count);
+	m_models.Reserve(count);
+}
+
+uint32_t LveScene::UpdateTransforms()
+{
+	/*结构变化后节点顺序和父子关系都可能不同，全部重算一次*/
+	const bool forceAll = m_hierarchyDirty;
+	if (m_hierarchyDirty) {
+		RebuildHierarchy();
+	}
+
+	if (forceAll || m_dirtyTransforms.size() * SPARSE_UPDATE_DIVISOR > m_nodes.size()) {
+		BatchUpdateLocalMatrices(nullptr);
+		m_transformUpdateCount = UpdateAllNodes(forceAll);
+	}
+	else {
+		BatchUpdateLocalMatrices(&m_dirtyTransforms);
+		m_transformUpdateCount = UpdateDirtySubtrees();
+	}
+
+	for (uint32_t entityIndex : m_dirtyTransforms) {
+		m_transformDirty[entityIndex] = 0;
+	}
+	m_dirtyTransforms.clear();
+	return m_transformUpdateCount;
+}
+
+/* 被修改的节点连同子孙一起收集，子节点在数组中连续，直接按区间展开
+ * 层级顺序下父节点的下标总比子节点小，排序后顺序更新即可保证父节点先于子节点
+ */
+uint32_t LveScene::UpdateDirtySubtrees()
+{
+	m_updateNodes.clear();
+	for (uint32_t entityIndex : m_dirtyTransforms) {
+		if (!m_transforms.Has(entityIndex)) continue;
+		uint32_t node = m_nodeOfEntity[entityIndex];
+		if (!m_nodeQueued[node]) {
+			m_nodeQueued[node] = 1;
+			m_updateNodes.push_back(node);
+		}
+	}
+	for (size_t i = 0; i < m_updateNodes.size(); i++) {
+		const HierarchyNode& node = m_nodes[m_updateNodes[i]];
+		for (uint32_t child = node.firstChild; child < node.childEnd; child++) {
+			if (!m_nodeQueued[child]) {
+				m_nodeQueued[child] = 1;
+				m_updateNodes.push_back(child);
+			}
+		}
+	}
+	std::sort(m_updateNodes.begin(), m_updateNodes.end());
+
+	for (uint32_t index : m_updateNodes) {
+		const HierarchyNode& node = m_nodes[index];
+		TransformComponent& transform = m_transforms.Get(node.entityIndex);
+		transform.UpdateLocalMatrices();
+		const TransformComponent* parent = nullptr;
+		if (node.parent != LveEntity::INVALID_INDEX) {
+			parent = &m_transforms.Get(m_nodes[node.parent].entityIndex);
+		}
+		transform.UpdateWorldMatrices(parent);
+		m_nodeQueued[index] = 0;
+	}
+	return static_cast<uint32_t>(m_updateNodes.size());
+}
+
+uint32_t LveScene::UpdateAllNodes(bool forceAll)
+{
+	std::atomic<uint32_t> count{ 0 };
+	auto updateRange = [&](size_t begin, size_t end) {
+		uint32_t localCount = 0;
+		for (size_t i = begin; i < end; i++) {
+			const HierarchyNode& node = m_nodes[i];
+			TransformComponent& transform = m_transforms.Get(node.entityIndex);
+			bool changed = transform.UpdateLocalMatrices() || forceAll;
+			const TransformComponent* parent = nullptr;
+			if (node.parent != LveEntity::INVALID_INDEX) {
+				changed = changed || m_worldChanged[node.parent] != 0;
+				parent = &m_transforms.Get(m_nodes[node.parent].entityIndex);
+			}
+			if (changed) {
+				transform.UpdateWorldMatrices(parent);
+				localCount++;
+			}
+			m_worldChanged[i] = changed ? 1 : 0;
+		}
+		count.fetch_add(localCount, std::memory_order_relaxed);
+	};
+
+	/*同一层的节点只读取上一层的结果，层与层之间串行*/
+	for (size_t level = 0; level + 1 < m_levelOffsets.size(); level++) {
+		size_t begin = m_levelOffsets[level];
+		size_t end = m_levelOffsets[level + 1];
+		if (end - begin <= PARALLEL_NODE_CHUNK) {
+			updateRange(begin, end);
+			continue;
+		}
+		LveThreadPool::Shared().ParallelFor(end - begin, PARALLEL_NODE_CHUNK, [&](size_t chunkBegin, size_t chunkEnd) {
+			updateRange(begin + chunkBegin, begin + chunkEnd);
+		});
+	}
+
+	return count.load();
+}
+
+void LveScene::BatchUpdateLocalMatrices(const std::vector<uint32_t>* entityIndices)
+{
+	m_batchTransforms.clear();
+	if (entityIndices == nullptr) {
+		for (size_t i = 0; i < m_transforms.Size(); i++) {
+			if (m_transforms[i].NeedsRotationUpdate()) {
+				m_batchTransforms.push_back(m_transforms.GetEntity(i).index);
+			}
+		}
+	}
+	else {
+		for (uint32_t entityIndex : *entityIndices) {
+			if (m_transforms.Has(entityIndex) && m_transforms.Get(entityIndex).NeedsRotationUpdate()) {
+				m_batchTransforms.push_back(entityIndex);
+			}
+		}
+	}
+	const size_t count = m_batchTransforms.size();
+	if (count < BATCH_MIN_TRANSFORMS) {
+		return;
+	}
+
+	for (auto& input : m_batchInput) {
+		input.resize(count);
+	}
+	m_batchModelMatrices.resize(count);
+	m_batchNormalMatrices.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		const TransformComponent& transform = m_transforms.Get(m_batchTransforms[i]);
+		m_batchInput[0][i] = transform.translation.x;
+		m_batchInput[1][i] = transform.translation.y;
+		m_batchInput[2][i] = transform.translation.z;
+		m_batchInput[3][i] = transform.rotation.x;
+		m_batchInput[4][i] = transform.rotation.y;
+		m_batchInput[5][i] = transform.rotation.z;
+		m_batchInput[6][i] = transform.scale.x;
+		m_batchInput[7][i] = transform.scale.y;
+		m_batchInput[8][i] = transform.scale.z;
+	}
+
+	LveThreadPool::Shared().ParallelFor(count, PARALLEL_NODE_CHUNK, [&](size_t begin, size_t end) {
+		LveTransformBatch::Input input{
+			m_batchInput[0].data() + begin, m_batchInput[1].data() + begin, m_batchInput[2].data() + begin,
+			m_batchInput[3].data() + begin, m_batchInput[4].data() + begin, m_batchInput[5].data() + begin,
+			m_batchInput[6].data() + begin, m_batchInput[7].data() + begin, m_batchInput[8].data() + begin,
+		};
+		LveTransformBatch::Compute(input, end - begin,
+			m_batchModelMatrices.data() + begin, m_batchNormalMatrices.data() + begin);
+	});
+
+	for (size_t i = 0; i < count; i++) {
+		m_transforms.Get(m_batchTransforms[i]).SetLocalMatrices(m_batchModelMatrices[i], m_batchNormalMatrices[i]);
+	}
+}
+
+LveEntity LveScene::CreateModelEntity(std::shared_ptr<LveModel> model, const TransformComponent& transform)
+{
+	LveEntity entity = CreateEntity(transform);
+	m_models.Add(entity, ModelComponent{ std::move(model) });
+	return entity;
+}
+
+LveEntity LveScene::CreatePointLight(float intensity, float radius, glm::vec3 color)
+{
+	TransformComponent transform{};
+	transform.scale.x = radius;
+	LveEntity entity = CreateEntity(transform);
+
+	PointLightComponent light{};
+	light.lightIntensity = intensity;
+	light.color = color;
+	m_pointLights.Add(entity, light);
+	return entity;
+}
+
+}  // namespace lve
@@ -0,0 +1,268 @@
+﻿#pragma once
+
+#include "LveObject.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace lve {
+
+/* 实体句柄：index为槽位，generation在实体销毁时递增
+ * 槽位被复用后旧句柄的generation对不上，IsAlive返回false
+ */
+struct LveEntity {
+	static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+	uint32_t index = INVALID_INDEX;
+	uint32_t generation = 0;
+
+	bool IsValid() const { return index != INVALID_INDEX; }
+	bool operator==(const LveEntity&) const = default;
+};
+
+/* 单一组件类型的稀疏集合
+ * m_sparse按实体槽位索引到稠密下标；组件与所属实体在稠密数组中连续存放
+ * 添加/删除/查找都是O(1)，删除时用末尾元素填补空位，因此稠密顺序不稳定
+ */
+template <typename T>
+class LveComponentPool {
+public:
+	static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+	bool Has(uint32_t entityIndex) const {
+		return entityIndex < m_sparse.size() && m_sparse[entityIndex] != NONE;
+	}
+
+	/*已存在时覆盖原组件*/
+	T& Add(LveEntity entity, T component) {
+		if (entity.index >= m_sparse.size()) {
+			m_sparse.resize(static_cast<size_t>(entity.index) + 1, NONE);
+		}
+		uint32_t& slot = m_sparse[entity.index];
+		if (slot != NONE) {
+			m_entities[slot] = entity;
+			m_components[slot] = std::move(component);
+			return m_components[slot];
+		}
+		slot = static_cast<uint32_t>(m_components.size());
+		m_entities.push_back(entity);
+		m_components.push_back(std::move(component));
+		return m_components.back();
+	}
+
+	void Remove(uint32_t entityIndex) {
+		if (!Has(entityIndex)) {
+			return;
+		}
+		uint32_t slot = m_sparse[entityIndex];
+		uint32_t last = static_cast<uint32_t>(m_components.size() - 1);
+		if (slot != last) {
+			m_components[slot] = std::move(m_components[last]);
+			m_entities[slot] = m_entities[last];
+			m_sparse[m_entities[slot].index] = slot;
+		}
+		m_components.pop_back();
+		m_entities.pop_back();
+		m_sparse[entityIndex] = NONE;
+	}
+
+	T& Get(uint32_t entityIndex) {
+		assert(Has(entityIndex) && "Entity does not have this component");
+		return m_components[m_sparse[entityIndex]];
+	}
+	const T& Get(uint32_t entityIndex) const {
+		assert(Has(entityIndex) && "Entity does not have this component");
+		return m_components[m_sparse[entityIndex]];
+	}
+
+	void Reserve(size_t count) {
+		m_entities.reserve(count);
+		m_components.reserve(count);
+	}
+
+	/*按稠密下标遍历：只访问拥有该组件的实体*/
+	size_t Size() const { return m_components.size(); }
+	T& operator[](size_t denseIndex) { return m_components[denseIndex]; }
+	const T& operator[](size_t denseIndex) const { return m_components[denseIndex]; }
+	LveEntity GetEntity(size_t denseIndex) const { return m_entities[denseIndex]; }
+	T* Data() { return m_components.data(); }
+
+	typename std::vector<T>::iterator begin() { return m_components.begin(); }
+	typename std::vector<T>::iterator end() { return m_components.end(); }
+
+private:
+	std::vector<uint32_t> m_sparse;
+	std::vector<LveEntity> m_entities;
+	std::vector<T> m_components;
+};
+
+/* 面向数据的场景存储
+ * 每个实体都有TransformComponent；模型、点光源按需添加，各自放在连续的数组里
+ * 系统遍历View<T>()只会访问拥有T的实体，再通过槽位O(1)取得其他组件
+ * 实体可以挂到父实体下，变换的translation/rotation/scale都是相对父实体的
+ * 修改变换要经过Get<TransformComponent>或EditTransform，场景据此记录需要传播的子树
+ */
+class LveScene {
+public:
+	LveScene() = default;
+
+	LveScene(const LveScene&) = delete;
+	LveScene& operator=(const LveScene&) = delete;
+
+	LveEntity CreateEntity(const TransformComponent& transform = {});
+	/*销毁实体及其全部子孙实体，移除它们的全部组件，旧句柄失效*/
+	void DestroyEntity(LveEntity entity);
+	bool IsAlive(LveEntity entity) const {
+		return entity.index < m_generations.size() && m_generations[entity.index] == entity.generation
+			&& m_transforms.Has(entity.index);
+	}
+	size_t GetEntityCount() const { return m_transforms.Size(); }
+	void Reserve(size_t count);
+
+	/*parent为无效句柄时把child变回根实体；不允许形成环*/
+	void SetParent(LveEntity child, LveEntity parent);
+	LveEntity GetParent(LveEntity entity) const;
+
+	/* 每帧在修改完变换之后、渲染之前调用，刷新被修改实体及其子孙的世界矩阵
+	 * 节点按层级顺序存放在扁平数组里，父节点总在子节点之前，子节点在数组中连续
+	 * 只从被标记的节点出发展开子树，干净的子树不会被访问，静态场景的开销与实体数无关
+	 * 被修改的节点较多或层级结构变化时退回逐层线性遍历，层足够大时分给线程池并行
+	 * 返回本次重算世界矩阵的变换数量，静态场景为0
+	 */
+	uint32_t UpdateTransforms();
+	uint32_t GetTransformUpdateCount() const { return m_transformUpdateCount; }
+
+	LveEntity CreateModelEntity(std::shared_ptr<LveModel> model, const TransformComponent& transform = {});
+	LveEntity CreatePointLight(float intensity = 10.f, float radius = 0.1f, glm::vec3 color = glm::vec3(1.f));
+
+	template <typename T>
+	T& Add(LveEntity entity, T component = {}) {
+		assert(IsAlive(entity) && "Entity is not alive");
+		if constexpr (std::is_same_v<T, TransformComponent>) {
+			MarkTransformDirty(entity.index);
+		}
+		return Pool<T>().Add(entity, std::move(component));
+	}
+
+	template <typename T>
+	void Remove(LveEntity entity) {
+		static_assert(!std::is_same_v<T, TransformComponent>, "TransformComponent cannot be removed");
+		assert(IsAlive(entity) && "Entity is not alive");
+		Pool<T>().Remove(entity.index);
+	}
+
+	template <typename T>
+	bool Has(LveEntity entity) const {
+		return IsAlive(entity) && Pool<T>().Has(entity.index);
+	}
+
+	/*取得TransformComponent时视为要修改，标记该实体的子树需要传播*/
+	template <typename T>
+	T& Get(LveEntity entity) {
+		assert(IsAlive(entity) && "Entity is not alive");
+		if constexpr (std::is_same_v<T, TransformComponent>) {
+			MarkTransformDirty(entity.index);
+		}
+		return Pool<T>().Get(entity.index);
+	}
+
+	/*拥有组件T的全部实体*/
+	template <typename T>
+	LveComponentPool<T>& View() { return Pool<T>(); }
+
+	/*按槽位取变换，配合View<T>().GetEntity(i).index使用，省去generation检查；只读*/
+	const TransformComponent& GetTransform(uint32_t entityIndex) const { return m_transforms.Get(entityIndex); }
+	/*按槽位取变换并标记为已修改*/
+	TransformComponent& EditTransform(uint32_t entityIndex) {
+		MarkTransformDirty(entityIndex);
+		return m_transforms.Get(entityIndex);
+	}
+
+private:
+	template <typename T>
+	LveComponentPool<T>& Pool() {
+		return const_cast<LveComponentPool<T>&>(static_cast<const LveScene*>(this)->Pool<T>());
+	}
+
+	template <typename T>
+	const LveComponentPool<T>& Pool() const {
+		if constexpr (std::is_same_v<T, TransformComponent>) {
+			return m_transforms;
+		}
+		else if constexpr (std::is_same_v<T, ModelComponent>) {
+			return m_models;
+		}
+		else {
+			static_assert(std::is_same_v<T, PointLightComponent>, "Unknown component type");
+			return m_pointLights;
+		}
+	}
+
+	/*按槽位存放的父子关系，子节点用侵入式双向链表串起来，挂接/断开都是O(1)*/
+	struct HierarchyLinks {
+		uint32_t parent = LveEntity::INVALID_INDEX;
+		uint32_t firstChild = LveEntity::INVALID_INDEX;
+		uint32_t prevSibling = LveEntity::INVALID_INDEX;
+		uint32_t nextSibling = LveEntity::INVALID_INDEX;
+	};
+
+	/*扁平层级数组中的节点，parent是父节点在该数组中的下标，子节点为[firstChild, childEnd)*/
+	struct HierarchyNode {
+		uint32_t entityIndex;
+		uint32_t parent;
+		uint32_t firstChild = 0;
+		uint32_t childEnd = 0;
+	};
+
+	void MarkTransformDirty(uint32_t entityIndex) {
+		if (!m_transformDirty[entityIndex]) {
+			m_transformDirty[entityIndex] = 1;
+			m_dirtyTransforms.push_back(entityIndex);
+		}
+	}
+	/*从被修改的节点展开子树，按数组顺序只更新这些节点*/
+	uint32_t UpdateDirtySubtrees();
+	/*逐层遍历全部节点；forceAll为true时不比较快照，全部重算*/
+	uint32_t UpdateAllNodes(bool forceAll);
+	void Detach(uint32_t entityIndex);
+	void DestroySubtree(uint32_t entityIndex);
+	/*结构变化后按层重新排列节点*/
+	void RebuildHierarchy();
+	/* 旋转/缩放变化的对象足够多时，先用LveTransformBatch的SIMD路径批量算出局部矩阵
+	 * entityIndices为空指针时检查全部变换
+	 */
+	void BatchUpdateLocalMatrices(const std::vector<uint32_t>* entityIndices);
+
+	std::vector<uint32_t> m_generations;	// 每个槽位当前的generation
+	std::vector<uint32_t> m_freeIndices;	// 已销毁、可复用的槽位
+	std::vector<HierarchyLinks> m_links;
+
+	std::vector<HierarchyNode> m_nodes;
+	std::vector<uint32_t> m_levelOffsets;	// 第i层为[m_levelOffsets[i], m_levelOffsets[i + 1])
+	std::vector<uint8_t> m_worldChanged;	// 与m_nodes对应，本帧世界矩阵是否重算，供子节点判断
+	std::vector<uint32_t> m_nodeOfEntity;	// 按槽位索引到m_nodes中的下标
+	bool m_hierarchyDirty = true;
+
+	std::vector<uint8_t> m_transformDirty;		// 按槽位，已在m_dirtyTransforms中
+	std::vector<uint32_t> m_dirtyTransforms;	// 上次更新后被修改的实体槽位
+	std::vector<uint32_t> m_updateNodes;		// 本次需要更新的节点下标，每帧复用
+	std::vector<uint8_t> m_nodeQueued;			// 与m_nodes对应，节点已在m_updateNodes中
+
+	LveComponentPool<TransformComponent> m_transforms;
+	LveComponentPool<ModelComponent> m_models;
+	LveComponentPool<PointLightComponent> m_pointLights;
+
+	uint32_t m_transformUpdateCount = 0;
+
+	/*批量计算的SoA暂存，每帧复用*/
+	std::vector<uint32_t> m_batchTransforms;	// 参与批量计算的实体槽位
+	std::vector<float> m_batchInput[9];
+	std::vector<glm::mat4> m_batchModelMatrices;
+	std::vector<glm::mat3> m_batchNormalMatrices;
+};
+
+}  // namespace lve
@@ -0,0 +1,197 @@
+﻿#include "LveShaderCompiler.h"
+
+#include "LveUtils.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace lve {
+
+static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+static bool ReadWholeFile(const std::string& path, std::vector<char>& data)
+{
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	data.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	return static_cast<bool>(file.read(data.data(), data.size()));
+}
+
+static bool IsSpirv(const std::vector<char>& code)
+{
+	uint32_t magic = 0;
+	if (code.size() < sizeof(magic) || code.size() % sizeof(uint32_t) != 0) {
+		return false;
+	}
+	memcpy(&magic, code.data(), sizeof(magic));
+	return magic == SPIRV_MAGIC;
+}
+
+static bool StageFromExtension(const std::string& extension, shaderc_shader_kind& kind)
+{
+	if (extension == ".vert") {
+		kind = shaderc_glsl_vertex_shader;
+	}
+	else if (extension == ".frag") {
+		kind = shaderc_glsl_fragment_shader;
+	}
+	else if (extension == ".comp") {
+		kind = shaderc_glsl_compute_shader;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+LveShaderCompiler& LveShaderCompiler::Shared()
+{
+	static LveShaderCompiler compiler;
+	return compiler;
+}
+
+LveShaderCompiler::LveShaderCompiler()
+{
+	m_compiler = shaderc_compiler_initialize();
+	if (m_compiler == nullptr) {
+		throw std::runtime_error("failed to initialize shader compiler!");
+	}
+}
+
+LveShaderCompiler::~LveShaderCompiler()
+{
+	shaderc_compiler_release(m_compiler);
+}
+
+std::string LveShaderCompiler::ShaderPath(const std::string& name)
+{
+	static const char* directories[] = {
+#ifdef LVE_SHADER_DIR
+		LVE_SHADER_DIR,
+#endif
+		"res/shaders",
+		"res/models/shaders",		// 构建后复制到输出目录的位置
+		"../../../res/shaders",
+	};
+	for (const char* directory : directories) {
+		std::filesystem::path path = std::filesystem::path(directory) / name;
+		std::error_code ec;
+		if (std::filesystem::exists(path, ec)) {
+			return path.generic_string();
+		}
+	}
+	/*都找不到时交给Load报告打不开的文件*/
+	return name;
+}
+
+std::vector<char> LveShaderCompiler::Load(const std::string& path, const std::vector<std::string>& defines)
+{
+	std::vector<char> source;
+	if (!ReadWholeFile(path, source)) {
+		throw std::runtime_error("failed to open file: " + path);
+	}
+
+	shaderc_shader_kind kind;
+	std::string extension = std::filesystem::path(path).extension().string();
+	if (extension == ".spv" || !StageFromExtension(extension, kind)) {
+		return source;
+	}
+
+	uint64_t key = HashBytes(source.data(), source.size());
+	key = HashBytes(&CACHE_VERSION, sizeof(CACHE_VERSION), key);
+	key = HashBytes(&kind, sizeof(kind), key);
+	for (const std::string& define : defines) {
+		/*带上结尾的'\0'，避免"AB"+"C"与"A"+"BC"得到相同的键*/
+		key = HashBytes(define.c_str(), define.size() + 1, key);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_loaded.find(key);
+		if (it != m_loaded.end()) {
+			return *it->second;
+		}
+	}
+
+	char keyName[17];
+	snprintf(keyName, sizeof(keyName), "%016llx", static_cast<unsigned long long>(key));
+	const std::filesystem::path cachePath = std::filesystem::path(CACHE_DIRECTORY) / (std::string(keyName) + ".spv");
+
+	std::vector<char> code;
+	if (!ReadWholeFile(cachePath.string(), code) || !IsSpirv(code)) {
+		code = Compile(path, std::string(source.begin(), source.end()), defines);
+
+		/*先写临时文件再重命名，多个线程编译同一着色器时不会读到写了一半的缓存；写入失败只打印警告*/
+		std::error_code ec;
+		std::filesystem::create_directories(CACHE_DIRECTORY, ec);
+		std::filesystem::path tempPath = cachePath;
+		tempPath += ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+		/*磁盘满时可能只写入一部分，截断的文件仍可能通过IsSpirv，因此写入或关闭失败时不重命名*/
+		bool written = false;
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			if (out) {
+				out.write(code.data(), code.size());
+				out.close();
+				written = !out.fail();
+			}
+		}
+		if (written) {
+			std::filesystem::rename(tempPath, cachePath, ec);
+		}
+		if (!written || ec) {
+			std::filesystem::remove(tempPath, ec);
+			std::cerr << "failed to write shader cache: " << cachePath.string() << "\n";
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_loaded[key] = std::make_shared<const std::vector<char>>(code);
+	return code;
+}
+
+std::vector<char> LveShaderCompiler::Compile(const std::string& path, const std::string& source, const std::vector<std::string>& defines)
+{
+	shaderc_shader_kind kind;
+	StageFromExtension(std::filesystem::path(path).extension().string(), kind);
+
+	shaderc_compile_options_t options = shaderc_compile_options_initialize();
+	shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+	shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+	for (const std::string& define : defines) {
+		size_t split = define.find('=');
+		if (split == std::string::npos) {
+			shaderc_compile_options_add_macro_definition(options, define.c_str(), define.size(), nullptr, 0);
+		}
+		else {
+			shaderc_compile_options_add_macro_definition(options, define.c_str(), split,
+				define.c_str() + split + 1, define.size() - split - 1);
+		}
+	}
+
+	shaderc_compilation_result_t result = shaderc_compile_into_spv(
+		m_compiler, source.c_str(), source.size(), kind, path.c_str(), "main", options);
+	shaderc_compile_options_release(options);
+
+	if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success) {
+		std::string message = shaderc_result_get_error_message(result);
+		shaderc_result_release(result);
+		throw std::runtime_error("failed to compile shader " + path + ":\n" + message);
+	}
+
+	const char* bytes = shaderc_result_get_bytes(result);
+	std::vector<char> code(bytes, bytes + shaderc_result_get_length(result));
+	shaderc_result_release(result);
+	std::cout << "compiled shader: " << path << "\n";
+	return code;
+}
+
+}  // namespace lve
@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <shaderc/shaderc.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+/* 运行时GLSL编译
+ * 按扩展名（.vert/.frag/.comp）确定着色器阶段，用shaderc编译成SPIR-V
+ * 结果按内容寻址缓存：键为源码哈希 + 阶段 + 宏定义，文件为 shader_cache/<键>.spv
+ * 源码没变时直接读取缓存，不再调用编译器；.spv路径原样读取
+ * shaderc编译器实例可以被多个线程同时使用，管线并行编译与热重载共用同一个实例
+ */
+class LveShaderCompiler {
+public:
+	static constexpr uint32_t CACHE_VERSION = 1;	// 编译选项变化时递增，旧缓存自动失效
+	static constexpr const char* CACHE_DIRECTORY = "shader_cache";
+
+	static LveShaderCompiler& Shared();
+
+	LveShaderCompiler(const LveShaderCompiler&) = delete;
+	LveShaderCompiler& operator=(const LveShaderCompiler&) = delete;
+
+	/* 在着色器目录中查找name（如"shader.vert"），返回可以打开的完整路径
+	 * 优先使用构建时记录的源码目录（LVE_SHADER_DIR），便于热重载直接监视源文件
+	 */
+	static std::string ShaderPath(const std::string& name);
+
+	/*返回SPIR-V；defines为"NAME"或"NAME=VALUE"，参与缓存键。编译失败时抛出，异常信息包含编译日志*/
+	std::vector<char> Load(const std::string& path, const std::vector<std::string>& defines = {});
+
+private:
+	LveShaderCompiler();
+	~LveShaderCompiler();
+
+	std::vector<char> Compile(const std::string& path, const std::string& source, const std::vector<std::string>& defines);
+
+	shaderc_compiler_t m_compiler = nullptr;
+
+	/*同一进程内重复加载（多个管线共用着色器、交换链重建）不再读磁盘缓存*/
+	std::mutex m_mutex;
+	std::unordered_map<uint64_t, std::shared_ptr<const std::vector<char>>> m_loaded;
+};
+
+}  // namespace lve
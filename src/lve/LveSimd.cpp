@@ -0,0 +1,56 @@
+﻿#include "LveSimd.h"
+
+#if defined(LVE_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace lve {
+
+#if defined(LVE_SIMD_X86) && defined(_MSC_VER)
+/*AVX需要CPU支持且操作系统保存YMM寄存器（OSXSAVE + XCR0的第1、2位）*/
+static bool CpuSupportsAvx()
+{
+	int info[4] = {};
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+}
+#elif defined(LVE_SIMD_X86)
+static bool CpuSupportsAvx()
+{
+	return __builtin_cpu_supports("avx");
+}
+#endif
+
+LveSimdLevel DetectSimdLevel()
+{
+	static const LveSimdLevel detected = []() {
+#if defined(LVE_SIMD_X86)
+		return CpuSupportsAvx() ? LveSimdLevel::AVX : LveSimdLevel::SSE;
+#else
+		return LveSimdLevel::Scalar;
+#endif
+	}();
+	return detected;
+}
+
+bool IsSimdLevelSupported(LveSimdLevel level)
+{
+	return static_cast<int>(level) <= static_cast<int>(DetectSimdLevel());
+}
+
+const char* GetSimdLevelName(LveSimdLevel level)
+{
+	switch (level) {
+	case LveSimdLevel::Scalar:
+		return "scalar";
+	case LveSimdLevel::SSE:
+		return "sse";
+	case LveSimdLevel::AVX:
+		return "avx";
+	}
+	return "unknown";
+}
+
+}  // namespace lve
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+/* CPU指令集的运行时检测，供批量计算选择SIMD实现
+ * x86上包含intrinsics头文件并定义LVE_SIMD_X86；其他平台只有标量实现
+ */
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LVE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/*MSVC不需要额外开关即可使用AVX内建函数；GCC/Clang按函数开启目标指令集*/
+#if defined(LVE_SIMD_X86) && !defined(_MSC_VER)
+#define LVE_TARGET_AVX __attribute__((target("avx")))
+#else
+#define LVE_TARGET_AVX
+#endif
+
+namespace lve {
+
+enum class LveSimdLevel {
+	Scalar,
+	SSE,	// SSE2，x64上的基础指令集
+	AVX,
+};
+
+/*当前CPU支持的最高级别，首次调用时检测*/
+LveSimdLevel DetectSimdLevel();
+bool IsSimdLevelSupported(LveSimdLevel level);
+const char* GetSimdLevelName(LveSimdLevel level);
+
+}  // namespace lve
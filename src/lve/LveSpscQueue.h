@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace lve {
+
+/* 单生产者单消费者的无锁环形队列，容量固定为Capacity - 1
+ * 只有生产者线程写m_tail、只有消费者线程写m_head，两者放在不同缓存行避免伪共享
+ * 队列满时TryPush返回false，由调用者决定丢弃或合并
+ */
+template <typename T, size_t Capacity>
+class LveSpscQueue {
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	/*生产者线程调用*/
+	bool TryPush(const T& item) {
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		size_t next = (tail + 1) & (Capacity - 1);
+		if (next == m_head.load(std::memory_order_acquire)) {
+			return false;
+		}
+		m_items[tail] = item;
+		m_tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	/*消费者线程调用*/
+	bool TryPop(T& item) {
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = m_items[head];
+		m_head.store((head + 1) & (Capacity - 1), std::memory_order_release);
+		return true;
+	}
+
+private:
+	alignas(64) std::atomic<size_t> m_head{ 0 };
+	alignas(64) std::atomic<size_t> m_tail{ 0 };
+	std::array<T, Capacity> m_items{};
+};
+
+}
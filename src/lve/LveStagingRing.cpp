@@ -0,0 +1,273 @@
+﻿#include "LveStagingRing.h"
+
+#include "LveBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace lve {
+
+static constexpr VkDeviceSize RING_ALIGNMENT = 16;
+
+LveStagingRing::LveStagingRing(LveDevice& device, VkDeviceSize capacity)
+	: m_lveDevice{ device }, m_capacity{ capacity }
+{
+	m_ringBuffer = std::make_unique<LveBuffer>(
+		m_lveDevice,
+		m_capacity,
+		1,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	/*整个生命周期保持映射*/
+	if (m_ringBuffer->Map() != VK_SUCCESS) {
+		throw std::runtime_error("failed to map staging ring!");
+	}
+	m_mapped = static_cast<char*>(m_ringBuffer->GetMappedMemory());
+
+	QueueFamilyIndices queueFamilyIndices = m_lveDevice.findPhysicalQueueFamilies();
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(m_lveDevice.device(), &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create staging command pool!");
+	}
+}
+
+LveStagingRing::~LveStagingRing()
+{
+	WaitIdle();
+
+	for (auto& batch : m_freeBatches) {
+		vkDestroyFence(m_lveDevice.device(), batch.fence, nullptr);
+	}
+	/*命令缓冲随命令池一起释放*/
+	vkDestroyCommandPool(m_lveDevice.device(), m_commandPool, nullptr);
+}
+
+UploadTicket LveStagingRing::Upload(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	const char* src = static_cast<const char*>(data);
+	while (size > 0) {
+		/*单次最多占用半个环，保证大数据能边提交边回收*/
+		VkDeviceSize chunk = (std::min)(size, m_capacity / 2);
+		VkDeviceSize offset = Allocate(chunk, lock);
+		memcpy(m_mapped + offset, src, static_cast<size_t>(chunk));
+
+		if (!m_recording) {
+			BeginBatch();
+		}
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = offset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = chunk;
+		vkCmdCopyBuffer(m_current.commandBuffer, m_ringBuffer->GetBuffer(), dstBuffer, 1, &copyRegion);
+		m_current.copyCount++;
+
+		src += chunk;
+		dstOffset += chunk;
+		size -= chunk;
+	}
+	return m_recording ? m_current.ticket : m_completedTicket.load();
+}
+
+void LveStagingRing::Flush()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_recording && m_current.copyCount > 0) {
+		SubmitBatch();
+	}
+	RetireCompleted();
+}
+
+void LveStagingRing::WaitIdle()
+{
+	Flush();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_inFlight.empty()) {
+		WaitOldest(lock);
+	}
+}
+
+bool LveStagingRing::IsComplete(UploadTicket ticket)
+{
+	if (ticket <= m_completedTicket.load(std::memory_order_acquire)) {
+		return true;
+	}
+	/*其他线程持有锁时直接返回，完成状态由下一次Flush或查询更新*/
+	std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+	if (lock.owns_lock()) {
+		RetireCompleted();
+	}
+	return ticket <= m_completedTicket.load(std::memory_order_acquire);
+}
+
+void LveStagingRing::Wait(UploadTicket ticket)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	/*票据还在录制中的批次里，先提交*/
+	if (m_recording && ticket >= m_current.ticket && m_current.copyCount > 0) {
+		SubmitBatch();
+	}
+	while (ticket > m_completedTicket.load() && !m_inFlight.empty()) {
+		WaitOldest(lock);
+	}
+}
+
+/* 在环中分配size字节，返回环内偏移
+ * 空间不足时先提交当前批次，再释放锁等待最早的批次完成以回收空间
+ * 等待期间其他线程可能继续分配，因此每次等待后重新计算偏移
+ */
+VkDeviceSize LveStagingRing::Allocate(VkDeviceSize size, std::unique_lock<std::mutex>& lock)
+{
+	assert(size <= m_capacity && "Staging allocation larger than ring");
+
+	while (true) {
+		uint64_t offset = (m_head + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+		/*不跨越环尾，放不下就从下一圈开头开始*/
+		if (offset % m_capacity + size > m_capacity) {
+			offset = (offset / m_capacity + 1) * m_capacity;
+		}
+
+		if (offset + size - m_tail > m_capacity) {
+			if (!m_inFlight.empty()) {
+				WaitOldest(lock);
+				continue;
+			}
+			if (m_recording && m_current.copyCount > 0) {
+				SubmitBatch();
+				continue;
+			}
+			/*环中已没有存活数据*/
+			m_tail = offset;
+		}
+
+		m_head = offset + size;
+		return static_cast<VkDeviceSize>(offset % m_capacity);
+	}
+}
+
+void LveStagingRing::BeginBatch()
+{
+	m_current = AcquireBatch();
+	m_current.ticket = m_nextTicket++;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (vkBeginCommandBuffer(m_current.commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin staging command buffer!");
+	}
+	m_recording = true;
+}
+
+void LveStagingRing::SubmitBatch()
+{
+	/* 复制结果对之后提交到同一队列的顶点/索引/着色器读取可见
+	 * 专用传输队列上由fence完成 + 缓冲区并发共享保证图形队列读取到的是完整数据
+	 */
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	vkCmdPipelineBarrier(
+		m_current.commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+
+	if (vkEndCommandBuffer(m_current.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record staging command buffer!");
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_current.commandBuffer;
+
+	{
+		auto queueLock = m_lveDevice.lockQueue(m_lveDevice.transferQueue());
+		if (vkQueueSubmit(m_lveDevice.transferQueue(), 1, &submitInfo, m_current.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit staging command buffer!");
+		}
+	}
+
+	m_current.ringEnd = m_head;
+	m_inFlight.push_back(m_current);
+	m_current = {};
+	m_recording = false;
+}
+
+/*回收已完成的批次，不等待；fence留到批次被复用时再重置*/
+void LveStagingRing::RetireCompleted()
+{
+	while (!m_inFlight.empty()) {
+		Batch& batch = m_inFlight.front();
+		if (vkGetFenceStatus(m_lveDevice.device(), batch.fence) != VK_SUCCESS) {
+			break;
+		}
+
+		m_tail = batch.ringEnd;
+		m_completedTicket.store(batch.ticket, std::memory_order_release);
+		vkResetCommandBuffer(batch.commandBuffer, 0);
+		batch.copyCount = 0;
+		m_freeBatches.push_back(batch);
+		m_inFlight.pop_front();
+	}
+}
+
+/* 等待期间其他线程可能已回收该批次，但有线程在锁外等待时空闲批次不会被复用，
+ * 所以fence不会在等待中被重置
+ */
+void LveStagingRing::WaitOldest(std::unique_lock<std::mutex>& lock)
+{
+	assert(!m_inFlight.empty());
+	VkFence fence = m_inFlight.front().fence;
+	m_fenceWaiters++;
+	lock.unlock();
+	vkWaitForFences(m_lveDevice.device(), 1, &fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)());
+	lock.lock();
+	m_fenceWaiters--;
+	RetireCompleted();
+}
+
+LveStagingRing::Batch LveStagingRing::AcquireBatch()
+{
+	if (!m_freeBatches.empty() && m_fenceWaiters == 0) {
+		Batch batch = m_freeBatches.back();
+		m_freeBatches.pop_back();
+		vkResetFences(m_lveDevice.device(), 1, &batch.fence);
+		return batch;
+	}
+
+	Batch batch{};
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = m_commandPool;
+	allocInfo.commandBufferCount = 1;
+	if (vkAllocateCommandBuffers(m_lveDevice.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate staging command buffer!");
+	}
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if (vkCreateFence(m_lveDevice.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create staging fence!");
+	}
+	return batch;
+}
+
+}  // namespace lve
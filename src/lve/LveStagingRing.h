@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include "LveDevice.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lve {
+
+class LveBuffer;
+
+/* 持久映射的上传环形缓冲区
+ * 所有上传先memcpy到环中，再把vkCmdCopyBuffer录制进同一个批次命令缓冲
+ * 批次用fence提交到传输队列，不等待GPU；环空间在fence完成后回收
+ * 每个批次有递增的编号，作为UploadTicket返回给调用者
+ * 等待fence时不持有锁，加载线程等待环空间不会阻塞渲染线程的Flush与IsComplete
+ */
+class LveStagingRing {
+public:
+	static constexpr VkDeviceSize DEFAULT_CAPACITY = 32ull * 1024 * 1024;
+
+	LveStagingRing(LveDevice& device, VkDeviceSize capacity = DEFAULT_CAPACITY);
+	~LveStagingRing();
+
+	LveStagingRing(const LveStagingRing&) = delete;
+	LveStagingRing& operator=(const LveStagingRing&) = delete;
+
+	/*把data拷贝进环并记录到dstBuffer的复制命令，大于环容量的数据会被拆分
+	 *返回包含最后一段复制的批次编号*/
+	UploadTicket Upload(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+
+	/*提交当前批次（不阻塞），没有待提交的复制时什么也不做*/
+	void Flush();
+	/*提交并等待所有批次完成*/
+	void WaitIdle();
+
+	/*不阻塞：已完成的票据只读原子量，否则在锁空闲时顺带回收已完成的批次*/
+	bool IsComplete(UploadTicket ticket);
+	void Wait(UploadTicket ticket);
+
+	VkDeviceSize GetCapacity() const { return m_capacity; }
+
+private:
+	struct Batch {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		UploadTicket ticket = 0;
+		uint64_t ringEnd = 0;	// 该批次使用到的环位置，完成后tail推进到这里
+		uint32_t copyCount = 0;
+	};
+
+	VkDeviceSize Allocate(VkDeviceSize size, std::unique_lock<std::mutex>& lock);
+	void BeginBatch();
+	void SubmitBatch();
+	void RetireCompleted();
+	/*释放锁等待最早的批次，重新加锁后回收*/
+	void WaitOldest(std::unique_lock<std::mutex>& lock);
+	Batch AcquireBatch();
+
+	LveDevice& m_lveDevice;
+	VkDeviceSize m_capacity;
+	std::unique_ptr<LveBuffer> m_ringBuffer;
+	char* m_mapped = nullptr;
+
+	uint64_t m_head = 0;	// 单调递增的写入位置，取模得到环内偏移
+	uint64_t m_tail = 0;	// 最早的未完成批次起点
+
+	VkCommandPool m_commandPool = VK_NULL_HANDLE;
+	Batch m_current{};
+	bool m_recording = false;
+	std::deque<Batch> m_inFlight;
+	std::vector<Batch> m_freeBatches;
+
+	UploadTicket m_nextTicket = 1;
+	std::atomic<UploadTicket> m_completedTicket{ 0 };	// 批次按提交顺序完成，小于等于该值的票据都已完成
+	uint32_t m_fenceWaiters = 0;	// 在锁外等待fence的线程数，不为0时不复用空闲批次的fence
+
+	std::mutex m_mutex;
+};
+
+}  // namespace lve
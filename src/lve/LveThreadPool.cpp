@@ -0,0 +1,139 @@
+﻿#include "LveThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace lve {
+
+LveThreadPool::LveThreadPool(uint32_t threadCount)
+{
+	threadCount = (std::max)(threadCount, 1u);
+	m_workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++) {
+		m_workers.emplace_back([this]() { WorkerLoop(); });
+	}
+}
+
+LveThreadPool::~LveThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+LveThreadPool& LveThreadPool::Shared()
+{
+	static LveThreadPool pool;
+	return pool;
+}
+
+uint32_t LveThreadPool::DefaultThreadCount()
+{
+	/*留一个核给GUI/渲染线程*/
+	uint32_t hardware = std::thread::hardware_concurrency();
+	return hardware > 1 ? hardware - 1 : 1;
+}
+
+void LveThreadPool::Enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_condition.notify_one();
+}
+
+void LveThreadPool::WorkerLoop()
+{
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+			/*退出前把队列里剩余的任务执行完*/
+			if (m_tasks.empty()) {
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
+
+void LveThreadPool::ParallelFor(size_t count, size_t minChunk, const std::function<void(size_t, size_t)>& fn)
+{
+	if (count == 0) {
+		return;
+	}
+
+	const size_t participants = m_workers.size() + 1;
+	minChunk = (std::max)(minChunk, size_t(1));
+	/*每个参与者约4块，兼顾负载均衡与调度开销*/
+	size_t chunkSize = (std::max)(minChunk, (count + participants * 4 - 1) / (participants * 4));
+	size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	if (chunkCount == 1) {
+		fn(0, count);
+		return;
+	}
+
+	/*帮手任务可能在ParallelFor返回后才被调度，共享状态用shared_ptr保活*/
+	struct State {
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> finished{ 0 };
+		size_t chunkCount = 0;
+		size_t chunkSize = 0;
+		size_t count = 0;
+		const std::function<void(size_t, size_t)>* fn = nullptr;
+		std::mutex mutex;
+		std::condition_variable done;
+		std::exception_ptr error;
+	};
+	auto state = std::make_shared<State>();
+	state->chunkCount = chunkCount;
+	state->chunkSize = chunkSize;
+	state->count = count;
+	state->fn = &fn;
+
+	auto runChunks = [](State& s) {
+		size_t chunk;
+		while ((chunk = s.next.fetch_add(1)) < s.chunkCount) {
+			size_t begin = chunk * s.chunkSize;
+			size_t end = (std::min)(begin + s.chunkSize, s.count);
+			try {
+				(*s.fn)(begin, end);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(s.mutex);
+				if (!s.error) {
+					s.error = std::current_exception();
+				}
+			}
+			if (s.finished.fetch_add(1) + 1 == s.chunkCount) {
+				std::lock_guard<std::mutex> lock(s.mutex);
+				s.done.notify_all();
+			}
+		}
+	};
+
+	size_t helpers = (std::min)(chunkCount - 1, m_workers.size());
+	for (size_t i = 0; i < helpers; i++) {
+		Enqueue([state, runChunks]() { runChunks(*state); });
+	}
+	runChunks(*state);
+
+	/*只等待已被其他线程领走、正在执行的块*/
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->done.wait(lock, [&]() { return state->finished.load() == state->chunkCount; });
+	if (state->error) {
+		std::rethrow_exception(state->error);
+	}
+}
+
+}  // namespace lve
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace lve {
+
+/* 固定大小的工作线程池
+ * Submit投递异步任务，ParallelFor把区间切块并行执行
+ * ParallelFor的调用线程自己也领取分块，因此在工作线程内嵌套调用不会死锁
+ */
+class LveThreadPool {
+public:
+	explicit LveThreadPool(uint32_t threadCount = DefaultThreadCount());
+	~LveThreadPool();
+
+	LveThreadPool(const LveThreadPool&) = delete;
+	LveThreadPool& operator=(const LveThreadPool&) = delete;
+
+	/*进程内共享的线程池，首次使用时创建*/
+	static LveThreadPool& Shared();
+	static uint32_t DefaultThreadCount();
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+	template <typename F>
+	auto Submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+		using Result = std::invoke_result_t<std::decay_t<F>>;
+		auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+		std::future<Result> future = packaged->get_future();
+		Enqueue([packaged]() { (*packaged)(); });
+		return future;
+	}
+
+	/* 把[0, count)切成不小于minChunk的块，fn(begin, end)在多个线程上执行
+	 * 返回时所有块都已完成；fn抛出的第一个异常会在调用线程重新抛出
+	 */
+	void ParallelFor(size_t count, size_t minChunk, const std::function<void(size_t, size_t)>& fn);
+
+private:
+	void Enqueue(std::function<void()> task);
+	void WorkerLoop();
+
+	std::vector<std::thread> m_workers;
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stopping = false;
+};
+
+}  // namespace lve
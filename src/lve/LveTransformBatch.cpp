@@ -0,0 +1,279 @@
+﻿#include "LveTransformBatch.h"
+
+#include <cmath>
+
+namespace lve {
+
+/* sin/cos多项式（Cephes单精度），在[-pi/4, pi/4]内有效
+ * 先按pi/2取整得到象限j，用三段常数做Cody-Waite约简保证精度
+ */
+static constexpr float TWO_OVER_PI = 0.636619772367581343f;
+static constexpr float PI_OVER_2_A = 1.5703125f;
+static constexpr float PI_OVER_2_B = 4.837512969970703125e-4f;
+static constexpr float PI_OVER_2_C = 7.54978995489188216e-8f;
+static constexpr float SIN_C1 = -1.6666654611e-1f;
+static constexpr float SIN_C2 = 8.3321608736e-3f;
+static constexpr float SIN_C3 = -1.9515295891e-4f;
+static constexpr float COS_C1 = 4.166664568298827e-2f;
+static constexpr float COS_C2 = -1.388731625493765e-3f;
+static constexpr float COS_C3 = 2.443315711809948e-5f;
+
+/*按列写出一个对象的矩阵，terms依次为旋转矩阵的9个元素（按列）*/
+static inline void StoreMatrices(const float model[9], const float normal[9], float tx, float ty, float tz,
+	glm::mat4& modelMatrix, glm::mat3& normalMatrix)
+{
+	modelMatrix = glm::mat4{
+		{ model[0], model[1], model[2], 0.0f },
+		{ model[3], model[4], model[5], 0.0f },
+		{ model[6], model[7], model[8], 0.0f },
+		{ tx, ty, tz, 1.0f } };
+	normalMatrix = glm::mat3{
+		{ normal[0], normal[1], normal[2] },
+		{ normal[3], normal[4], normal[5] },
+		{ normal[6], normal[7], normal[8] } };
+}
+
+void LveTransformBatch::Compute(const Input& input, size_t count, glm::mat4* modelMatrices, glm::mat3* normalMatrices,
+	LveSimdLevel level)
+{
+	if (!IsSimdLevelSupported(level)) {
+		level = DetectSimdLevel();
+	}
+	switch (level) {
+	case LveSimdLevel::AVX:
+		ComputeAVX(input, count, modelMatrices, normalMatrices);
+		break;
+	case LveSimdLevel::SSE:
+		ComputeSSE(input, count, modelMatrices, normalMatrices);
+		break;
+	default:
+		ComputeScalar(input, 0, count, modelMatrices, normalMatrices);
+		break;
+	}
+}
+
+/*与TransformComponent::UpdateLocalMatrices相同的逐对象计算*/
+void LveTransformBatch::ComputeScalar(const Input& input, size_t begin, size_t end, glm::mat4* modelMatrices, glm::mat3* normalMatrices)
+{
+	for (size_t i = begin; i < end; i++) {
+		const float c3 = std::cos(input.rotationZ[i]);
+		const float s3 = std::sin(input.rotationZ[i]);
+		const float c2 = std::cos(input.rotationX[i]);
+		const float s2 = std::sin(input.rotationX[i]);
+		const float c1 = std::cos(input.rotationY[i]);
+		const float s1 = std::sin(input.rotationY[i]);
+
+		const float rotation[9] = {
+			c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1,
+			c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3,
+			c2 * s1, -s2, c1 * c2,
+		};
+		const float scale[3] = { input.scaleX[i], input.scaleY[i], input.scaleZ[i] };
+
+		float model[9];
+		float normal[9];
+		for (int k = 0; k < 9; k++) {
+			model[k] = scale[k / 3] * rotation[k];
+			normal[k] = (1.0f / scale[k / 3]) * rotation[k];
+		}
+		StoreMatrices(model, normal, input.translationX[i], input.translationY[i], input.translationZ[i],
+			modelMatrices[i], normalMatrices[i]);
+	}
+}
+
+#if defined(LVE_SIMD_X86)
+
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/*SSE2没有取整指令，象限用整数运算得到*/
+static inline void SinCos(__m128 x, __m128& sinOut, __m128& cosOut)
+{
+	__m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+	__m128 j = _mm_cvtepi32_ps(quadrant);
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(PI_OVER_2_A)));
+	r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(PI_OVER_2_B)));
+	r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(PI_OVER_2_C)));
+	__m128 r2 = _mm_mul_ps(r, r);
+
+	__m128 sinPoly = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(SIN_C3)), _mm_set1_ps(SIN_C2));
+	sinPoly = _mm_add_ps(_mm_mul_ps(r2, sinPoly), _mm_set1_ps(SIN_C1));
+	__m128 sinR = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sinPoly));
+
+	__m128 cosPoly = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(COS_C3)), _mm_set1_ps(COS_C2));
+	cosPoly = _mm_add_ps(_mm_mul_ps(r2, cosPoly), _mm_set1_ps(COS_C1));
+	__m128 cosR = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, _mm_set1_ps(0.5f))),
+		_mm_mul_ps(_mm_mul_ps(r2, r2), cosPoly));
+
+	/*象限q：sin依次为s, c, -s, -c；cos依次为c, -s, -c, s*/
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i two = _mm_set1_epi32(2);
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+	__m128 sinNegative = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, two), two));
+	__m128 cosNegative = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), two));
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	sinOut = _mm_xor_ps(Select(swap, cosR, sinR), _mm_and_ps(sinNegative, signBit));
+	cosOut = _mm_xor_ps(Select(swap, sinR, cosR), _mm_and_ps(cosNegative, signBit));
+}
+
+void LveTransformBatch::ComputeSSE(const Input& input, size_t count, glm::mat4* modelMatrices, glm::mat3* normalMatrices)
+{
+	const size_t simdCount = count & ~size_t(3);
+	alignas(16) float model[9][4];
+	alignas(16) float normal[9][4];
+
+	for (size_t i = 0; i < simdCount; i += 4) {
+		__m128 s1, c1, s2, c2, s3, c3;
+		SinCos(_mm_loadu_ps(input.rotationY + i), s1, c1);
+		SinCos(_mm_loadu_ps(input.rotationX + i), s2, c2);
+		SinCos(_mm_loadu_ps(input.rotationZ + i), s3, c3);
+
+		const __m128 rotation[9] = {
+			_mm_add_ps(_mm_mul_ps(c1, c3), _mm_mul_ps(_mm_mul_ps(s1, s2), s3)),
+			_mm_mul_ps(c2, s3),
+			_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(c1, s2), s3), _mm_mul_ps(c3, s1)),
+			_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(c3, s1), s2), _mm_mul_ps(c1, s3)),
+			_mm_mul_ps(c2, c3),
+			_mm_add_ps(_mm_mul_ps(_mm_mul_ps(c1, c3), s2), _mm_mul_ps(s1, s3)),
+			_mm_mul_ps(c2, s1),
+			_mm_sub_ps(_mm_setzero_ps(), s2),
+			_mm_mul_ps(c1, c2),
+		};
+		const __m128 scale[3] = {
+			_mm_loadu_ps(input.scaleX + i),
+			_mm_loadu_ps(input.scaleY + i),
+			_mm_loadu_ps(input.scaleZ + i),
+		};
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 invScale[3] = {
+			_mm_div_ps(one, scale[0]),
+			_mm_div_ps(one, scale[1]),
+			_mm_div_ps(one, scale[2]),
+		};
+		for (int k = 0; k < 9; k++) {
+			_mm_store_ps(model[k], _mm_mul_ps(scale[k / 3], rotation[k]));
+			_mm_store_ps(normal[k], _mm_mul_ps(invScale[k / 3], rotation[k]));
+		}
+
+		/*SoA转回每个对象的列主序矩阵*/
+		for (int lane = 0; lane < 4; lane++) {
+			const float laneModel[9] = {
+				model[0][lane], model[1][lane], model[2][lane], model[3][lane], model[4][lane],
+				model[5][lane], model[6][lane], model[7][lane], model[8][lane] };
+			const float laneNormal[9] = {
+				normal[0][lane], normal[1][lane], normal[2][lane], normal[3][lane], normal[4][lane],
+				normal[5][lane], normal[6][lane], normal[7][lane], normal[8][lane] };
+			size_t index = i + lane;
+			StoreMatrices(laneModel, laneNormal, input.translationX[index], input.translationY[index], input.translationZ[index],
+				modelMatrices[index], normalMatrices[index]);
+		}
+	}
+	ComputeScalar(input, simdCount, count, modelMatrices, normalMatrices);
+}
+
+LVE_TARGET_AVX static inline __m256 Select(__m256 mask, __m256 a, __m256 b)
+{
+	return _mm256_blendv_ps(b, a, mask);
+}
+
+/*AVX没有256位整数运算，象限用浮点取整与比较得到*/
+LVE_TARGET_AVX static inline void SinCos(__m256 x, __m256& sinOut, __m256& cosOut)
+{
+	__m256 j = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_sub_ps(x, _mm256_mul_ps(j, _mm256_set1_ps(PI_OVER_2_A)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(PI_OVER_2_B)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(PI_OVER_2_C)));
+	__m256 r2 = _mm256_mul_ps(r, r);
+
+	__m256 sinPoly = _mm256_add_ps(_mm256_mul_ps(r2, _mm256_set1_ps(SIN_C3)), _mm256_set1_ps(SIN_C2));
+	sinPoly = _mm256_add_ps(_mm256_mul_ps(r2, sinPoly), _mm256_set1_ps(SIN_C1));
+	__m256 sinR = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), sinPoly));
+
+	__m256 cosPoly = _mm256_add_ps(_mm256_mul_ps(r2, _mm256_set1_ps(COS_C3)), _mm256_set1_ps(COS_C2));
+	cosPoly = _mm256_add_ps(_mm256_mul_ps(r2, cosPoly), _mm256_set1_ps(COS_C1));
+	__m256 cosR = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(r2, _mm256_set1_ps(0.5f))),
+		_mm256_mul_ps(_mm256_mul_ps(r2, r2), cosPoly));
+
+	/*q = j mod 4，取值0~3*/
+	__m256 q = _mm256_sub_ps(j, _mm256_mul_ps(_mm256_set1_ps(4.0f), _mm256_floor_ps(_mm256_mul_ps(j, _mm256_set1_ps(0.25f)))));
+	__m256 swap = _mm256_or_ps(_mm256_cmp_ps(q, _mm256_set1_ps(1.0f), _CMP_EQ_OQ), _mm256_cmp_ps(q, _mm256_set1_ps(3.0f), _CMP_EQ_OQ));
+	__m256 sinNegative = _mm256_cmp_ps(q, _mm256_set1_ps(2.0f), _CMP_GE_OQ);
+	__m256 cosNegative = _mm256_or_ps(_mm256_cmp_ps(q, _mm256_set1_ps(1.0f), _CMP_EQ_OQ), _mm256_cmp_ps(q, _mm256_set1_ps(2.0f), _CMP_EQ_OQ));
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+	sinOut = _mm256_xor_ps(Select(swap, cosR, sinR), _mm256_and_ps(sinNegative, signBit));
+	cosOut = _mm256_xor_ps(Select(swap, sinR, cosR), _mm256_and_ps(cosNegative, signBit));
+}
+
+LVE_TARGET_AVX void LveTransformBatch::ComputeAVX(const Input& input, size_t count, glm::mat4* modelMatrices, glm::mat3* normalMatrices)
+{
+	const size_t simdCount = count & ~size_t(7);
+	alignas(32) float model[9][8];
+	alignas(32) float normal[9][8];
+
+	for (size_t i = 0; i < simdCount; i += 8) {
+		__m256 s1, c1, s2, c2, s3, c3;
+		SinCos(_mm256_loadu_ps(input.rotationY + i), s1, c1);
+		SinCos(_mm256_loadu_ps(input.rotationX + i), s2, c2);
+		SinCos(_mm256_loadu_ps(input.rotationZ + i), s3, c3);
+
+		const __m256 rotation[9] = {
+			_mm256_add_ps(_mm256_mul_ps(c1, c3), _mm256_mul_ps(_mm256_mul_ps(s1, s2), s3)),
+			_mm256_mul_ps(c2, s3),
+			_mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(c1, s2), s3), _mm256_mul_ps(c3, s1)),
+			_mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(c3, s1), s2), _mm256_mul_ps(c1, s3)),
+			_mm256_mul_ps(c2, c3),
+			_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(c1, c3), s2), _mm256_mul_ps(s1, s3)),
+			_mm256_mul_ps(c2, s1),
+			_mm256_sub_ps(_mm256_setzero_ps(), s2),
+			_mm256_mul_ps(c1, c2),
+		};
+		const __m256 scale[3] = {
+			_mm256_loadu_ps(input.scaleX + i),
+			_mm256_loadu_ps(input.scaleY + i),
+			_mm256_loadu_ps(input.scaleZ + i),
+		};
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 invScale[3] = {
+			_mm256_div_ps(one, scale[0]),
+			_mm256_div_ps(one, scale[1]),
+			_mm256_div_ps(one, scale[2]),
+		};
+		for (int k = 0; k < 9; k++) {
+			_mm256_store_ps(model[k], _mm256_mul_ps(scale[k / 3], rotation[k]));
+			_mm256_store_ps(normal[k], _mm256_mul_ps(invScale[k / 3], rotation[k]));
+		}
+
+		for (int lane = 0; lane < 8; lane++) {
+			const float laneModel[9] = {
+				model[0][lane], model[1][lane], model[2][lane], model[3][lane], model[4][lane],
+				model[5][lane], model[6][lane], model[7][lane], model[8][lane] };
+			const float laneNormal[9] = {
+				normal[0][lane], normal[1][lane], normal[2][lane], normal[3][lane], normal[4][lane],
+				normal[5][lane], normal[6][lane], normal[7][lane], normal[8][lane] };
+			size_t index = i + lane;
+			StoreMatrices(laneModel, laneNormal, input.translationX[index], input.translationY[index], input.translationZ[index],
+				modelMatrices[index], normalMatrices[index]);
+		}
+	}
+	ComputeScalar(input, simdCount, count, modelMatrices, normalMatrices);
+}
+
+#else
+
+void LveTransformBatch::ComputeSSE(const Input& input, size_t count, glm::mat4* modelMatrices, glm::mat3* normalMatrices)
+{
+	ComputeScalar(input, 0, count, modelMatrices, normalMatrices);
+}
+
+void LveTransformBatch::ComputeAVX(const Input& input, size_t count, glm::mat4* modelMatrices, glm::mat3* normalMatrices)
+{
+	ComputeScalar(input, 0, count, modelMatrices, normalMatrices);
+}
+
+#endif
+
+}  // namespace lve
@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include "LveSimd.h"
+
+#include <glm.hpp>
+
+#include <cstddef>
+
+namespace lve {
+
+/* TransformComponent局部矩阵的批量计算
+ * 输入为SoA的平移/旋转/缩放数组，输出每个对象的模型矩阵与法线矩阵
+ * 与TransformComponent使用同一套Tait-Bryan公式（Translate * Ry * Rx * Rz * Scale）
+ * SSE/AVX路径一次处理4/8个对象，sin/cos用多项式近似，与标量路径的误差在1e-6量级
+ */
+class LveTransformBatch {
+public:
+	struct Input {
+		const float* translationX;
+		const float* translationY;
+		const float* translationZ;
+		const float* rotationX;
+		const float* rotationY;
+		const float* rotationZ;
+		const float* scaleX;
+		const float* scaleY;
+		const float* scaleZ;
+	};
+
+	/*level不被支持时退回DetectSimdLevel的结果*/
+	static void Compute(const Input& input, size_t count, glm::mat4* modelMatrices, glm::mat3* normalMatrices,
+		LveSimdLevel level = DetectSimdLevel());
+
+private:
+	static void ComputeScalar(const Input& input, size_t begin, size_t end, glm::mat4* modelMatrices, glm::mat3* normalMatrices);
+	static void ComputeSSE(const Input& input, size_t count, glm::mat4* modelMatrices, glm::mat3* normalMatrices);
+	static void ComputeAVX(const Input& input, size_t count, glm::mat4* modelMatrices, glm::mat3* normalMatrices);
+};
+
+}  // namespace lve
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 
 namespace lve {
@@ -10,4 +12,14 @@ void HashCombine(std::size_t& seed, const T& v, const Rest&... rest) {
 	(HashCombine(seed, rest), ...);
 }
 
+/*FNV-1a 64位哈希，用于磁盘缓存的内容校验，结果与平台和标准库实现无关*/
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i) {
+		seed ^= bytes[i];
+		seed *= 0x100000001b3ull;
+	}
+	return seed;
+}
+
 }
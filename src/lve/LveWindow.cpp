@@ -13,7 +13,7 @@
 namespace lve {
 
     LveWindow::LveWindow(void* nativeWindowHandle, void* nativeInstanceHandle, int w, int h, std::string name)
-        : m_hwnd{ nativeWindowHandle }, m_hinstance{ nativeInstanceHandle }, m_width{ w }, m_height{ h }, m_windowName{ name }
+        : m_hwnd{ nativeWindowHandle }, m_hinstance{ nativeInstanceHandle }, m_extent{ PackExtent(w, h) }, m_windowName{ name }
     {
     }
 
@@ -2,6 +2,8 @@
 
 #define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
 #include <string>
 
 namespace lve {
@@ -14,22 +16,33 @@ namespace lve {
 		LveWindow(const LveWindow&) = delete;
 		LveWindow& operator=(const LveWindow&) = delete;
 
-		VkExtent2D GetExtent() { return { static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height) }; }
-		bool WasWindowResized() { return m_framebufferResized; }
-		void ResetWindowResizedFlag() { m_framebufferResized = false; }
+		/*宽高打包在一个原子量里，渲染线程读到的总是同一次通知的尺寸*/
+		VkExtent2D GetExtent() {
+			uint64_t extent = m_extent.load(std::memory_order_acquire);
+			return { static_cast<uint32_t>(extent >> 32), static_cast<uint32_t>(extent) };
+		}
+		bool WasWindowResized() { return m_framebufferResized.load(std::memory_order_acquire); }
+		void ResetWindowResizedFlag() { m_framebufferResized.store(false, std::memory_order_release); }
 
 		void CreateWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
 
-		void NotifyResized(int w, int h) {m_width = w; m_height = h; m_framebufferResized = true;}
+		/*由GUI线程调用，可与渲染线程并发*/
+		void NotifyResized(int w, int h) {
+			m_extent.store(PackExtent(w, h), std::memory_order_release);
+			m_framebufferResized.store(true, std::memory_order_release);
+		}
 
 	private:
 		// static void framebufferResizeCallback(GLFWwindow* m_window, int width, int height);
 
+		static uint64_t PackExtent(int w, int h) {
+			return (static_cast<uint64_t>(static_cast<uint32_t>(w)) << 32) | static_cast<uint32_t>(h);
+		}
+
 		void* m_hwnd;
 		void* m_hinstance;
-		int m_width;
-		int m_height;
-		bool m_framebufferResized = false;
+		std::atomic<uint64_t> m_extent;	// 高32位宽，低32位高
+		std::atomic<bool> m_framebufferResized{ false };
 
 		std::string m_windowName;
 	};
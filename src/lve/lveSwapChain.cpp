@@ -12,14 +12,14 @@
 
 namespace lve {
 
-LveSwapChain::LveSwapChain(LveDevice &deviceRef, VkExtent2D extent)
-    : m_device{deviceRef}, m_windowExtent{extent}
+LveSwapChain::LveSwapChain(LveDevice &deviceRef, VkExtent2D extent, bool deferred)
+    : m_deferred{deferred}, m_device{deviceRef}, m_windowExtent{extent}
 {
     Init();
 }
 
-LveSwapChain::LveSwapChain(LveDevice& deviceRef, VkExtent2D extent, std::shared_ptr<LveSwapChain> previous)
-    : m_device{ deviceRef }, m_windowExtent{ extent }, m_oldSwapChain{ previous }
+LveSwapChain::LveSwapChain(LveDevice& deviceRef, VkExtent2D extent, std::shared_ptr<LveSwapChain> previous, bool deferred)
+    : m_deferred{ deferred }, m_device{ deviceRef }, m_windowExtent{ extent }, m_oldSwapChain{ previous }
 {
     Init();
 
@@ -27,20 +27,30 @@ LveSwapChain::LveSwapChain(LveDevice& deviceRef, VkExtent2D extent, std::shared_
     m_oldSwapChain = nullptr;
 }
 
+/*延迟渲染的光照子通道以输入附件读取G-buffer，依赖子通道，始终使用RenderPass*/
 void LveSwapChain::Init()
 {
+    m_dynamicRendering = !m_deferred && m_device.dynamicRenderingEnabled();
+
     CreateSwapChain();
     CreateImageViews();
-    CreateRenderPass();
+    if (!m_dynamicRendering) {
+        CreateRenderPass();
+    }
     CreateDepthResources();
-    CreateFramebuffers();
+    if (m_deferred) {
+        CreateGBufferResources();
+    }
+    if (!m_dynamicRendering) {
+        CreateFramebuffers();
+    }
     CreateSyncObjects();
 }
 
 LveSwapChain::~LveSwapChain() 
 {
     // 1) 等所有在飞的提交结束，防止销毁同步对象/资源时仍被使用
-    vkDeviceWaitIdle(m_device.device());
+    m_device.waitIdle();
 
     // 2) 先销毁同步对象
     // 2.1 每帧的：imageAvailable + inFlight fences
@@ -63,15 +73,16 @@ LveSwapChain::~LveSwapChain()
     }
     m_swapChainFramebuffers.clear();
 
-    // 深度资源（image view → image → memory）
+    // 深度资源（image view → image + allocation）
     for (size_t i = 0; i < m_depthImages.size(); ++i) {
         if (m_depthImageViews[i]) vkDestroyImageView(m_device.device(), m_depthImageViews[i], nullptr);
-        if (m_depthImages[i])     vkDestroyImage(m_device.device(), m_depthImages[i], nullptr);
-        if (m_depthImageMemorys[i]) vkFreeMemory(m_device.device(), m_depthImageMemorys[i], nullptr);
+        if (m_depthImages[i])     vmaDestroyImage(m_device.allocator(), m_depthImages[i], m_depthImageAllocations[i]);
     }
     m_depthImageViews.clear();
     m_depthImages.clear();
-    m_depthImageMemorys.clear();
+    m_depthImageAllocations.clear();
+    DestroyGBufferImage(m_gbufferAlbedo);
+    DestroyGBufferImage(m_gbufferNormal);
 
     // 颜色附件的 image views（来自 swapchain images）
     for (auto view : m_swapChainImageViews) {
@@ -139,6 +150,7 @@ VkResult LveSwapChain::SubmitCommandBuffers(const VkCommandBuffer *buffers, uint
     submitInfo.pSignalSemaphores = signalSemaphores;
 
     vkResetFences(m_device.device(), 1, &m_inFlightFences[m_currentFrame]);
+    auto queueLock = m_device.lockQueue(m_device.graphicsQueue());  // 提交与呈现都在锁内
     if (vkQueueSubmit(m_device.graphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
@@ -244,6 +256,11 @@ void LveSwapChain::CreateImageViews()
 
 void LveSwapChain::CreateRenderPass() 
 {
+    if (m_deferred) {
+        CreateDeferredRenderPass();
+        return;
+    }
+
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format = FindDepthFormat();
     depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -304,11 +321,18 @@ void LveSwapChain::CreateRenderPass()
     }
 }
 
+/* 附件顺序：0 交换链图像，1 深度，延迟模式下 2 反照率，3 法线
+ * 延迟模式的深度和G-buffer所有帧缓冲共享一份
+ */
 void LveSwapChain::CreateFramebuffers() 
 {
     m_swapChainFramebuffers.resize(ImageCount());
     for (size_t i = 0; i < ImageCount(); i++) {
-        std::array<VkImageView, 2> attachments = { m_swapChainImageViews[i], m_depthImageViews[i]};
+        std::vector<VkImageView> attachments = { m_swapChainImageViews[i], m_depthImageViews[m_deferred ? 0 : i] };
+        if (m_deferred) {
+            attachments.push_back(m_gbufferAlbedo.view);
+            attachments.push_back(m_gbufferNormal.view);
+        }
 
         VkExtent2D swapChainExtent = GetSwapChainExtent();
         VkFramebufferCreateInfo framebufferInfo = {};
@@ -336,9 +360,11 @@ void LveSwapChain::CreateDepthResources()
     m_swapChainDepthFormat = depthFormat;
     VkExtent2D swapChainExtent = GetSwapChainExtent();
 
-    m_depthImages.resize(ImageCount());
-    m_depthImageMemorys.resize(ImageCount());
-    m_depthImageViews.resize(ImageCount());
+    /*延迟模式下深度还要被光照子通道作为输入附件读取，只在RenderPass内有效，和G-buffer一样共享一份*/
+    size_t depthCount = m_deferred ? 1 : ImageCount();
+    m_depthImages.resize(depthCount);
+    m_depthImageAllocations.resize(depthCount);
+    m_depthImageViews.resize(depthCount);
 
     for (int i = 0; i < m_depthImages.size(); i++) {
         VkImageCreateInfo imageInfo{};
@@ -353,6 +379,9 @@ void LveSwapChain::CreateDepthResources()
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        if (m_deferred) {
+            imageInfo.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
         imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageInfo.flags = 0;
@@ -361,7 +390,7 @@ void LveSwapChain::CreateDepthResources()
             imageInfo,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             m_depthImages[i],
-            m_depthImageMemorys[i]);
+            m_depthImageAllocations[i]);
 
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -380,6 +409,174 @@ void LveSwapChain::CreateDepthResources()
     }
 }
 
+/* 两个子通道：
+ * 0 几何：反照率、法线写入颜色附件2/3，深度写入附件1
+ * 1 光照：附件1/2/3作为输入附件读取，输出到交换链图像；深度保持只读绑定，供点光源公告板做深度测试
+ * G-buffer和深度的内容在RenderPass结束后丢弃（storeOp DONT_CARE），在分块渲染的GPU上不会写回显存
+ */
+void LveSwapChain::CreateDeferredRenderPass()
+{
+    std::array<VkAttachmentDescription, 4> attachments{};
+
+    VkAttachmentDescription& colorAttachment = attachments[0];
+    colorAttachment.format = GetSwapChainImageFormat();
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentDescription& depthAttachment = attachments[1];
+    depthAttachment.format = FindDepthFormat();
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    const VkFormat gbufferFormats[] = { GBUFFER_ALBEDO_FORMAT, GBUFFER_NORMAL_FORMAT };
+    for (int i = 0; i < 2; i++) {
+        VkAttachmentDescription& gbufferAttachment = attachments[2 + i];
+        gbufferAttachment.format = gbufferFormats[i];
+        gbufferAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        gbufferAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        gbufferAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        gbufferAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        gbufferAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        gbufferAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        gbufferAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    /*几何子通道*/
+    std::array<VkAttachmentReference, 2> gbufferOutputRefs = { {
+        { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+        { 3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+    } };
+    VkAttachmentReference depthWriteRef{ 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+    /*光照子通道，输入附件下标与deferred_lighting.frag的input_attachment_index一致*/
+    std::array<VkAttachmentReference, 3> gbufferInputRefs = { {
+        { 2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { 3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL },
+    } };
+    VkAttachmentReference colorRef{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkAttachmentReference depthReadRef{ 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+
+    std::array<VkSubpassDescription, 2> subpasses{};
+    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[0].colorAttachmentCount = static_cast<uint32_t>(gbufferOutputRefs.size());
+    subpasses[0].pColorAttachments = gbufferOutputRefs.data();
+    subpasses[0].pDepthStencilAttachment = &depthWriteRef;
+
+    subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[1].inputAttachmentCount = static_cast<uint32_t>(gbufferInputRefs.size());
+    subpasses[1].pInputAttachments = gbufferInputRefs.data();
+    subpasses[1].colorAttachmentCount = 1;
+    subpasses[1].pColorAttachments = &colorRef;
+    subpasses[1].pDepthStencilAttachment = &depthReadRef;
+
+    std::array<VkSubpassDependency, 2> dependencies{};
+    /*G-buffer被所有帧共享：上一帧光照子通道读取完成之前不能开始写入*/
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+        | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+        | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+        | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    /*几何写入 → 光照子通道按像素读取*/
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = 1;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+
+    if (vkCreateRenderPass(m_device.device(), &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create deferred render pass!");
+    }
+}
+
+void LveSwapChain::CreateGBufferResources()
+{
+    CreateGBufferImage(GBUFFER_ALBEDO_FORMAT, m_gbufferAlbedo);
+    CreateGBufferImage(GBUFFER_NORMAL_FORMAT, m_gbufferNormal);
+}
+
+/*瞬态附件：只作为颜色附件和输入附件使用，内存由LveDevice优先放在延迟分配的内存类型中*/
+void LveSwapChain::CreateGBufferImage(VkFormat format, GBufferImage& target)
+{
+    VkExtent2D swapChainExtent = GetSwapChainExtent();
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = swapChainExtent.width;
+    imageInfo.extent.height = swapChainExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags = 0;
+
+    m_device.createImageWithInfo(
+        imageInfo,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        target.image,
+        target.allocation);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = target.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(m_device.device(), &viewInfo, nullptr, &target.view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create G-buffer image view!");
+    }
+}
+
+void LveSwapChain::DestroyGBufferImage(GBufferImage& target)
+{
+    if (target.view) vkDestroyImageView(m_device.device(), target.view, nullptr);
+    if (target.image) vmaDestroyImage(m_device.allocator(), target.image, target.allocation);
+    target = {};
+}
+
+GBufferViews LveSwapChain::GetGBufferViews() const
+{
+    assert(m_deferred && "G-buffer only exists in deferred mode");
+    return { m_gbufferAlbedo.view, m_gbufferNormal.view, m_depthImageViews[0] };
+}
+
 void LveSwapChain::CreateSyncObjects() 
 {
     // 按帧：Acquire 阶段信号量 + Fences
@@ -12,12 +12,26 @@
 
 namespace lve {
 
+/*延迟渲染的G-buffer附件视图，所有帧缓冲共享同一份*/
+struct GBufferViews {
+    VkImageView albedo = VK_NULL_HANDLE;
+    VkImageView normal = VK_NULL_HANDLE;
+    VkImageView depth = VK_NULL_HANDLE;
+};
+
 class LveSwapChain {
 public:
     static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-    LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent);
-    LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent, std::shared_ptr<LveSwapChain> previous);
+    static constexpr VkFormat GBUFFER_ALBEDO_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+    static constexpr VkFormat GBUFFER_NORMAL_FORMAT = VK_FORMAT_A2B10G10R10_UNORM_PACK32;   // 世界空间法线映射到[0, 1]
+
+    /* deferred为true时创建两个子通道的RenderPass：
+     * 子通道0把反照率、法线、深度写入G-buffer，子通道1以输入附件读取G-buffer做光照并输出到交换链图像
+     * G-buffer只在RenderPass内存活，使用瞬态附件，设备支持时放在延迟分配的内存中
+     * 前向渲染且设备支持VK_KHR_dynamic_rendering时不创建RenderPass与帧缓冲，由LveRenderer用动态渲染录制
+     */
+    LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent, bool deferred = false);
+    LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent, std::shared_ptr<LveSwapChain> previous, bool deferred = false);
     ~LveSwapChain();
 
     LveSwapChain(const LveSwapChain &) = delete;
@@ -25,7 +39,11 @@ public:
 
     VkFramebuffer GetFrameBuffer(int index) { return m_swapChainFramebuffers[index]; }
     VkRenderPass GetRenderPass() { return m_renderPass; }
+    VkImage GetImage(int index) { return m_swapChainImages[index]; }
     VkImageView GetImageView(int index) { return m_swapChainImageViews[index]; }
+    VkImage GetDepthImage(int index) { return m_depthImages[index]; }
+    VkImageView GetDepthImageView(int index) { return m_depthImageViews[index]; }
+    VkFormat GetSwapChainDepthFormat() const { return m_swapChainDepthFormat; }
     size_t ImageCount() { return m_swapChainImages.size(); }
     VkFormat GetSwapChainImageFormat() { return m_swapChainImageFormat; }
     VkExtent2D GetSwapChainExtent() { return m_swapChainExtent; }
@@ -35,21 +53,36 @@ public:
     return static_cast<float>(m_swapChainExtent.width) / static_cast<float>(m_swapChainExtent.height);
     }
 
+    bool IsDeferred() const { return m_deferred; }
+    bool UsesDynamicRendering() const { return m_dynamicRendering; }
+    GBufferViews GetGBufferViews() const;
+
     VkFormat FindDepthFormat();
     VkResult AcquireNextImage(uint32_t *imageIndex);
     VkResult SubmitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
 
     bool CompareSwapFormats(const LveSwapChain& swapChain) const {
         return swapChain.m_swapChainDepthFormat == m_swapChainDepthFormat
-            && swapChain.m_swapChainImageFormat == m_swapChainImageFormat;
+            && swapChain.m_swapChainImageFormat == m_swapChainImageFormat
+            && swapChain.m_deferred == m_deferred;
     }
 
 private:
+    struct GBufferImage {
+        VkImage image = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+    };
+
     void Init();
     void CreateSwapChain();
     void CreateImageViews();
     void CreateDepthResources();
     void CreateRenderPass();
+    void CreateDeferredRenderPass();
+    void CreateGBufferResources();
+    void CreateGBufferImage(VkFormat format, GBufferImage& target);
+    void DestroyGBufferImage(GBufferImage& target);
     void CreateFramebuffers();
     void CreateSyncObjects();
 
@@ -65,11 +98,17 @@ private:
     VkExtent2D m_swapChainExtent;
 
     std::vector<VkFramebuffer> m_swapChainFramebuffers;
-    VkRenderPass m_renderPass;
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;     // 动态渲染时为空
 
     std::vector<VkImage> m_depthImages;
-    std::vector<VkDeviceMemory> m_depthImageMemorys;
+    std::vector<VmaAllocation> m_depthImageAllocations;
     std::vector<VkImageView> m_depthImageViews;
+
+    bool m_deferred = false;
+    bool m_dynamicRendering = false;
+    GBufferImage m_gbufferAlbedo{};
+    GBufferImage m_gbufferNormal{};
+
     std::vector<VkImage> m_swapChainImages;
     std::vector<VkImageView> m_swapChainImageViews;
 
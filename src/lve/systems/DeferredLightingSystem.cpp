@@ -0,0 +1,109 @@
+﻿#include "DeferredLightingSystem.h"
+
+#include "LveLayoutCache.h"
+#include "LveShaderCompiler.h"
+#include "LveSwapChain.h"
+
+#include <stdexcept>
+
+namespace lve {
+
+DeferredLightingSystem::DeferredLightingSystem(LveDevice& device, LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, LveDescriptorSetLayout& globalSetLayout,
+    const LightingSpecializations& lighting)
+    : m_lveDevice(device)
+{
+    CreatePipelineLayout(globalSetLayout);
+    m_gbufferPool = LveDescriptorPool::Builder(m_lveDevice)
+        .SetMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .AddPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .Build();
+    m_frameSets.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+    CreatePipelines(pipelineQueue, renderPass, lighting);
+}
+
+/* set 0为全局UBO与点光源，set 1为G-buffer输入附件（反照率、法线、深度）
+ * 布局由deferred_lighting.vert/.frag反射得到
+ */
+void DeferredLightingSystem::CreatePipelineLayout(LveDescriptorSetLayout& globalSetLayout)
+{
+    const LveLayoutCache::PipelineLayout& layout = m_lveDevice.layoutCache().GetPipelineLayout(
+        { LveShaderCompiler::ShaderPath("deferred_lighting.vert"), LveShaderCompiler::ShaderPath("deferred_lighting.frag") },
+        { { 0, &globalSetLayout } });
+    assert(layout.setLayouts.size() == 2 && layout.setLayouts[1]->GetBindings().size() == 3 &&
+        "deferred lighting shaders no longer match the expected layout");
+    m_pipelineLayout = layout.pipelineLayout;
+    m_gbufferSetLayout = layout.setLayouts[1];
+}
+
+void DeferredLightingSystem::CreatePipelines(LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, const LightingSpecializations& lighting)
+{
+    assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+    /*全屏三角形：无顶点输入，不做深度测试*/
+    PipelineConfigInfo pipelineConfig{};
+    LvePipeline::DefaultPipelineConfigInfo(pipelineConfig);
+    pipelineConfig.attributeDescriptions.clear();
+    pipelineConfig.bindingDescriptions.clear();
+    pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+    pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.subpass = 1;
+    pipelineConfig.pipelineLayout = m_pipelineLayout;
+    pipelineConfig.specialization = lighting.base;
+    pipelineConfig.variants = lighting.variants;
+    pipelineQueue.Enqueue(
+        LveShaderCompiler::ShaderPath("deferred_lighting.vert"),
+        LveShaderCompiler::ShaderPath("deferred_lighting.frag"),
+        pipelineConfig,
+        m_lvePipeline);
+}
+
+/*BeginFrame已等待本帧的fence，本帧的描述符集不再被GPU使用，可以原地重写*/
+void DeferredLightingSystem::UpdateGBufferSet(int frameIndex, const LveRenderer& renderer)
+{
+    FrameGBufferSet& frame = m_frameSets[frameIndex];
+    if (frame.descriptorSet != VK_NULL_HANDLE && frame.swapChainGeneration == renderer.GetSwapChainGeneration()) {
+        return;
+    }
+
+    GBufferViews views = renderer.GetGBufferViews();
+    VkDescriptorImageInfo albedoInfo{ VK_NULL_HANDLE, views.albedo, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    VkDescriptorImageInfo normalInfo{ VK_NULL_HANDLE, views.normal, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    VkDescriptorImageInfo depthInfo{ VK_NULL_HANDLE, views.depth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+
+    LveDescriptorWriter writer(*m_gbufferSetLayout, *m_gbufferPool);
+    writer.WriteImage(0, &albedoInfo)
+        .WriteImage(1, &normalInfo)
+        .WriteImage(2, &depthInfo);
+    if (frame.descriptorSet == VK_NULL_HANDLE) {
+        writer.Build(frame.descriptorSet);
+    }
+    else {
+        writer.Overwrite(frame.descriptorSet);
+    }
+    frame.swapChainGeneration = renderer.GetSwapChainGeneration();
+}
+
+void DeferredLightingSystem::Render(FrameInfo& frameInfo, const LveRenderer& renderer)
+{
+    UpdateGBufferSet(frameInfo.frameIndex, renderer);
+
+    m_lvePipeline->Bind(frameInfo.commandBuffer, frameInfo.lightingVariant);
+
+    /*set 0已由在set 0上兼容的布局绑定时只绑定set 1*/
+    uint32_t firstSet = m_lveDevice.layoutCache().IsCompatible(frameInfo.boundGlobalLayout, m_pipelineLayout, 0) ? 1 : 0;
+    VkDescriptorSet descriptorSets[] = { frameInfo.globalDescriptorSet, m_frameSets[frameInfo.frameIndex].descriptorSet };
+    vkCmdBindDescriptorSets(frameInfo.commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        m_pipelineLayout,
+        firstSet,
+        2 - firstSet,
+        descriptorSets + firstSet,
+        0,
+        nullptr);
+    frameInfo.boundGlobalLayout = m_pipelineLayout;
+    vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+}
+
+}  // namespace lve
@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include "LvePipeline.h"
+#include "LvePipelineQueue.h"
+#include "LveDevice.h"
+#include "LveFrameInfo.h"
+#include "LveDescriptors.h"
+#include "LveRenderer.h"
+
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+/* 延迟渲染的光照子通道
+ * 全屏三角形以输入附件读取G-buffer（反照率、法线、深度），按像素计算点光源光照，
+ * 光源列表与前向路径共用全局描述符集（包括分簇结果）
+ */
+class DeferredLightingSystem {
+public:
+	DeferredLightingSystem(LveDevice& device, LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, LveDescriptorSetLayout& globalSetLayout,
+		const LightingSpecializations& lighting);
+
+	DeferredLightingSystem(const DeferredLightingSystem&) = delete;
+	DeferredLightingSystem& operator=(const DeferredLightingSystem&) = delete;
+
+	/*在LveRenderer::NextSubpass之后调用*/
+	void Render(FrameInfo& frameInfo, const LveRenderer& renderer);
+
+private:
+	void CreatePipelineLayout(LveDescriptorSetLayout& globalSetLayout);
+	void CreatePipelines(LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, const LightingSpecializations& lighting);
+	/*交换链重建后G-buffer视图改变，本帧的输入附件描述符集需要重写*/
+	void UpdateGBufferSet(int frameIndex, const LveRenderer& renderer);
+
+	/*每帧一个输入附件描述符集，记录写入时的交换链版本*/
+	struct FrameGBufferSet {
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		uint32_t swapChainGeneration = 0;
+	};
+
+	LveDevice& m_lveDevice;
+
+	std::unique_ptr<LvePipeline> m_lvePipeline;
+	VkPipelineLayout m_pipelineLayout;	// 由LveLayoutCache反射生成并持有
+	LveDescriptorSetLayout* m_gbufferSetLayout = nullptr;	// deferred_lighting.frag的set 1（输入附件）
+	std::unique_ptr<LveDescriptorPool> m_gbufferPool;
+	std::vector<FrameGBufferSet> m_frameSets;
+};
+
+}  // namespace lve
@@ -0,0 +1,153 @@
+﻿#include "LightClusterSystem.h"
+
+#include "LveLayoutCache.h"
+#include "LveShaderCompiler.h"
+#include "LveSwapChain.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace lve {
+
+static constexpr uint32_t CLUSTER_WORKGROUP_SIZE = 64;
+
+LightClusterSystem::LightClusterSystem(LveDevice& device, LvePipelineQueue& pipelineQueue, LveDescriptorSetLayout& globalSetLayout)
+    : m_lveDevice(device)
+{
+    CreatePipelineLayout(globalSetLayout);
+    pipelineQueue.EnqueueCompute(LveShaderCompiler::ShaderPath("light_cluster.comp"), m_pipelineLayout, m_clusterPipeline);
+    CreateClusterBuffers();
+}
+
+/*计算着色器只使用全局描述符集：UBO、点光源与两个输出缓冲区*/
+void LightClusterSystem::CreatePipelineLayout(LveDescriptorSetLayout& globalSetLayout)
+{
+    const LveLayoutCache::PipelineLayout& layout = m_lveDevice.layoutCache().GetPipelineLayout(
+        { LveShaderCompiler::ShaderPath("light_cluster.comp") },
+        { { 0, &globalSetLayout } });
+    assert(layout.setLayouts.size() == 1 && layout.pushConstantRanges.empty() && "light_cluster.comp no longer matches the expected layout");
+    m_pipelineLayout = layout.pipelineLayout;
+}
+
+/* 每簇固定MAX_LIGHTS_PER_CLUSTER个槽位，分配下标不需要全局计数器，大小与光源数量无关
+ * 数量缓冲区末尾的溢出计数每帧清零，分簇后复制到主机可见的读回缓冲区
+ */
+void LightClusterSystem::CreateClusterBuffers()
+{
+    m_lightCountBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+    m_lightIndexBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+    m_overflowReadbacks.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < LveSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+        m_lightCountBuffers[i] = std::make_unique<LveBuffer>(
+            m_lveDevice,
+            sizeof(uint32_t),
+            CLUSTER_COUNT + 1,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        m_overflowReadbacks[i] = std::make_unique<LveBuffer>(
+            m_lveDevice,
+            sizeof(uint32_t),
+            1,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        m_overflowReadbacks[i]->Map();
+        std::memset(m_overflowReadbacks[i]->GetMappedMemory(), 0, sizeof(uint32_t));
+        m_lightIndexBuffers[i] = std::make_unique<LveBuffer>(
+            m_lveDevice,
+            sizeof(uint32_t),
+            CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+}
+
+VkDescriptorBufferInfo LightClusterSystem::GetLightCountInfo(int frameIndex) const
+{
+    return m_lightCountBuffers[frameIndex]->DescriptorInfo();
+}
+
+VkDescriptorBufferInfo LightClusterSystem::GetLightIndexInfo(int frameIndex) const
+{
+    return m_lightIndexBuffers[frameIndex]->DescriptorInfo();
+}
+
+/* 深度切片按对数均匀划分：slice = log(z / near) / log(far / near) * GRID_Z
+ * 展开为 log(z) * scale + bias，片段着色器和计算着色器共用
+ */
+void LightClusterSystem::Update(FrameInfo& frameInfo, GlobalUbo& ubo, VkExtent2D extent)
+{
+    if (extent.width == 0 || extent.height == 0) {
+        ubo.clusterGrid = glm::uvec4(0);
+        return;
+    }
+
+    /*屏幕尺寸的倒数在关闭分簇时也写入，延迟光照用它从gl_FragCoord重建位置*/
+    float nearClip = frameInfo.camera.GetNearClip();
+    float farClip = frameInfo.camera.GetFarClip();
+    float logDepthRange = std::log(farClip / nearClip);
+
+    ubo.clusterGrid = m_enabled ? glm::uvec4(GRID_X, GRID_Y, GRID_Z, MAX_LIGHTS_PER_CLUSTER) : glm::uvec4(0);
+    ubo.clusterParams = glm::vec4(
+        GRID_Z / logDepthRange,
+        -GRID_Z * std::log(nearClip) / logDepthRange,
+        1.f / extent.width,
+        1.f / extent.height);
+}
+
+void LightClusterSystem::BuildClusters(FrameInfo& frameInfo)
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    /*BeginFrame已等待过本帧的fence，上一次复制的溢出计数可以直接读取；计数从0变为非0时警告一次*/
+    uint32_t overflow = *static_cast<const uint32_t*>(m_overflowReadbacks[frameInfo.frameIndex]->GetMappedMemory());
+    if (overflow > 0 && m_overflowCount == 0) {
+        std::cerr << "LightClusterSystem: " << overflow << " light assignments dropped, more than "
+            << MAX_LIGHTS_PER_CLUSTER << " lights per cluster\n";
+    }
+    m_overflowCount = overflow;
+
+    VkBuffer countBuffer = m_lightCountBuffers[frameInfo.frameIndex]->GetBuffer();
+    const VkDeviceSize overflowOffset = CLUSTER_COUNT * sizeof(uint32_t);
+    vkCmdFillBuffer(frameInfo.commandBuffer, countBuffer, overflowOffset, sizeof(uint32_t), 0);
+
+    VkMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(frameInfo.commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    m_clusterPipeline->Bind(frameInfo.commandBuffer);
+    vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout,
+        0, 1, &frameInfo.globalDescriptorSet, 0, nullptr);
+    vkCmdDispatch(frameInfo.commandBuffer, (CLUSTER_COUNT + CLUSTER_WORKGROUP_SIZE - 1) / CLUSTER_WORKGROUP_SIZE, 1, 1);
+
+    /*分簇结果供本帧的片段着色器读取，溢出计数复制到读回缓冲区*/
+    VkMemoryBarrier clusterBarrier{};
+    clusterBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clusterBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    clusterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(frameInfo.commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &clusterBarrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = overflowOffset;
+    copyRegion.size = sizeof(uint32_t);
+    vkCmdCopyBuffer(frameInfo.commandBuffer, countBuffer, m_overflowReadbacks[frameInfo.frameIndex]->GetBuffer(), 1, &copyRegion);
+
+    VkMemoryBarrier readbackBarrier{};
+    readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(frameInfo.commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+}
+
+}  // namespace lve
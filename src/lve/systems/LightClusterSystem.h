@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include "LvePipeline.h"
+#include "LvePipelineQueue.h"
+#include "LveDevice.h"
+#include "LveFrameInfo.h"
+#include "LveBuffer.h"
+#include "LveDescriptors.h"
+
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+/* 分簇前向光照
+ * 视图空间按屏幕tile（GRID_X x GRID_Y）和指数深度切片（GRID_Z）划分成簇，
+ * 每帧在RenderPass之前用计算着色器把点光源按影响半径分配到各簇，
+ * shader.frag只遍历片段所在簇的光源列表
+ * 输出缓冲区作为全局描述符集的binding 2（每簇数量）和binding 3（每簇光源下标）
+ */
+class LightClusterSystem {
+public:
+	static constexpr uint32_t GRID_X = 16;
+	static constexpr uint32_t GRID_Y = 9;
+	static constexpr uint32_t GRID_Z = 24;
+	static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+	static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;	// 超出的光源在该簇中被忽略，并计入溢出计数
+
+	LightClusterSystem(LveDevice& device, LvePipelineQueue& pipelineQueue, LveDescriptorSetLayout& globalSetLayout);
+
+	LightClusterSystem(const LightClusterSystem&) = delete;
+	LightClusterSystem& operator=(const LightClusterSystem&) = delete;
+
+	/*写入全局描述符集binding 2/3的缓冲区*/
+	VkDescriptorBufferInfo GetLightCountInfo(int frameIndex) const;
+	VkDescriptorBufferInfo GetLightIndexInfo(int frameIndex) const;
+
+	/*关闭后shader.frag逐片段遍历所有点光源，用于对比*/
+	void SetEnabled(bool enabled) { m_enabled = enabled; }
+	bool IsEnabled() const { return m_enabled; }
+
+	/*把分簇参数写入ubo，需在ubo上传之前调用*/
+	void Update(FrameInfo& frameInfo, GlobalUbo& ubo, VkExtent2D extent);
+	/* 在BeginSwapChainRenderPass之前录制分簇计算，ubo与点光源缓冲区需已写好
+	 * 同时读回本帧槽位上一次分簇时被丢弃的光源数，不为0时打印警告
+	 */
+	void BuildClusters(FrameInfo& frameInfo);
+	/*最近一次读回的溢出数：因簇已满被丢弃的（簇，光源）对数量*/
+	uint32_t GetOverflowCount() const { return m_overflowCount; }
+
+private:
+	void CreatePipelineLayout(LveDescriptorSetLayout& globalSetLayout);
+	void CreateClusterBuffers();
+
+	LveDevice& m_lveDevice;
+
+	VkPipelineLayout m_pipelineLayout;	// 由LveLayoutCache反射生成并持有
+	std::unique_ptr<LveComputePipeline> m_clusterPipeline;
+	std::vector<std::unique_ptr<LveBuffer>> m_lightCountBuffers;	// 每帧一份，只由GPU读写；末尾多一个溢出计数
+	std::vector<std::unique_ptr<LveBuffer>> m_lightIndexBuffers;
+	std::vector<std::unique_ptr<LveBuffer>> m_overflowReadbacks;	// 每帧一份，溢出计数复制到这里供CPU在fence之后读取
+	uint32_t m_overflowCount = 0;
+	bool m_enabled = true;
+};
+
+}  // namespace lve
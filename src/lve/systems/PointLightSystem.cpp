@@ -6,62 +6,114 @@
 #include <glm.hpp>
 #include <gtc/constants.hpp>
 
+#include "LveLayoutCache.h"
+#include "LveShaderCompiler.h"
+#include "LveSwapChain.h"
+
+#include <algorithm>
 #include <stdexcept>
 #include <array>
+#include <cstring>
 #include <iostream>
-#include <map>
 
 namespace lve {
 
-struct PointLightPushConstants {
-    glm::vec4 position{};
-    glm::vec4 color{};
-    float radius;
+/*与point_light.vert中的LightInstance一致（std430）*/
+struct PointLightInstance {
+    glm::vec4 position{};   // w：公告板半径
+    glm::vec4 color{};      // w：强度
 };
 
-PointLightSystem::PointLightSystem(LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
+static constexpr uint32_t MIN_INSTANCE_CAPACITY = 64;
+
+/* 按高32位升序的LSD基数排序，每轮8位共4轮，相同的键保持原有顺序
+ * items与scratch交替作为输入输出，偶数轮结束后结果回到items
+ */
+static void RadixSortByHighWord(std::vector<uint64_t>& items, std::vector<uint64_t>& scratch)
+{
+    scratch.resize(items.size());
+    for (int shift = 32; shift < 64; shift += 8) {
+        size_t offsets[256] = {};
+        for (uint64_t item : items) {
+            offsets[(item >> shift) & 0xff]++;
+        }
+        size_t sum = 0;
+        for (size_t& offset : offsets) {
+            size_t count = offset;
+            offset = sum;
+            sum += count;
+        }
+        for (uint64_t item : items) {
+            scratch[offsets[(item >> shift) & 0xff]++] = item;
+        }
+        items.swap(scratch);
+    }
+}
+
+PointLightSystem::PointLightSystem(LveDevice& device, LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, LveDescriptorSetLayout& globalSetLayout, uint32_t subpass)
     : m_lveDevice(device)
 {
     CreatePipelineLayout(globalSetLayout); // 定义渲染管线的layout
-    CreatePipelines(renderPass);
+    CreateInstanceBuffers();
+    CreatePipelines(pipelineQueue, renderPass, subpass);
 }
 
-PointLightSystem::~PointLightSystem()
+/* 布局由着色器反射得到：set 0为全局描述符集（只校验），set 1为公告板实例缓冲区
+ * 与RenderSystem的组成相同时共用同一个VkPipelineLayout
+ */
+void PointLightSystem::CreatePipelineLayout(LveDescriptorSetLayout& globalSetLayout)
 {
-    vkDestroyPipelineLayout(m_lveDevice.device(), m_pipelineLayout, nullptr);
+    const LveLayoutCache::PipelineLayout& layout = m_lveDevice.layoutCache().GetPipelineLayout(
+        { LveShaderCompiler::ShaderPath("point_light.vert"), LveShaderCompiler::ShaderPath("point_light.frag") },
+        { { 0, &globalSetLayout } });
+    assert(layout.setLayouts.size() == 2 && layout.pushConstantRanges.empty() && "point light shaders no longer match the expected layout");
+    m_pipelineLayout = layout.pipelineLayout;
+    m_instanceSetLayout = layout.setLayouts[1];
 }
 
-/* 创建渲染管线
- * 告诉vulkan渲染管线在执行时可以用哪些数据
- */
-void PointLightSystem::CreatePipelineLayout(VkDescriptorSetLayout globalSetLayout)
+void PointLightSystem::CreateInstanceBuffers()
+{
+    m_instancePool = LveDescriptorPool::Builder(m_lveDevice)
+        .SetMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .Build();
+
+    m_frameInstances.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < m_frameInstances.size(); i++) {
+        ReserveInstances(i, MIN_INSTANCE_CAPACITY);
+    }
+}
+
+void PointLightSystem::ReserveInstances(int frameIndex, uint32_t count)
 {
-    /* 从偏移0开始，大小为sizeof(SimplePushConstantData)的一段push常量
-     * 能被VS和FS两个阶段可见
-     */
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(PointLightPushConstants);
-
-    /*描述符集*/
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());  // 描述符集布局数量（descriptor set layouts）
-    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();   // 指向布局数组的指针
-
-    /*把push constant范围装入管线布局*/
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-    /*创建管线布局对象*/
-    if (vkCreatePipelineLayout(m_lveDevice.device(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
+    FrameInstances& frame = m_frameInstances[frameIndex];
+    if (count <= frame.capacity) {
+        return;
+    }
+
+    /*该帧的fence已经等待过，旧缓冲区和描述符集不再被GPU使用*/
+    uint32_t capacity = (std::max)({ count, frame.capacity * 2, MIN_INSTANCE_CAPACITY });
+    frame.buffer = std::make_unique<LveBuffer>(
+        m_lveDevice,
+        sizeof(PointLightInstance),
+        capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.buffer->Map();
+    frame.capacity = capacity;
+
+    auto bufferInfo = frame.buffer->DescriptorInfo();
+    LveDescriptorWriter writer(*m_instanceSetLayout, *m_instancePool);
+    writer.WriteBuffer(0, &bufferInfo);
+    if (frame.descriptorSet == VK_NULL_HANDLE) {
+        writer.Build(frame.descriptorSet);
+    }
+    else {
+        writer.Overwrite(frame.descriptorSet);
     }
 }
 
-void PointLightSystem::CreatePipelines(VkRenderPass renderPass)
+void PointLightSystem::CreatePipelines(LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, uint32_t subpass)
 {
     std::cout << "PointLightSystem: CreatePipelines" << "\n";
 
@@ -73,88 +125,102 @@ void PointLightSystem::CreatePipelines(VkRenderPass renderPass)
     LvePipeline::EnableAlphaBlending(pipelineConfig);   // 启用alpha混合
     pipelineConfig.attributeDescriptions.clear();
     pipelineConfig.bindingDescriptions.clear();
+    if (subpass > 0) {
+        /*延迟模式的光照子通道以只读方式绑定深度，公告板已从后到前排序，只做深度测试*/
+        pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+    }
     pipelineConfig.renderPass = renderPass;
+    pipelineConfig.subpass = subpass;
     pipelineConfig.pipelineLayout = m_pipelineLayout;
-    m_lvePipeline = std::make_unique<LvePipeline>(
-        m_lveDevice,
-        "../../../res/shaders/point_light.vert.spv",
-        "../../../res/shaders/point_light.frag.spv",
-        pipelineConfig);
+    pipelineQueue.Enqueue(
+        LveShaderCompiler::ShaderPath("point_light.vert"),
+        LveShaderCompiler::ShaderPath("point_light.frag"),
+        pipelineConfig,
+        m_lvePipeline);
 }
 
-void PointLightSystem::Update(FrameInfo& frameInfo, GlobalUbo& ubo)
+void PointLightSystem::Animate(FrameInfo& frameInfo)
 {
     auto rotateLight = glm::rotate(glm::mat4(1.f), frameInfo.frameTime, {0.f, -1.f, 0.f});
     // glm::mat4 rotateLight{ 1.f };
 
-    int lightIndex = 0;
-    for (auto& kv : frameInfo.objects) {
-        auto& obj = kv.second;
-        if (obj.pointLight == nullptr) {
-            //非点光源
-            continue;
-        }
-
-        assert(lightIndex < MAX_LIGHTS && "Point lights exceed maximum specified");
-
+    LveComponentPool<PointLightComponent>& lights = frameInfo.scene.View<PointLightComponent>();
+    for (size_t i = 0; i < lights.Size(); i++) {
         /*update light position*/
-        obj.transform.translation = glm::vec3(rotateLight * glm::vec4(obj.transform.translation, 1.f));
+        TransformComponent& transform = frameInfo.scene.EditTransform(lights.GetEntity(i).index);
+        transform.translation = glm::vec3(rotateLight * glm::vec4(transform.translation, 1.f));
+    }
+}
 
-        // copy light to ubo
-        ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.f);
-        ubo.pointLights[lightIndex].color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
+/*挂在父实体下的光源取传播后的世界位置*/
+void PointLightSystem::Update(FrameInfo& frameInfo, GlobalUbo& ubo, LveBuffer& lightBuffer)
+{
+    int lightIndex = 0;
+    LveComponentPool<PointLightComponent>& lights = frameInfo.scene.View<PointLightComponent>();
+    assert(lights.Size() <= lightBuffer.GetInstanceCount() && "Light buffer too small for scene lights");
+    PointLight* pointLights = static_cast<PointLight*>(lightBuffer.GetMappedMemory());
+    for (size_t i = 0; i < lights.Size(); i++) {
+        const TransformComponent& transform = frameInfo.scene.GetTransform(lights.GetEntity(i).index);
+
+        // copy light to storage buffer
+        pointLights[lightIndex].position = glm::vec4(glm::vec3(transform.mat4()[3]), lights[i].GetRange());
+        pointLights[lightIndex].color = glm::vec4(lights[i].color, lights[i].lightIntensity);
         lightIndex += 1;
     }
     ubo.numLights = lightIndex;
 }
 
-/* 主循环中每帧都会调用renderGameObjects
- * 引用传递gameObjects，每次都会修改gameObjects中的数据并影响到下一个循环
- * gameObjects为FirstApp持有
+/* 排序键为距离平方的位模式取反：非负float的位模式与数值同序，取反后升序即为从远到近
+ * 相同距离的光源都保留，按稠密数组顺序绘制
  */
 void PointLightSystem::Render(FrameInfo& frameInfo)
 {
-    /*对点光源进行排序*/
-    std::map<float, LveObject::id_t> sorted;    // k: 点光源的距离 v: 点光源id
-    for (auto& kv : frameInfo.objects) {
-        auto& obj = kv.second;
-        if (obj.pointLight == nullptr) continue;
+    LveComponentPool<PointLightComponent>& lights = frameInfo.scene.View<PointLightComponent>();
+    uint32_t lightCount = static_cast<uint32_t>(lights.Size());
+    if (lightCount == 0) {
+        return;
+    }
 
-        auto offset = frameInfo.camera.GetPosition() - obj.transform.translation;
+    glm::vec3 cameraPosition = frameInfo.camera.GetPosition();
+    m_sortItems.resize(lightCount);
+    for (uint32_t i = 0; i < lightCount; i++) {
+        const TransformComponent& transform = frameInfo.scene.GetTransform(lights.GetEntity(i).index);
+        auto offset = cameraPosition - glm::vec3(transform.mat4()[3]);
         float disSquared = glm::dot(offset, offset);
-        sorted[disSquared] = obj.getId();
+        uint32_t key;
+        std::memcpy(&key, &disSquared, sizeof(key));
+        m_sortItems[i] = (static_cast<uint64_t>(~key) << 32) | i;
+    }
+    RadixSortByHighWord(m_sortItems, m_sortScratch);
+
+    ReserveInstances(frameInfo.frameIndex, lightCount);
+    FrameInstances& frame = m_frameInstances[frameInfo.frameIndex];
+    PointLightInstance* instances = static_cast<PointLightInstance*>(frame.buffer->GetMappedMemory());
+    for (uint32_t k = 0; k < lightCount; k++) {
+        uint32_t i = static_cast<uint32_t>(m_sortItems[k]);
+        const PointLightComponent& light = lights[i];
+        const TransformComponent& transform = frameInfo.scene.GetTransform(lights.GetEntity(i).index);
+        instances[k].position = glm::vec4(glm::vec3(transform.mat4()[3]), transform.scale.x);
+        instances[k].color = glm::vec4(light.color, light.lightIntensity);
     }
 
     m_lvePipeline->Bind(frameInfo.commandBuffer);
 
+    /*set 0已由在set 0上兼容的布局绑定时只绑定set 1*/
+    uint32_t firstSet = m_lveDevice.layoutCache().IsCompatible(frameInfo.boundGlobalLayout, m_pipelineLayout, 0) ? 1 : 0;
+    VkDescriptorSet descriptorSets[] = { frameInfo.globalDescriptorSet, frame.descriptorSet };
     vkCmdBindDescriptorSets(frameInfo.commandBuffer,
         VK_PIPELINE_BIND_POINT_GRAPHICS,
         m_pipelineLayout,
-        0,
-        1,
-        &frameInfo.globalDescriptorSet,
+        firstSet,
+        2 - firstSet,
+        descriptorSets + firstSet,
         0,
         nullptr);
+    frameInfo.boundGlobalLayout = m_pipelineLayout;
 
-    /*从后到前渲染对象*/
-    for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
-        auto& obj = frameInfo.objects.at(it->second);
-
-        PointLightPushConstants push{};
-        push.position = glm::vec4(obj.transform.translation, 1.f);
-        push.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-        push.radius = obj.transform.scale.x;
-
-        vkCmdPushConstants(
-            frameInfo.commandBuffer,
-            m_pipelineLayout,
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-            0,
-            sizeof(PointLightPushConstants),
-            &push
-        );
-        vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
-    }
+    /*每个公告板6个顶点，实例按从后到前的顺序排列*/
+    vkCmdDraw(frameInfo.commandBuffer, 6, lightCount, 0, 0);
 }
 
 }
\ No newline at end of file
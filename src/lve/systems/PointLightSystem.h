@@ -1,10 +1,13 @@
 ﻿#pragma once
 
 #include "LvePipeline.h"
+#include "LvePipelineQueue.h"
 #include "LveDevice.h"
-#include "LveObject.h"
+#include "LveScene.h"
 #include "LveCamera.h"
 #include "LveFrameInfo.h"
+#include "LveBuffer.h"
+#include "LveDescriptors.h"
 
 #include <memory>
 #include <vector>
@@ -13,24 +16,48 @@ namespace lve {
 
 class PointLightSystem {
 public:
-	PointLightSystem(LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
-	~PointLightSystem();
+	/*subpass：延迟模式下公告板画在光照子通道（1），深度只读*/
+	PointLightSystem(LveDevice& device, LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, LveDescriptorSetLayout& globalSetLayout, uint32_t subpass = 0);
 
 	PointLightSystem(const PointLightSystem&) = delete;
 	PointLightSystem& operator=(const PointLightSystem&) = delete;
 
-	void Update(FrameInfo& frameInfo, GlobalUbo& ubo);
-	void Render(FrameInfo& frameInfo); //不将camera作为成员变量，能在多个渲染系统之间共享相机对象
+	/*绕y轴旋转点光源的局部位置，需在LveScene::UpdateTransforms之前调用*/
+	void Animate(FrameInfo& frameInfo);
+	/* 把点光源的世界位置写入lightBuffer并把数量写入ubo，需在LveScene::UpdateTransforms之后调用
+	 * lightBuffer需能容纳场景中全部点光源
+	 */
+	void Update(FrameInfo& frameInfo, GlobalUbo& ubo, LveBuffer& lightBuffer);
+	/* 按到相机的距离从后到前排序后写入本帧的实例缓冲区，一次实例化绘制所有公告板
+	 * 不将camera作为成员变量，能在多个渲染系统之间共享相机对象
+	 */
+	void Render(FrameInfo& frameInfo);
 
 private:
-	void CreatePipelineLayout(VkDescriptorSetLayout globalSetLayout);
-	void CreatePipelines(VkRenderPass renderPass);
+	void CreatePipelineLayout(LveDescriptorSetLayout& globalSetLayout);
+	void CreatePipelines(LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, uint32_t subpass);
+	void CreateInstanceBuffers();
+	/*确保本帧的实例缓冲区能容纳count个公告板，不够时按倍数扩容并重写描述符*/
+	void ReserveInstances(int frameIndex, uint32_t count);
+
+	/*每帧一个持久映射的公告板实例缓冲区，按set = 1绑定给顶点着色器*/
+	struct FrameInstances {
+		std::unique_ptr<LveBuffer> buffer;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		uint32_t capacity = 0;
+	};
 
 	LveDevice& m_lveDevice;
 
 	std::unique_ptr<LvePipeline> m_lvePipeline;	// 主三角形管线
-	VkPipelineLayout m_pipelineLayout;
+	VkPipelineLayout m_pipelineLayout;	// 由LveLayoutCache反射生成并持有
 	std::unique_ptr<LveModel> m_axisModel;
+
+	LveDescriptorSetLayout* m_instanceSetLayout = nullptr;	// point_light.vert的set 1
+	std::unique_ptr<LveDescriptorPool> m_instancePool;
+	std::vector<FrameInstances> m_frameInstances;
+	std::vector<uint64_t> m_sortItems;		// 高32位排序键，低32位点光源在稠密数组中的下标；每帧复用
+	std::vector<uint64_t> m_sortScratch;
 };
 
 }  // namespace lve
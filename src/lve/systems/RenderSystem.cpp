@@ -1,66 +1,72 @@
 ﻿#include "RenderSystem.h"
 
+#include "LveLayoutCache.h"
+#include "LveShaderCompiler.h"
+#include "LveSwapChain.h"
 
 #define GLM_FORCE_RADIANS	// 无论在什么系统上，glm都会希望角度以弧度指定
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE	//深度缓冲区值范围从0到1，而不是-1到1（OpenGL）
 #include <glm.hpp>
 #include <gtc/constants.hpp>
 
+#include <algorithm>
 #include <stdexcept>
 #include <array>
 #include <iostream>
 
 namespace lve {
 
-    struct SimplePushConstantData {
+    /*与shader.vert中的InstanceData一致（std430）*/
+    struct InstanceData {
         glm::mat4 modelMatrix{ 1.f };   // 初始化为单位矩阵
         glm::mat4 normalMatrix{ 1.f };
     };
 
-RenderSystem::RenderSystem(LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-    : m_lveDevice(device)
-{
-    CreatePipelineLayout(globalSetLayout); // 定义渲染管线的layout
-    CreatePipelines(renderPass);
-    CreateAxisVertices();
-}
+    /*与cull.comp中的ObjectData一致（std430）*/
+    struct CullObjectData {
+        glm::vec4 sphere{};         // xyz：世界空间球心，w：半径
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t vertexOffset = 0;
+        uint32_t instanceIndex = 0; // 实例缓冲区下标，写入绘制命令的firstInstance
+    };
 
-RenderSystem::~RenderSystem()
+    struct CullPushConstants {
+        glm::vec4 frustumPlanes[6];
+        uint32_t objectCount;
+        uint32_t compact;           // 1：可见命令压缩到前部并由计数缓冲决定绘制数量；0：原位写入，剔除的instanceCount为0
+        uint32_t chunkSize;         // 压缩时每段的命令数，对应一次vkCmdDrawIndexedIndirectCount
+    };
+
+    static constexpr uint32_t MIN_INSTANCE_CAPACITY = 1024;
+    static constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+
+RenderSystem::RenderSystem(LveDevice& device, LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, LveDescriptorSetLayout& globalSetLayout,
+    const LightingSpecializations& lighting, bool deferred)
+    : m_lveDevice(device), m_deferred(deferred)
 {
-    vkDestroyPipelineLayout(m_lveDevice.device(), m_pipelineLayout, nullptr);
+    CreatePipelineLayout(globalSetLayout, deferred); // 定义渲染管线的layout
+    CreateInstanceBuffers();
+    CreatePipelines(pipelineQueue, renderPass, lighting, deferred);
+    CreateCullPipeline(pipelineQueue);
+    CreateAxisVertices();
 }
 
 /* 创建渲染管线
  * 告诉vulkan渲染管线在执行时可以用哪些数据
+ * 布局由着色器反射得到：set 0为全局描述符集（只校验），set 1为本系统的实例缓冲区
  */
-void RenderSystem::CreatePipelineLayout(VkDescriptorSetLayout globalSetLayout)
+void RenderSystem::CreatePipelineLayout(LveDescriptorSetLayout& globalSetLayout, bool deferred)
 {
-    /* 从偏移0开始，大小为sizeof(SimplePushConstantData)的一段push常量
-     * 能被VS和FS两个阶段可见
-     */
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(SimplePushConstantData);
-
-    /*描述符集*/
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());  // 描述符集布局数量（descriptor set layouts）
-    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();   // 指向布局数组的指针
-
-    /*把push constant范围装入管线布局*/
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-    /*创建管线布局对象*/
-    if (vkCreatePipelineLayout(m_lveDevice.device(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
-    }
+    const LveLayoutCache::PipelineLayout& layout = m_lveDevice.layoutCache().GetPipelineLayout(
+        { LveShaderCompiler::ShaderPath("shader.vert"), LveShaderCompiler::ShaderPath(deferred ? "gbuffer.frag" : "shader.frag") },
+        { { 0, &globalSetLayout } });
+    assert(layout.setLayouts.size() == 2 && layout.pushConstantRanges.empty() && "RenderSystem shaders no longer match the expected layout");
+    m_pipelineLayout = layout.pipelineLayout;
+    m_instanceSetLayout = layout.setLayouts[1];
 }
 
-void RenderSystem::CreatePipelines(VkRenderPass renderPass)
+void RenderSystem::CreatePipelines(LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, const LightingSpecializations& lighting, bool deferred)
 {
     assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
@@ -69,41 +75,460 @@ void RenderSystem::CreatePipelines(VkRenderPass renderPass)
     LvePipeline::DefaultPipelineConfigInfo(pipelineConfig);
     pipelineConfig.renderPass = renderPass;
     pipelineConfig.pipelineLayout = m_pipelineLayout;
-    m_lvePipeline = std::make_unique<LvePipeline>(m_lveDevice, "../../../res/shaders/shader.vert.spv", "../../../res/shaders/shader.frag.spv", pipelineConfig);
+    if (!deferred) {
+        pipelineConfig.specialization = lighting.base;
+        pipelineConfig.variants = lighting.variants;
+        pipelineQueue.Enqueue(LveShaderCompiler::ShaderPath("shader.vert"), LveShaderCompiler::ShaderPath("shader.frag"), pipelineConfig, m_lvePipeline);
+        return;
+    }
+
+    /*几何子通道：反照率与法线两个颜色附件，均不混合*/
+    std::array<VkPipelineColorBlendAttachmentState, 2> gbufferBlendAttachments{
+        pipelineConfig.colorBlendAttachment, pipelineConfig.colorBlendAttachment };
+    pipelineConfig.colorBlendInfo.attachmentCount = static_cast<uint32_t>(gbufferBlendAttachments.size());
+    pipelineConfig.colorBlendInfo.pAttachments = gbufferBlendAttachments.data();
+    pipelineConfig.subpass = 0;
+    pipelineQueue.Enqueue(LveShaderCompiler::ShaderPath("shader.vert"), LveShaderCompiler::ShaderPath("gbuffer.frag"), pipelineConfig, m_lvePipeline);
 
 }
 
-/* 主循环中每帧都会调用renderGameObjects
- * 引用传递gameObjects，每次都会修改gameObjects中的数据并影响到下一个循环
- * gameObjects为FirstApp持有`
- * 
+void RenderSystem::CreateInstanceBuffers()
+{
+    m_instancePool = LveDescriptorPool::Builder(m_lveDevice)
+        .SetMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .Build();
+
+    m_frameInstances.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < m_frameInstances.size(); i++) {
+        ReserveInstances(i, MIN_INSTANCE_CAPACITY);
+    }
+}
+
+void RenderSystem::ReserveInstances(int frameIndex, uint32_t count)
+{
+    FrameInstances& frame = m_frameInstances[frameIndex];
+    if (count <= frame.capacity) {
+        return;
+    }
+
+    /* 走到这里时该帧的fence已经等待过，旧缓冲区不再被GPU使用，可以直接替换
+     * 描述符集也只被这一帧的命令缓冲引用，原地重写即可
+     */
+    uint32_t capacity = (std::max)({ count, frame.capacity * 2, MIN_INSTANCE_CAPACITY });
+    frame.buffer = std::make_unique<LveBuffer>(
+        m_lveDevice,
+        sizeof(InstanceData),
+        capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.buffer->Map();
+    frame.capacity = capacity;
+
+    auto bufferInfo = frame.buffer->DescriptorInfo();
+    LveDescriptorWriter writer(*m_instanceSetLayout, *m_instancePool);
+    writer.WriteBuffer(0, &bufferInfo);
+    if (frame.descriptorSet == VK_NULL_HANDLE) {
+        writer.Build(frame.descriptorSet);
+    }
+    else {
+        writer.Overwrite(frame.descriptorSet);
+    }
+}
+
+/* 主循环中每帧都会调用RenderObjects
+ * 间接绘制模式下直接提交预先构建的绘制命令，否则按模型分组实例化绘制
  */
 void RenderSystem::RenderObjects(FrameInfo& frameInfo)
 {
-    m_lvePipeline->Bind(frameInfo.commandBuffer);
+    if (m_indirectDrawEnabled) {
+        RenderIndirect(frameInfo);
+    }
+    else {
+        RenderInstanced(frameInfo);
+    }
+}
+
+bool RenderSystem::SetIndirectDrawEnabled(bool enabled)
+{
+    if (enabled && !m_lveDevice.enabledFeatures().drawIndirectFirstInstance) {
+        std::cerr << "RenderSystem: drawIndirectFirstInstance not supported, indirect draw disabled\n";
+        enabled = false;
+    }
+    if (enabled != m_indirectDrawEnabled) {
+        m_indirectDrawEnabled = enabled;
+        MarkStaticSceneDirty();
+    }
+    return m_indirectDrawEnabled;
+}
+
+/* 包围球变换到世界空间，半径按最大缩放分量放大
+ * 缩放取世界矩阵各轴的长度，包含了父节点的缩放
+ */
+static glm::vec4 WorldBoundingSphere(const LveModel& model, const glm::mat4& modelMatrix)
+{
+    const glm::vec4& localSphere = model.GetBoundingSphere();
+    glm::vec4 center = modelMatrix * glm::vec4(glm::vec3(localSphere), 1.f);
+    float maxScaleSquared = (std::max)({
+        glm::dot(glm::vec3(modelMatrix[0]), glm::vec3(modelMatrix[0])),
+        glm::dot(glm::vec3(modelMatrix[1]), glm::vec3(modelMatrix[1])),
+        glm::dot(glm::vec3(modelMatrix[2]), glm::vec3(modelMatrix[2])) });
+    return glm::vec4(glm::vec3(center), localSphere.w * std::sqrt(maxScaleSquared));
+}
+
+/*与其他管线一起登记到编译队列，着色器修改后随热重载一起替换*/
+void RenderSystem::CreateCullPipeline(LvePipelineQueue& pipelineQueue)
+{
+    /*set 0：对象包围球与绘制参数、输出的间接绘制命令、可见数量*/
+    const LveLayoutCache::PipelineLayout& layout = m_lveDevice.layoutCache().GetPipelineLayout(
+        { LveShaderCompiler::ShaderPath("cull.comp") });
+    assert(layout.setLayouts.size() == 1 && layout.pushConstantRanges.size() == 1 &&
+        layout.pushConstantRanges[0].size == sizeof(CullPushConstants) && "CullPushConstants does not match cull.comp");
+    m_cullPipelineLayout = layout.pipelineLayout;
+    m_cullSetLayout = layout.setLayouts[0];
+    m_cullPool = LveDescriptorPool::Builder(m_lveDevice)
+        .SetMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .Build();
+
+    pipelineQueue.EnqueueCompute(LveShaderCompiler::ShaderPath("cull.comp"), m_cullPipelineLayout, m_cullPipeline);
+}
+
+void RenderSystem::ReserveIndirectDraws(int frameIndex, uint32_t count)
+{
+    FrameInstances& frame = m_frameInstances[frameIndex];
+    if (count <= frame.indirectCapacity) {
+        return;
+    }
+
+    uint32_t capacity = (std::max)({ count, frame.indirectCapacity * 2, MIN_INSTANCE_CAPACITY });
+    frame.objectBuffer = std::make_unique<LveBuffer>(
+        m_lveDevice,
+        sizeof(CullObjectData),
+        capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.objectBuffer->Map();
+    /*只由剔除着色器写、间接绘制读，放在显存*/
+    frame.drawBuffer = std::make_unique<LveBuffer>(
+        m_lveDevice,
+        sizeof(VkDrawIndexedIndirectCommand),
+        capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    /*CPU在该帧fence之后直接读取可见总数作为统计；每段的计数跟在总数之后*/
+    uint32_t maxDrawCount = MaxIndirectDrawCount();
+    uint32_t chunkCount = capacity / maxDrawCount + (capacity % maxDrawCount != 0 ? 1 : 0);
+    frame.countBuffer = std::make_unique<LveBuffer>(
+        m_lveDevice,
+        sizeof(uint32_t),
+        1 + chunkCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.countBuffer->Map();
+    frame.indirectCapacity = capacity;
+
+    auto objectInfo = frame.objectBuffer->DescriptorInfo();
+    auto drawInfo = frame.drawBuffer->DescriptorInfo();
+    auto countInfo = frame.countBuffer->DescriptorInfo();
+    LveDescriptorWriter writer(*m_cullSetLayout, *m_cullPool);
+    writer.WriteBuffer(0, &objectInfo)
+        .WriteBuffer(1, &drawInfo)
+        .WriteBuffer(2, &countInfo);
+    if (frame.cullDescriptorSet == VK_NULL_HANDLE) {
+        writer.Build(frame.cullDescriptorSet);
+    }
+    else {
+        writer.Overwrite(frame.cullDescriptorSet);
+    }
+}
+
+/* 共享同一个LveModel的对象合并为一次实例化绘制：
+ * 按模型排序后把矩阵连续写入实例缓冲区，每组只绑定一次顶点/索引缓冲，
+ * 用firstInstance指向该组在缓冲区中的起点
+ */
+void RenderSystem::RenderInstanced(FrameInfo& frameInfo)
+{
+    /*先把所有驻留对象的世界空间包围球批量做视锥剔除，只为可见对象录制绘制*/
+    m_candidates.clear();
+    m_culler.Clear();
+    LveComponentPool<ModelComponent>& models = frameInfo.scene.View<ModelComponent>();
+    for (size_t i = 0; i < models.Size(); i++) {
+        LveModel* model = models[i].model.get();
+        if (model == nullptr) continue;
+        if (!model->IsResident()) continue;  // 仍在传输队列上上传，本帧不绘制，不阻塞提交
+        const TransformComponent& transform = frameInfo.scene.GetTransform(models.GetEntity(i).index);
+        m_candidates.push_back({ model, &transform });
+        m_culler.Add(WorldBoundingSphere(*model, transform.mat4()));
+    }
+
+    m_drawItems.clear();
+    for (uint32_t index : m_culler.Cull(frameInfo.camera.GetFrustumPlanes())) {
+        m_drawItems.push_back(m_candidates[index]);
+    }
+    m_cullStats.total = static_cast<uint32_t>(m_candidates.size());
+    m_cullStats.visible = static_cast<uint32_t>(m_drawItems.size());
+    if (m_drawItems.empty()) {
+        return;
+    }
+
+    std::sort(m_drawItems.begin(), m_drawItems.end(),
+        [](const DrawItem& a, const DrawItem& b) { return a.model < b.model; });
+
+    ReserveInstances(frameInfo.frameIndex, static_cast<uint32_t>(m_drawItems.size()));
+    FrameInstances& frame = m_frameInstances[frameInfo.frameIndex];
+    InstanceData* instances = static_cast<InstanceData*>(frame.buffer->GetMappedMemory());
+    for (size_t i = 0; i < m_drawItems.size(); i++) {
+        instances[i].modelMatrix = m_drawItems[i].transform->mat4();
+        instances[i].normalMatrix = m_drawItems[i].transform->normalMatrix();
+    }
+
+    m_lvePipeline->Bind(frameInfo.commandBuffer, m_deferred ? nullptr : frameInfo.lightingVariant);
 
+    /*set 0已由在set 0上兼容的布局绑定时只绑定set 1*/
+    uint32_t firstSet = m_lveDevice.layoutCache().IsCompatible(frameInfo.boundGlobalLayout, m_pipelineLayout, 0) ? 1 : 0;
+    VkDescriptorSet descriptorSets[] = { frameInfo.globalDescriptorSet, frame.descriptorSet };
     vkCmdBindDescriptorSets(frameInfo.commandBuffer,
         VK_PIPELINE_BIND_POINT_GRAPHICS,
         m_pipelineLayout,
+        firstSet,
+        2 - firstSet,
+        descriptorSets + firstSet,
         0,
-        1,
-        &frameInfo.globalDescriptorSet,
+        nullptr);
+    frameInfo.boundGlobalLayout = m_pipelineLayout;
+
+    uint32_t first = 0;
+    while (first < m_drawItems.size()) {
+        LveModel* model = m_drawItems[first].model;
+        uint32_t count = 1;
+        while (first + count < m_drawItems.size() && m_drawItems[first + count].model == model) {
+            count++;
+        }
+        model->Bind(frameInfo.commandBuffer);
+        model->Draw(frameInfo.commandBuffer, count, first);
+        first += count;
+    }
+}
+
+/* 为当前帧重建静态场景的实例矩阵与剔除输入
+ * 每帧各有一份，重建时只写本帧的缓冲区，不影响仍在GPU上执行的其他帧
+ */
+void RenderSystem::BuildIndirectDraws(FrameInfo& frameInfo)
+{
+    FrameInstances& frame = m_frameInstances[frameInfo.frameIndex];
+
+    m_drawItems.clear();
+    m_fallbackItems.clear();
+    frame.meshPool = nullptr;
+    frame.fallbackDraws.clear();
+    LveComponentPool<ModelComponent>& models = frameInfo.scene.View<ModelComponent>();
+    for (size_t i = 0; i < models.Size(); i++) {
+        LveModel* model = models[i].model.get();
+        if (model == nullptr) continue;
+        if (!model->IsResident()) {
+            m_staticScenePending = true;
+            continue;
+        }
+        /*间接绘制只能使用同一对顶点/索引缓冲，其余模型在同一帧内按实例化方式补画*/
+        const TransformComponent* transform = &frameInfo.scene.GetTransform(models.GetEntity(i).index);
+        LveMeshPool* meshPool = model->GetMeshPool();
+        if (meshPool == nullptr || (frame.meshPool != nullptr && meshPool != frame.meshPool)) {
+            m_fallbackItems.push_back({ model, transform });
+            continue;
+        }
+        frame.meshPool = meshPool;
+        m_drawItems.push_back({ model, transform });
+    }
+
+    /*同一模型的对象相邻，命令流对GPU缓存更友好*/
+    auto byModel = [](const DrawItem& a, const DrawItem& b) { return a.model < b.model; };
+    std::sort(m_drawItems.begin(), m_drawItems.end(), byModel);
+    std::sort(m_fallbackItems.begin(), m_fallbackItems.end(), byModel);
+
+    uint32_t drawCount = static_cast<uint32_t>(m_drawItems.size());
+    uint32_t fallbackCount = static_cast<uint32_t>(m_fallbackItems.size());
+    ReserveInstances(frameInfo.frameIndex, drawCount + fallbackCount);
+    ReserveIndirectDraws(frameInfo.frameIndex, drawCount);
+
+    InstanceData* instances = static_cast<InstanceData*>(frame.buffer->GetMappedMemory());
+    auto* objects = static_cast<CullObjectData*>(frame.objectBuffer->GetMappedMemory());
+    for (uint32_t i = 0; i < drawCount; i++) {
+        const TransformComponent& transform = *m_drawItems[i].transform;
+        instances[i].modelMatrix = transform.mat4();
+        instances[i].normalMatrix = transform.normalMatrix();
+
+        VkDrawIndexedIndirectCommand command = m_drawItems[i].model->GetDrawCommand(1, i);
+        objects[i].sphere = WorldBoundingSphere(*m_drawItems[i].model, instances[i].modelMatrix);
+        objects[i].indexCount = command.indexCount;
+        objects[i].firstIndex = command.firstIndex;
+        objects[i].vertexOffset = command.vertexOffset;
+        objects[i].instanceIndex = i;
+    }
+
+    for (uint32_t i = 0; i < fallbackCount; i++) {
+        const TransformComponent& transform = *m_fallbackItems[i].transform;
+        uint32_t instanceIndex = drawCount + i;
+        instances[instanceIndex].modelMatrix = transform.mat4();
+        instances[instanceIndex].normalMatrix = transform.normalMatrix();
+        if (!frame.fallbackDraws.empty() && frame.fallbackDraws.back().model == m_fallbackItems[i].model) {
+            frame.fallbackDraws.back().instanceCount++;
+        }
+        else {
+            frame.fallbackDraws.push_back({ m_fallbackItems[i].model, 1, instanceIndex });
+        }
+    }
+    frame.drawCount = drawCount;
+    frame.staticVersion = m_staticSceneVersion;
+}
+
+void RenderSystem::CullObjects(FrameInfo& frameInfo)
+{
+    if (!m_indirectDrawEnabled) {
+        return;
+    }
+
+    /*上一次重建时还有模型在上传，继续重建直到全部驻留*/
+    if (m_staticScenePending) {
+        m_staticScenePending = false;
+        MarkStaticSceneDirty();
+    }
+
+    FrameInstances& frame = m_frameInstances[frameInfo.frameIndex];
+
+    /*BeginFrame已等待过本帧的fence，上一次写入的计数可以直接读取*/
+    if (frame.countBuffer != nullptr && frame.culledDrawCount > 0) {
+        m_cullStats.total = frame.culledDrawCount;
+        m_cullStats.visible = *static_cast<const uint32_t*>(frame.countBuffer->GetMappedMemory());
+        for (const FallbackDraw& draw : frame.fallbackDraws) {
+            m_cullStats.total += draw.instanceCount;
+            m_cullStats.visible += draw.instanceCount;
+        }
+    }
+
+    if (frame.staticVersion != m_staticSceneVersion) {
+        BuildIndirectDraws(frameInfo);
+    }
+    frame.culled = true;
+    frame.culledDrawCount = frame.drawCount;
+    /*补画的模型不参与GPU剔除，计入总数与可见数*/
+    if (frame.drawCount == 0) {
+        m_cullStats = {};
+        for (const FallbackDraw& draw : frame.fallbackDraws) {
+            m_cullStats.total += draw.instanceCount;
+            m_cullStats.visible += draw.instanceCount;
+        }
+        return;
+    }
+
+    VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+    vkCmdFillBuffer(commandBuffer, frame.countBuffer->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    CullPushConstants push{};
+    std::array<glm::vec4, 6> planes = frameInfo.camera.GetFrustumPlanes();
+    for (int i = 0; i < 6; i++) {
+        push.frustumPlanes[i] = planes[i];
+    }
+    push.objectCount = frame.drawCount;
+    push.compact = m_lveDevice.cmdDrawIndexedIndirectCount() != nullptr ? 1u : 0u;
+    push.chunkSize = MaxIndirectDrawCount();
+
+    m_cullPipeline->Bind(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout,
+        0, 1, &frame.cullDescriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+        0, sizeof(CullPushConstants), &push);
+    vkCmdDispatch(commandBuffer, (frame.drawCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+    /*剔除结果供间接绘制读取，计数同时供CPU在fence之后读取*/
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
+
+void RenderSystem::RenderIndirect(FrameInfo& frameInfo)
+{
+    FrameInstances& frame = m_frameInstances[frameInfo.frameIndex];
+    assert(frame.culled && "CullObjects must be recorded before the render pass in indirect mode");
+    frame.culled = false;
+    if (frame.drawCount == 0 && frame.fallbackDraws.empty()) {
+        return;
+    }
+
+    m_lvePipeline->Bind(frameInfo.commandBuffer, m_deferred ? nullptr : frameInfo.lightingVariant);
+
+    /*set 0已由在set 0上兼容的布局绑定时只绑定set 1*/
+    uint32_t firstSet = m_lveDevice.layoutCache().IsCompatible(frameInfo.boundGlobalLayout, m_pipelineLayout, 0) ? 1 : 0;
+    VkDescriptorSet descriptorSets[] = { frameInfo.globalDescriptorSet, frame.descriptorSet };
+    vkCmdBindDescriptorSets(frameInfo.commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        m_pipelineLayout,
+        firstSet,
+        2 - firstSet,
+        descriptorSets + firstSet,
         0,
         nullptr);
+    frameInfo.boundGlobalLayout = m_pipelineLayout;
+
+    /*不在网格池中的模型各自绑定顶点/索引缓冲，实例矩阵已与间接绘制写在同一缓冲区*/
+    for (const FallbackDraw& draw : frame.fallbackDraws) {
+        draw.model->Bind(frameInfo.commandBuffer);
+        draw.model->Draw(frameInfo.commandBuffer, draw.instanceCount, draw.firstInstance);
+    }
+    if (frame.drawCount == 0) {
+        return;
+    }
+    frame.meshPool->Bind(frameInfo.commandBuffer);
 
-    for (auto& kv : frameInfo.objects) {
-        auto& obj = kv.second;
-        if (obj.model == nullptr) continue;
-        SimplePushConstantData push{};
-        push.modelMatrix = obj.transform.mat4();
-        push.normalMatrix = obj.transform.normalMatrix();
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    const uint32_t maxDrawCount = MaxIndirectDrawCount();
+    VkBuffer drawBuffer = frame.drawBuffer->GetBuffer();
 
-        vkCmdPushConstants(frameInfo.commandBuffer, m_pipelineLayout,
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-            0, sizeof(SimplePushConstantData), &push);
-        obj.model->Bind(frameInfo.commandBuffer);
-        obj.model->Draw(frameInfo.commandBuffer);
+    if (auto drawIndexedIndirectCount = m_lveDevice.cmdDrawIndexedIndirectCount()) {
+        /*可见命令已压缩到缓冲区前部，每段从计数缓冲中对应的计数读取实际数量，超出可见总数的段计数为0*/
+        for (uint32_t first = 0; first < frame.drawCount; first += maxDrawCount) {
+            uint32_t count = (std::min)(maxDrawCount, frame.drawCount - first);
+            VkDeviceSize countOffset = (1 + first / maxDrawCount) * sizeof(uint32_t);
+            drawIndexedIndirectCount(frameInfo.commandBuffer, drawBuffer,
+                static_cast<VkDeviceSize>(first) * stride, frame.countBuffer->GetBuffer(), countOffset, count, stride);
+        }
+    }
+    else if (maxDrawCount > 1) {
+        /*剔除掉的命令instanceCount为0；单次调用的绘制数量受maxDrawIndirectCount限制*/
+        for (uint32_t first = 0; first < frame.drawCount; first += maxDrawCount) {
+            uint32_t count = (std::min)(maxDrawCount, frame.drawCount - first);
+            vkCmdDrawIndexedIndirect(frameInfo.commandBuffer, drawBuffer,
+                static_cast<VkDeviceSize>(first) * stride, count, stride);
+        }
+    }
+    else {
+        /*不支持multiDrawIndirect时drawCount只能为1*/
+        for (uint32_t i = 0; i < frame.drawCount; i++) {
+            vkCmdDrawIndexedIndirect(frameInfo.commandBuffer, drawBuffer,
+                static_cast<VkDeviceSize>(i) * stride, 1, stride);
+        }
+    }
+}
+
+uint32_t RenderSystem::MaxIndirectDrawCount() const
+{
+    /*未启用multiDrawIndirect时一次间接绘制只能包含一个命令*/
+    if (!m_lveDevice.enabledFeatures().multiDrawIndirect) {
+        return 1;
     }
+    return (std::max)(m_lveDevice.properties.limits.maxDrawIndirectCount, 1u);
 }
 
 /*固定在窗口左下角的小坐标系*/
@@ -1,10 +1,14 @@
 ﻿#pragma once
 
 #include "LvePipeline.h"
+#include "LvePipelineQueue.h"
 #include "LveDevice.h"
-#include "LveObject.h"
+#include "LveScene.h"
 #include "LveCamera.h"
 #include "LveFrameInfo.h"
+#include "LveBuffer.h"
+#include "LveDescriptors.h"
+#include "LveFrustumCuller.h"
 
 #include <memory>
 #include <vector>
@@ -13,26 +17,118 @@ namespace lve {
 
 class RenderSystem {
 public:
-	RenderSystem(LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
-	~RenderSystem();
+	/* deferred为true时管线输出到延迟RenderPass的几何子通道（G-buffer），不计算光照
+	 * 管线登记到pipelineQueue，pipelineQueue.Compile()之后才能渲染
+	 */
+	RenderSystem(LveDevice& device, LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, LveDescriptorSetLayout& globalSetLayout,
+		const LightingSpecializations& lighting, bool deferred = false);
 
 	RenderSystem(const RenderSystem&) = delete;
 	RenderSystem& operator=(const RenderSystem&) = delete;
 
 	void RenderObjects(FrameInfo& frameInfo); //不将camera作为成员变量，能在多个渲染系统之间共享相机对象
+
+	/* 静态场景的间接绘制模式：所有网格位于同一个LveMeshPool，
+	 * 每个对象一条VkDrawIndexedIndirectCommand，只在场景变化时重建，
+	 * 每帧录制的命令数量与对象数量无关
+	 * 设备不支持drawIndirectFirstInstance时保持关闭，返回false
+	 */
+	bool SetIndirectDrawEnabled(bool enabled);
+	bool IsIndirectDrawEnabled() const { return m_indirectDrawEnabled; }
+	/*对象增删或静态对象的变换改变后调用*/
+	void MarkStaticSceneDirty() { m_staticSceneVersion++; }
+
+	/* 间接绘制模式下，在BeginSwapChainRenderPass之前录制视锥剔除计算通道：
+	 * 每个对象的世界空间包围球与相机视锥比较，可见的绘制命令压缩写入间接缓冲并累加计数
+	 * 非间接绘制模式下什么也不做
+	 */
+	void CullObjects(FrameInfo& frameInfo);
+
+	struct CullStats {
+		uint32_t total = 0;
+		uint32_t visible = 0;
+	};
+	/*最近一次的剔除结果：实例化模式下为本帧CPU剔除，间接绘制模式下为GPU读回（有一帧在途延迟）*/
+	CullStats GetCullStats() const { return m_cullStats; }
+
 	void RenderAxis(VkCommandBuffer commandBuffer, const LveCamera& camera, VkExtent2D extent);
 
 private:
-	void CreatePipelineLayout(VkDescriptorSetLayout globalSetLayout);
-	void CreatePipelines(VkRenderPass renderPass);
+	void CreatePipelineLayout(LveDescriptorSetLayout& globalSetLayout, bool deferred);
+	void CreatePipelines(LvePipelineQueue& pipelineQueue, VkRenderPass renderPass, const LightingSpecializations& lighting, bool deferred);
 	void CreateAxisVertices();
+	void CreateInstanceBuffers();
+	void CreateCullPipeline(LvePipelineQueue& pipelineQueue);
+	/*确保本帧的实例缓冲区能容纳count个实例，不够时按倍数扩容并重写描述符*/
+	void ReserveInstances(int frameIndex, uint32_t count);
+	void RenderInstanced(FrameInfo& frameInfo);
+	void RenderIndirect(FrameInfo& frameInfo);
+	void BuildIndirectDraws(FrameInfo& frameInfo);
+	/*确保本帧的剔除输入/输出缓冲区能容纳count个对象*/
+	void ReserveIndirectDraws(int frameIndex, uint32_t count);
+	/*单次间接绘制调用允许的最大绘制数，未启用multiDrawIndirect时为1*/
+	uint32_t MaxIndirectDrawCount() const;
+
+	/*间接绘制模式下不在网格池中的模型（如池满时回退到独立缓冲区），按实例化方式绘制*/
+	struct FallbackDraw {
+		LveModel* model;
+		uint32_t instanceCount;
+		uint32_t firstInstance;
+	};
+
+	/*每帧一个持久映射的实例缓冲区，按set = 1绑定给顶点着色器*/
+	struct FrameInstances {
+		std::unique_ptr<LveBuffer> buffer;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		uint32_t capacity = 0;
+
+		/* 间接绘制模式：staticVersion落后时重建objectBuffer
+		 * objectBuffer（CPU写）-> 剔除着色器 -> drawBuffer + countBuffer（GPU写）-> 间接绘制
+		 * countBuffer首个uint为可见总数，其后为每段MaxIndirectDrawCount()个命令的可见数
+		 */
+		std::unique_ptr<LveBuffer> objectBuffer;
+		std::unique_ptr<LveBuffer> drawBuffer;
+		std::unique_ptr<LveBuffer> countBuffer;
+		VkDescriptorSet cullDescriptorSet = VK_NULL_HANDLE;
+		uint32_t indirectCapacity = 0;
+		uint32_t drawCount = 0;
+		uint64_t staticVersion = 0;
+		LveMeshPool* meshPool = nullptr;
+		bool culled = false;			// 本帧已录制剔除，drawBuffer可用
+		uint32_t culledDrawCount = 0;	// 上次剔除时的对象数，用于统计
+		std::vector<FallbackDraw> fallbackDraws;	// 实例矩阵写在间接绘制的实例之后
+	};
+
+	struct DrawItem {
+		LveModel* model;
+		const TransformComponent* transform;	// 指向场景的稠密变换数组，只在本帧内有效
+	};
 
 	LveDevice& m_lveDevice;
+	bool m_deferred;	// 几何子通道不计算光照，不使用光照变体
 
 	std::unique_ptr<LvePipeline> m_lvePipeline;	// 主三角形管线
 	std::unique_ptr<LvePipeline> m_axisPipeline;	// 坐标轴线框管线
-	VkPipelineLayout m_pipelineLayout;
+	VkPipelineLayout m_pipelineLayout;	// 由LveLayoutCache反射生成并持有
 	std::unique_ptr<LveModel> m_axisModel;
+
+	LveDescriptorSetLayout* m_instanceSetLayout = nullptr;	// shader.vert的set 1
+	std::unique_ptr<LveDescriptorPool> m_instancePool;
+	std::vector<FrameInstances> m_frameInstances;
+	std::vector<DrawItem> m_drawItems;	// 每帧复用，避免反复分配
+	std::vector<DrawItem> m_fallbackItems;	// 重建间接绘制时复用
+	std::vector<DrawItem> m_candidates;	// 剔除前的驻留对象，与m_culler中的包围球一一对应
+	LveFrustumCuller m_culler;
+
+	LveDescriptorSetLayout* m_cullSetLayout = nullptr;
+	std::unique_ptr<LveDescriptorPool> m_cullPool;
+	VkPipelineLayout m_cullPipelineLayout = VK_NULL_HANDLE;
+	std::unique_ptr<LveComputePipeline> m_cullPipeline;
+	CullStats m_cullStats{};
+
+	bool m_indirectDrawEnabled = false;
+	uint64_t m_staticSceneVersion = 1;
+	bool m_staticScenePending = false;	// 重建时有模型尚未上传完成，下一帧需要再次重建
 };
 
 }  // namespace lve
@@ -1,10 +1,17 @@
-#include "MainWindow.h"
+﻿#include "MainWindow.h"
+#include "lve/LveBenchmark.h"
 #include <QtWidgets/QApplication>
 
 int main(int argc, char *argv[])
 {
+    /*基准测试模式不创建窗口*/
+    int benchResult = lve::LveBenchmark::Run(argc, argv);
+    if (benchResult >= 0) {
+        return benchResult;
+    }
+
     QApplication app(argc, argv);
-    MainWindow window;
+    MainWindow window(lve::FirstAppOptions::FromCommandLine(argc, argv));
     window.show();
     return app.exec();
 }